@@ -0,0 +1,171 @@
+#include "AnalyticsDialog.h"
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QMessageBox>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSaveFile>
+#include <QTabWidget>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+namespace {
+
+// Rows shown in the sender tables
+constexpr int kTopCount = 100;
+
+/** Adds a row; count columns are right-aligned. */
+void addRow(QTreeWidget* table, const QStringList& texts) {
+    QTreeWidgetItem* item = new QTreeWidgetItem(table, texts);
+    for (int column = 1; column < texts.size(); ++column) {
+        item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    }
+}
+
+}
+
+AnalyticsDialog::AnalyticsDialog(const QString& directory, QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Analytics for %1").arg(QDir::toNativeSeparators(directory)));
+    setAttribute(Qt::WA_DeleteOnClose);
+    resize(800, 500);
+    
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    
+    m_statusLabel = new QLabel(tr("Scanning..."));
+    layout->addWidget(m_statusLabel);
+    
+    // The file count is not known up front: files are enumerated while they are scanned
+    m_progressBar = new QProgressBar;
+    m_progressBar->setRange(0, 0);
+    layout->addWidget(m_progressBar);
+    
+    m_tabs = new QTabWidget;
+    m_monthTable = addTable(tr("Messages per Month"), {tr("Month"), tr("Messages")});
+    m_typeTable = addTable(tr("Attachment Types"), {tr("Type"), tr("Attachments"), tr("Total Size")});
+    m_sizeTable = addTable(tr("Attachment Sizes"), {tr("Size Below"), tr("Attachments")});
+    m_senderTable = addTable(tr("Top Senders"), {tr("Sender"), tr("Messages"), tr("Max. Overcount")});
+    m_domainTable = addTable(tr("Top Sender Domains"), {tr("Domain"), tr("Messages"), tr("Max. Overcount")});
+    layout->addWidget(m_tabs, 1);
+    
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    m_saveButton = buttons->addButton(tr("Save Report..."), QDialogButtonBox::ActionRole);
+    m_saveButton->setEnabled(false);
+    m_cancelButton = buttons->addButton(tr("Stop Scan"), QDialogButtonBox::ActionRole);
+    connect(m_saveButton, &QPushButton::clicked, this, &AnalyticsDialog::onSave);
+    connect(m_cancelButton, &QPushButton::clicked, this, &AnalyticsDialog::onCancel);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+    
+    connect(&m_watcher, &QFutureWatcher<FolderAnalytics::Report>::finished, this, &AnalyticsDialog::onScanFinished);
+    connect(&m_progressTimer, &QTimer::timeout, this, &AnalyticsDialog::onProgressTimer);
+    m_progressTimer.start(200);
+    
+    m_timer.start();
+    m_watcher.setFuture(QtConcurrent::run(&FolderAnalytics::analyze, directory, &m_progress));
+}
+
+AnalyticsDialog::~AnalyticsDialog() {
+    // The workers write to m_progress; they must be done before it goes away
+    m_progress.canceled.storeRelaxed(1);
+    m_watcher.waitForFinished();
+}
+
+QTreeWidget* AnalyticsDialog::addTable(const QString& title, const QStringList& headers) {
+    QTreeWidget* table = new QTreeWidget;
+    table->setHeaderLabels(headers);
+    table->setRootIsDecorated(false);
+    table->setAlternatingRowColors(true);
+    table->setUniformRowHeights(true);
+    table->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->header()->setStretchLastSection(false);
+    m_tabs->addTab(table, title);
+    return table;
+}
+
+void AnalyticsDialog::onProgressTimer() {
+    const int scanned = m_progress.scanned.loadRelaxed();
+    const qint64 elapsed = m_timer.elapsed();
+    if (elapsed > 0) {
+        m_statusLabel->setText(tr("Scanned %1 files (%2 files/s)...").arg(scanned).arg(scanned * 1000 / elapsed));
+    }
+}
+
+void AnalyticsDialog::onScanFinished() {
+    m_progressTimer.stop();
+    m_progressBar->hide();
+    m_cancelButton->setEnabled(false);
+    m_saveButton->setEnabled(true);
+    m_report = m_watcher.result();
+    
+    const QLocale locale;
+    for (auto it = m_report.messagesPerMonth.cbegin(); it != m_report.messagesPerMonth.cend(); ++it) {
+        addRow(m_monthTable, {it.key(), QString::number(it.value())});
+    }
+    for (const QString& type : m_report.attachmentTypesByBytes()) {
+        const FolderAnalytics::TypeStats stats = m_report.attachmentTypes.value(type);
+        addRow(m_typeTable, {type, QString::number(stats.attachments), locale.formattedDataSize(stats.bytes)});
+    }
+    for (int i = 0; i < FolderAnalytics::SizeBuckets; ++i) {
+        if (m_report.attachmentSizes.at(i) == 0) continue;
+        addRow(m_sizeTable, {locale.formattedDataSize(FolderAnalytics::sizeBucketLimit(i)),
+                             QString::number(m_report.attachmentSizes.at(i))});
+    }
+    for (const TopCounter::Item& item : m_report.senders.top(kTopCount)) {
+        addRow(m_senderTable, {item.key, QString::number(item.count), QString::number(item.error)});
+    }
+    for (const TopCounter::Item& item : m_report.senderDomains.top(kTopCount)) {
+        addRow(m_domainTable, {item.key, QString::number(item.count), QString::number(item.error)});
+    }
+    
+    QString status = tr("%1 messages, %2 attachments (%3) in %4 s")
+        .arg(m_report.messages).arg(m_report.attachments)
+        .arg(locale.formattedDataSize(m_report.attachmentBytes))
+        .arg(m_timer.elapsed() / 1000.0, 0, 'f', 1);
+    if (m_report.failedFiles > 0) {
+        status += tr("; %1 files could not be parsed").arg(m_report.failedFiles);
+    }
+    if (m_progress.canceled.loadRelaxed()) {
+        status += tr(" (stopped early)");
+    }
+    m_statusLabel->setText(status);
+    
+    if (!m_progress.canceled.loadRelaxed()) {
+        emit reportReady(m_report);
+    }
+}
+
+void AnalyticsDialog::onCancel() {
+    // Workers finish their current file; the partial report then arrives through onScanFinished()
+    m_progress.canceled.storeRelaxed(1);
+    m_cancelButton->setEnabled(false);
+    m_statusLabel->setText(tr("Stopping..."));
+}
+
+void AnalyticsDialog::onSave() {
+    QString selectedFilter;
+    const QString jsonFilter = tr("JSON Files (*.json)");
+    const QString csvFilter = tr("CSV Files (*.csv)");
+    QString savePath = QFileDialog::getSaveFileName(this,
+        tr("Save Report"),
+        QDir::homePath() + "/analytics.json",
+        jsonFilter + ";;" + csvFilter,
+        &selectedFilter);
+    
+    if (savePath.isEmpty()) return;
+    
+    const bool csv = selectedFilter == csvFilter || savePath.endsWith(".csv", Qt::CaseInsensitive);
+    QSaveFile file(savePath);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(csv ? m_report.toCsv(kTopCount) : m_report.toJson(kTopCount)) < 0
+        || !file.commit()) {
+        QMessageBox::warning(this, tr("Error"),
+            tr("Failed to save report: %1\n\n%2").arg(savePath, file.errorString()));
+    }
+}
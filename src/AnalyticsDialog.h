@@ -0,0 +1,64 @@
+#ifndef ANALYTICSDIALOG_H
+#define ANALYTICSDIALOG_H
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QTimer>
+#include "FolderAnalytics.h"
+
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTabWidget;
+class QTreeWidget;
+
+/**
+ * Runs FolderAnalytics over a directory tree and shows the resulting
+ * histograms and top-N tables; the report can be saved as JSON or CSV.
+ * The scan runs on the global thread pool and can be stopped.
+ */
+class AnalyticsDialog : public QDialog {
+    Q_OBJECT
+    
+public:
+    explicit AnalyticsDialog(const QString& directory, QWidget* parent = nullptr);
+    ~AnalyticsDialog();
+    
+signals:
+    /** Emitted once the scan has finished (not when it is stopped). */
+    void reportReady(const FolderAnalytics::Report& report);
+    
+private slots:
+    /** Shows the number of files scanned so far. */
+    void onProgressTimer();
+    /** Fills the tables once the scan is done. */
+    void onScanFinished();
+    /** Stops a running scan; files counted so far are still shown. */
+    void onCancel();
+    /** Saves the report as JSON or CSV, depending on the chosen file type. */
+    void onSave();
+    
+private:
+    /** Adds a table tab with the given column headers. */
+    QTreeWidget* addTable(const QString& title, const QStringList& headers);
+    
+    QLabel* m_statusLabel;
+    QProgressBar* m_progressBar;
+    QTabWidget* m_tabs;
+    QTreeWidget* m_monthTable;
+    QTreeWidget* m_typeTable;
+    QTreeWidget* m_sizeTable;
+    QTreeWidget* m_senderTable;
+    QTreeWidget* m_domainTable;
+    QPushButton* m_cancelButton;
+    QPushButton* m_saveButton;
+    
+    FolderAnalytics::Progress m_progress;
+    QFutureWatcher<FolderAnalytics::Report> m_watcher;
+    FolderAnalytics::Report m_report;
+    QTimer m_progressTimer;
+    QElapsedTimer m_timer;
+};
+
+#endif
@@ -1,49 +1,247 @@
 #include "AttachmentModel.h"
+#include <QApplication>
+#include <QFileInfo>
+#include <QHash>
+#include <QLocale>
+#include <QStyle>
+#include <QUrl>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+/** Formats a size in human-readable format. */
+QString formatSize(qint64 size) {
+    if (size < 1024)
+        return QString("%1 B").arg(size);
+    else if (size < 1024 * 1024)
+        return QString("%1 KB").arg(size / 1024);
+    else
+        return QString("%1 MB").arg(size / (1024 * 1024));
+}
+
+/** ZIP attachments are listed as trees; other ZIP-based formats (docx, jar, ...) stay plain files. */
+bool isArchive(const EmailAttachment& att) {
+    const bool zipName = QFileInfo(att.filename).suffix().compare("zip", Qt::CaseInsensitive) == 0
+        || att.mimeType.contains("zip", Qt::CaseInsensitive);
+    return zipName && ZipArchive::isZip(att.data);
+}
+
+}
 
 AttachmentModel::AttachmentModel(QObject* parent)
-    : QAbstractTableModel(parent)
+    : QAbstractItemModel(parent)
 {
 }
 
+AttachmentModel::~AttachmentModel() {
+    stopThumbnails();
+}
+
 void AttachmentModel::setAttachments(const QList<EmailAttachment>& attachments) {
+    stopThumbnails();
+    
     beginResetModel();
     m_attachments = attachments;
+    m_thumbnails = QList<ThumbnailCache::Thumbnail>(attachments.size());
+    m_archives = QList<Archive>(attachments.size());
+    m_nodes.clear();
+    for (int row = 0; row < m_attachments.size(); ++row) {
+        if (isArchive(m_attachments.at(row))) {
+            m_archives[row].state = ArchiveState::Unlisted;
+        }
+    }
     endResetModel();
+    
+    m_hasImages = false;
+    for (const EmailAttachment& att : m_attachments) {
+        m_hasImages = m_hasImages || ThumbnailCache::isImage(att.filename, att.mimeType);
+    }
+    // The table shows right away; thumbnails arrive in row order as workers finish them
+    startThumbnails();
+}
+
+void AttachmentModel::releasePayloads() {
+    // Queued jobs hold copies of the payloads; thumbnails not rendered yet start again in restorePayloads()
+    stopThumbnails();
+    for (EmailAttachment& att : m_attachments) {
+        att.data = QByteArray();
+    }
+}
+
+void AttachmentModel::restorePayloads(const QList<EmailAttachment>& attachments) {
+    if (attachments.size() != m_attachments.size()) {
+        setAttachments(attachments);
+        return;
+    }
+    for (int row = 0; row < m_attachments.size(); ++row) {
+        m_attachments[row].data = attachments.at(row).data;
+    }
+    for (int row = 0; row < m_archives.size(); ++row) {
+        if (!m_archives.at(row).pending) continue;
+        m_archives[row].pending = false;
+        fetchMore(index(row, ColumnFilename));
+    }
+    startThumbnails();
+}
+
+bool AttachmentModel::hasImages() const {
+    return m_hasImages;
 }
 
 const EmailAttachment& AttachmentModel::attachment(int row) const {
     return m_attachments.at(row);
 }
 
+int AttachmentModel::attachmentRow(const QModelIndex& index) const {
+    if (!index.isValid()) return -1;
+    if (index.internalId() == 0) return index.row();
+    return m_nodes.at(index.internalId() - 1).attachmentRow;
+}
+
+const ZipArchive::Entry* AttachmentModel::archiveEntry(const QModelIndex& index) const {
+    if (!index.isValid() || index.internalId() == 0) return nullptr;
+    const ArchiveNode& node = m_nodes.at(index.internalId() - 1);
+    return node.hasEntry ? &node.entry : nullptr;
+}
+
+QModelIndex AttachmentModel::index(int row, int column, const QModelIndex& parent) const {
+    if (row < 0 || column < 0 || column >= ColumnCount) return QModelIndex();
+    
+    if (!parent.isValid()) {
+        return row < m_attachments.size() ? createIndex(row, column, quintptr(0)) : QModelIndex();
+    }
+    const QList<int>* children = childNodes(parent);
+    if (!children || row >= children->size()) return QModelIndex();
+    return createIndex(row, column, quintptr(children->at(row) + 1));
+}
+
+QModelIndex AttachmentModel::parent(const QModelIndex& index) const {
+    if (!index.isValid() || index.internalId() == 0) return QModelIndex();
+    
+    const ArchiveNode& node = m_nodes.at(index.internalId() - 1);
+    if (node.parent < 0) {
+        return createIndex(node.attachmentRow, 0, quintptr(0));
+    }
+    return createIndex(m_nodes.at(node.parent).row, 0, quintptr(node.parent + 1));
+}
+
 int AttachmentModel::rowCount(const QModelIndex& parent) const {
-    if (parent.isValid()) return 0;
-    return m_attachments.size();
+    if (!parent.isValid()) return m_attachments.size();
+    if (parent.column() != 0) return 0;
+    const QList<int>* children = childNodes(parent);
+    return children ? children->size() : 0;
 }
 
 int AttachmentModel::columnCount(const QModelIndex& parent) const {
-    if (parent.isValid()) return 0;
+    Q_UNUSED(parent);
     return ColumnCount;
 }
 
+bool AttachmentModel::hasChildren(const QModelIndex& parent) const {
+    if (!parent.isValid()) return !m_attachments.isEmpty();
+    if (parent.column() != 0) return false;
+    
+    // Unlisted archives show an expander; listing happens in fetchMore()
+    if (parent.internalId() == 0) {
+        const Archive& archive = m_archives.at(parent.row());
+        if (archive.state == ArchiveState::Unlisted) return true;
+        return archive.state == ArchiveState::Listed && !archive.children.isEmpty();
+    }
+    return !m_nodes.at(parent.internalId() - 1).children.isEmpty();
+}
+
+bool AttachmentModel::canFetchMore(const QModelIndex& parent) const {
+    return parent.isValid() && parent.internalId() == 0 && parent.column() == 0
+        && m_archives.at(parent.row()).state == ArchiveState::Unlisted
+        && !m_archives.at(parent.row()).pending;
+}
+
+void AttachmentModel::fetchMore(const QModelIndex& parent) {
+    if (!canFetchMore(parent)) return;
+    
+    const int row = parent.row();
+    Archive& archive = m_archives[row];
+    if (m_attachments.at(row).data.isEmpty()) {
+        // Released by an evicted tab; the view stays expanded and the rows come with the payload
+        archive.pending = true;
+        emit payloadsRequested();
+        return;
+    }
+    QList<ZipArchive::Entry> entries;
+    if (!ZipArchive::readDirectory(m_attachments.at(row).data, &entries, &archive.errorString)) {
+        archive.state = ArchiveState::Failed;
+        const QModelIndex changed = index(row, ColumnFilename);
+        emit dataChanged(changed, changed, {Qt::ToolTipRole});
+        return;
+    }
+    
+    // Nodes are appended before the insert notification; nothing references them until then
+    const QList<int> children = buildArchiveTree(row, entries);
+    if (children.isEmpty()) {
+        archive.state = ArchiveState::Listed;
+        return;
+    }
+    beginInsertRows(parent, 0, children.size() - 1);
+    archive.children = children;
+    archive.state = ArchiveState::Listed;
+    endInsertRows();
+}
+
 QVariant AttachmentModel::data(const QModelIndex& index, int role) const {
-    if (!index.isValid() || index.row() >= m_attachments.size())
+    if (!index.isValid())
         return QVariant();
     
+    // Archive folders and members
+    if (index.internalId() != 0) {
+        const ArchiveNode& node = m_nodes.at(index.internalId() - 1);
+        if (role == Qt::DisplayRole) {
+            if (index.column() == ColumnFilename) return node.name;
+            if (index.column() == ColumnSize && node.hasEntry) return formatSize(node.entry.uncompressedSize);
+        } else if (role == Qt::DecorationRole && index.column() == ColumnFilename) {
+            return QApplication::style()->standardIcon(node.hasEntry ? QStyle::SP_FileIcon : QStyle::SP_DirIcon);
+        } else if (role == Qt::ToolTipRole && node.hasEntry) {
+            QString tip = tr("%1\nCompressed: %2 (%3)")
+                .arg(node.entry.name, formatSize(node.entry.compressedSize), ZipArchive::methodName(node.entry.method));
+            if (node.entry.modified.isValid()) {
+                tip += tr("\nModified: %1").arg(QLocale().toString(node.entry.modified, QLocale::ShortFormat));
+            }
+            if (node.entry.isEncrypted()) {
+                tip += tr("\nEncrypted");
+            }
+            return tip;
+        }
+        return QVariant();
+    }
+    
+    if (index.row() >= m_attachments.size())
+        return QVariant();
+    
+    if (index.column() == ColumnFilename && role == Qt::DecorationRole) {
+        const QImage& icon = m_thumbnails.at(index.row()).icon;
+        return icon.isNull() ? QVariant() : QVariant(icon);
+    }
+    
+    if (index.column() == ColumnFilename && role == Qt::ToolTipRole) {
+        const Archive& archive = m_archives.at(index.row());
+        if (archive.state == ArchiveState::Failed) {
+            return tr("Cannot list archive: %1").arg(archive.errorString);
+        }
+        const QString& previewPath = m_thumbnails.at(index.row()).previewPath;
+        if (previewPath.isEmpty()) return QVariant();
+        // Rich-text tooltip showing the cached preview file
+        return QString("<img src=\"%1\"><br>%2")
+            .arg(QUrl::fromLocalFile(previewPath).toString(), m_attachments.at(index.row()).filename.toHtmlEscaped());
+    }
+    
     if (role == Qt::DisplayRole) {
         const EmailAttachment& att = m_attachments[index.row()];
         
         switch (index.column()) {
             case ColumnFilename:
                 return att.filename;
-            case ColumnSize: {
-                // Format size in human-readable format
-                if (att.size < 1024)
-                    return QString("%1 B").arg(att.size);
-                else if (att.size < 1024 * 1024)
-                    return QString("%1 KB").arg(att.size / 1024);
-                else
-                    return QString("%1 MB").arg(att.size / (1024 * 1024));
-            }
+            case ColumnSize:
+                return formatSize(att.size);
         }
     }
     
@@ -59,3 +257,120 @@ QVariant AttachmentModel::headerData(int section, Qt::Orientation orientation, i
     }
     return QVariant();
 }
+
+void AttachmentModel::failPendingArchives(const QString& errorString) {
+    for (int row = 0; row < m_archives.size(); ++row) {
+        Archive& archive = m_archives[row];
+        if (!archive.pending) continue;
+        
+        archive.pending = false;
+        archive.state = ArchiveState::Failed;
+        archive.errorString = errorString;
+        const QModelIndex changed = index(row, ColumnFilename);
+        emit dataChanged(changed, changed, {Qt::ToolTipRole});
+    }
+}
+
+AttachmentModel::ThumbnailResult AttachmentModel::renderThumbnail(const ThumbnailJob& job) {
+    return ThumbnailResult{job.row, ThumbnailCache::thumbnail(job.data)};
+}
+
+void AttachmentModel::startThumbnails() {
+    stopThumbnails();
+    
+    QList<ThumbnailJob> jobs;
+    for (int row = 0; row < m_attachments.size(); ++row) {
+        const EmailAttachment& att = m_attachments.at(row);
+        if (att.data.isEmpty() || !m_thumbnails.at(row).icon.isNull()) continue;
+        if (!ThumbnailCache::isImage(att.filename, att.mimeType)) continue;
+        
+        jobs.append(ThumbnailJob{row, att.data});
+    }
+    if (jobs.isEmpty()) return;
+    
+    m_thumbnailWatcher = new QFutureWatcher<ThumbnailResult>(this);
+    connect(m_thumbnailWatcher, &QFutureWatcher<ThumbnailResult>::resultsReadyAt,
+            this, &AttachmentModel::onThumbnailsReady);
+    m_thumbnailWatcher->setFuture(QtConcurrent::mapped(jobs, &AttachmentModel::renderThumbnail));
+}
+
+void AttachmentModel::stopThumbnails() {
+    if (!m_thumbnailWatcher) return;
+    
+    // Workers only touch their own job, so there is nothing to wait for; just stop
+    // listening (queued notifications go to a watcher nobody is connected to)
+    m_thumbnailWatcher->disconnect(this);
+    m_thumbnailWatcher->cancel();
+    m_thumbnailWatcher->deleteLater();
+    m_thumbnailWatcher = nullptr;
+}
+
+void AttachmentModel::onThumbnailsReady(int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        const ThumbnailResult result = m_thumbnailWatcher->resultAt(i);
+        if (result.row >= m_thumbnails.size()) continue;
+        
+        m_thumbnails[result.row] = result.thumbnail;
+        const QModelIndex changed = index(result.row, ColumnFilename);
+        emit dataChanged(changed, changed, {Qt::DecorationRole, Qt::ToolTipRole});
+    }
+}
+
+const QList<int>* AttachmentModel::childNodes(const QModelIndex& parent) const {
+    if (parent.internalId() == 0) {
+        const Archive& archive = m_archives.at(parent.row());
+        return archive.state == ArchiveState::Listed ? &archive.children : nullptr;
+    }
+    return &m_nodes.at(parent.internalId() - 1).children;
+}
+
+QList<int> AttachmentModel::buildArchiveTree(int attachmentRow, const QList<ZipArchive::Entry>& entries) {
+    QList<int> topLevel;
+    // Folder path ("a/b") -> node id; folders are created for every path prefix, listed or not
+    QHash<QString, int> folders;
+    
+    auto addNode = [&](const QString& name, int parent, bool hasEntry, const ZipArchive::Entry& entry) {
+        const int id = m_nodes.size();
+        m_nodes.append(ArchiveNode{name, attachmentRow, parent, 0, hasEntry, entry, {}});
+        (parent < 0 ? topLevel : m_nodes[parent].children).append(id);
+        return id;
+    };
+    
+    for (const ZipArchive::Entry& entry : entries) {
+        const QStringList parts = entry.name.split('/', Qt::SkipEmptyParts);
+        if (parts.isEmpty()) continue;
+        
+        int parent = -1;
+        QString path;
+        const int folderParts = entry.isDirectory() ? parts.size() : parts.size() - 1;
+        for (int i = 0; i < folderParts; ++i) {
+            path += parts.at(i) + '/';
+            auto it = folders.constFind(path);
+            if (it == folders.constEnd()) {
+                it = folders.insert(path, addNode(parts.at(i), parent, false, ZipArchive::Entry()));
+            }
+            parent = it.value();
+        }
+        if (!entry.isDirectory()) {
+            addNode(parts.last(), parent, true, entry);
+        }
+    }
+    
+    // Folders first, then by name; rows follow the sorted order
+    auto sortChildren = [this](QList<int>& children) {
+        std::sort(children.begin(), children.end(), [this](int a, int b) {
+            const ArchiveNode& left = m_nodes.at(a);
+            const ArchiveNode& right = m_nodes.at(b);
+            if (left.hasEntry != right.hasEntry) return !left.hasEntry;
+            return left.name.compare(right.name, Qt::CaseInsensitive) < 0;
+        });
+        for (int row = 0; row < children.size(); ++row) {
+            m_nodes[children.at(row)].row = row;
+        }
+    };
+    sortChildren(topLevel);
+    for (qsizetype id = m_nodes.size() - 1; id >= 0 && m_nodes.at(id).attachmentRow == attachmentRow; --id) {
+        sortChildren(m_nodes[id].children);
+    }
+    return topLevel;
+}
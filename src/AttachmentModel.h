@@ -1,15 +1,23 @@
 #ifndef ATTACHMENTMODEL_H
 #define ATTACHMENTMODEL_H
 
-#include <QAbstractTableModel>
+#include <QAbstractItemModel>
+#include <QFutureWatcher>
 #include <QList>
 #include "EmailTypes.h"
+#include "ThumbnailCache.h"
+#include "ZipArchive.h"
 
 /**
- * Qt table model for displaying email attachments.
- * Provides filename and size columns for the attachments table view.
+ * Qt item model for displaying email attachments.
+ * Provides filename and size columns for the attachments view.
+ * Image attachments get a thumbnail icon and a hover preview; thumbnails are
+ * rendered on the global thread pool and filled in as they become ready.
+ * ZIP attachments expand into their folders and members; the central
+ * directory is read from the payload the first time one is expanded (after
+ * releasePayloads(), once the payloads are back).
  */
-class AttachmentModel : public QAbstractTableModel {
+class AttachmentModel : public QAbstractItemModel {
     Q_OBJECT
     
 public:
@@ -20,19 +28,105 @@ public:
     };
     
     explicit AttachmentModel(QObject* parent = nullptr);
+    ~AttachmentModel();
     
-    /** Replaces the current attachments with a new list. */
+    /** Replaces the current attachments with a new list and starts rendering their thumbnails. */
     void setAttachments(const QList<EmailAttachment>& attachments);
+    /** Drops the attachment payloads and pending thumbnail jobs; names, sizes, finished thumbnails and listed archives stay. */
+    void releasePayloads();
+    /** Puts payloads back after releasePayloads() without resetting the model (same attachment list); resumes thumbnails. */
+    void restorePayloads(const QList<EmailAttachment>& attachments);
+    /** True if any attachment is an image (and so gets a thumbnail). */
+    bool hasImages() const;
     /** Returns the attachment at the given row. */
     const EmailAttachment& attachment(int row) const;
     
+    /** Row of the attachment an index belongs to (the attachment itself or a member of it), or -1. */
+    int attachmentRow(const QModelIndex& index) const;
+    /** Archive member at index, or nullptr for attachments and archive folders. */
+    const ZipArchive::Entry* archiveEntry(const QModelIndex& index) const;
+    
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& index) const override;
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     
+    /** Marks archives waiting for payloads (see payloadsRequested()) as unreadable. */
+    void failPendingArchives(const QString& errorString);
+    
+signals:
+    /**
+     * Emitted when an archive is expanded after releasePayloads(); it is
+     * listed once restorePayloads() puts the payloads back.
+     */
+    void payloadsRequested();
+    
 private:
+    struct ThumbnailJob {
+        int row;
+        QByteArray data;
+    };
+    
+    struct ThumbnailResult {
+        int row;
+        ThumbnailCache::Thumbnail thumbnail;
+    };
+    
+    enum class ArchiveState {
+        None,
+        Unlisted,
+        Listed,
+        Failed
+    };
+    
+    /** Per-attachment archive listing; children are node ids. */
+    struct Archive {
+        ArchiveState state = ArchiveState::None;
+        /** Expanded while its payload was released; listed by restorePayloads(). */
+        bool pending = false;
+        QString errorString;
+        QList<int> children;
+    };
+    
+    /** A folder or member inside an archive. Model index internal id = node id + 1 (0 = attachment). */
+    struct ArchiveNode {
+        QString name;
+        int attachmentRow;
+        /** Parent node id, -1 for top-level members of the archive. */
+        int parent;
+        /** Row under the parent. */
+        int row;
+        /** False for folders (which have no entry). */
+        bool hasEntry;
+        ZipArchive::Entry entry;
+        QList<int> children;
+    };
+    
+    /** Worker function: renders (or loads from the cache) the thumbnail of one attachment. */
+    static ThumbnailResult renderThumbnail(const ThumbnailJob& job);
+    
+    /** Renders thumbnails of image attachments that have a payload but no icon yet. */
+    void startThumbnails();
+    /** Abandons thumbnail rendering for the previous attachment list. */
+    void stopThumbnails();
+    /** Stores finished thumbnails and notifies views. */
+    void onThumbnailsReady(int begin, int end);
+    /** Children of an index: node ids, or nullptr for attachments that are not listed archives. */
+    const QList<int>* childNodes(const QModelIndex& parent) const;
+    /** Builds folder/member nodes from a central directory; returns the top-level node ids. */
+    QList<int> buildArchiveTree(int attachmentRow, const QList<ZipArchive::Entry>& entries);
+    
     QList<EmailAttachment> m_attachments;
+    QList<ThumbnailCache::Thumbnail> m_thumbnails;
+    QList<Archive> m_archives;
+    QList<ArchiveNode> m_nodes;
+    bool m_hasImages = false;
+    QFutureWatcher<ThumbnailResult>* m_thumbnailWatcher = nullptr;
 };
 
 #endif
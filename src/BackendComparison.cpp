@@ -0,0 +1,143 @@
+#include "BackendComparison.h"
+#include <QCryptographicHash>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+
+/** The compared fields of a message; payloads are reduced to their SHA-256. */
+struct Digest {
+    bool isValid = false;
+    QString errorMessage;
+    QString subject;
+    QString plainBody;
+    QString htmlBody;
+    QString senderName;
+    QString senderEmail;
+    QString toRecipients;
+    QString ccRecipients;
+    qint64 date = 0;
+    QStringList attachmentNames;
+    QList<QByteArray> attachmentHashes;
+};
+
+/** Bodies differ in line endings and trailing padding between sources; neither is content. */
+QString normalizedBody(QString text) {
+    text.remove('\0');
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    qsizetype end = text.size();
+    while (end > 0 && text.at(end - 1).isSpace()) --end;
+    text.truncate(end);
+    return text;
+}
+
+Digest digest(const EmailMessage& msg) {
+    Digest d;
+    d.isValid = msg.isValid;
+    d.errorMessage = msg.errorMessage;
+    d.subject = msg.subject.trimmed();
+    d.plainBody = normalizedBody(msg.bodyPlainText);
+    d.htmlBody = normalizedBody(msg.bodyHtml);
+    d.senderName = msg.senderName.trimmed();
+    d.senderEmail = msg.senderEmail.trimmed();
+    d.toRecipients = msg.toRecipients.trimmed();
+    d.ccRecipients = msg.ccRecipients.trimmed();
+    // PT_SYSTIME has 100 ns ticks, Python datetimes microseconds: compare whole seconds
+    d.date = msg.date.isValid() ? msg.date.toSecsSinceEpoch() : 0;
+    for (const EmailAttachment& att : msg.attachments) {
+        d.attachmentNames.append(att.filename);
+        d.attachmentHashes.append(QCryptographicHash::hash(att.data, QCryptographicHash::Sha256));
+    }
+    return d;
+}
+
+QStringList compare(const Digest& a, const Digest& b) {
+    QStringList fields;
+    if (a.isValid != b.isValid) {
+        fields.append("valid");
+        return fields;
+    }
+    if (a.subject != b.subject) fields.append("subject");
+    if (a.plainBody != b.plainBody) fields.append("body");
+    if (a.htmlBody != b.htmlBody) fields.append("html");
+    if (a.senderName != b.senderName) fields.append("sender name");
+    if (a.senderEmail != b.senderEmail) fields.append("sender email");
+    if (a.toRecipients != b.toRecipients) fields.append("to");
+    if (a.ccRecipients != b.ccRecipients) fields.append("cc");
+    if (a.date != b.date) fields.append("date");
+    if (a.attachmentNames != b.attachmentNames) fields.append("attachment names");
+    if (a.attachmentHashes != b.attachmentHashes) fields.append("attachment data");
+    return fields;
+}
+
+/** Nearest-rank percentile of sorted values, in milliseconds. */
+double percentileMs(const QList<qint64>& sorted, double percentile) {
+    const qsizetype rank = qCeil(percentile / 100.0 * sorted.size());
+    return sorted.at(qBound<qsizetype>(0, rank - 1, sorted.size() - 1)) / 1000.0;
+}
+
+}
+
+bool BackendComparison::FileResult::agrees() const {
+    for (const QStringList& fields : differences) {
+        if (!fields.isEmpty()) return false;
+    }
+    return true;
+}
+
+BackendComparison::FileResult BackendComparison::compareFile(const QString& filePath) {
+    FileResult result;
+    result.filePath = filePath;
+    
+    const QList<ParseBackend> backends = MsgParser::availableBackends();
+    QList<Digest> digests(backends.size());
+    result.runs.resize(backends.size());
+    
+    // Alternate the order per file so no backend always gets the cold page cache
+    const bool reverse = qHash(filePath) & 1;
+    for (qsizetype n = 0; n < backends.size(); ++n) {
+        const qsizetype i = reverse ? backends.size() - 1 - n : n;
+        
+        ParseOptions options;
+        options.backend = backends.at(i);
+        MsgParser parser;
+        parser.setOptions(options);
+        
+        // CPU time of this thread: parses of other files on other threads do not count against this one
+        const EmailMessage msg = parser.parse(filePath);
+        Run& run = result.runs[i];
+        run.elapsedUs = parser.lastParseTimeNs() / 1000;
+        run.backend = backends.at(i);
+        run.ok = msg.isValid;
+        run.errorMessage = msg.errorMessage;
+        
+        // Hashed outside the GIL, and before the next parse so only one message is held at a time
+        digests[i] = digest(msg);
+    }
+    
+    for (qsizetype i = 1; i < backends.size(); ++i) {
+        result.differences.append(compare(digests.at(0), digests.at(i)));
+    }
+    return result;
+}
+
+QStringList BackendComparison::differences(const EmailMessage& a, const EmailMessage& b) {
+    return compare(digest(a), digest(b));
+}
+
+BackendComparison::LatencySummary BackendComparison::summarize(QList<qint64> elapsedUs) {
+    LatencySummary summary;
+    if (elapsedUs.isEmpty()) return summary;
+    
+    std::sort(elapsedUs.begin(), elapsedUs.end());
+    summary.count = elapsedUs.size();
+    summary.p50Ms = percentileMs(elapsedUs, 50);
+    summary.p90Ms = percentileMs(elapsedUs, 90);
+    summary.p99Ms = percentileMs(elapsedUs, 99);
+    summary.maxMs = elapsedUs.last() / 1000.0;
+    
+    qint64 totalUs = 0;
+    for (qint64 us : elapsedUs) totalUs += us;
+    summary.filesPerSecond = totalUs > 0 ? summary.count * 1e6 / totalUs : 0;
+    return summary;
+}
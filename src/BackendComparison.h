@@ -0,0 +1,61 @@
+#ifndef BACKENDCOMPARISON_H
+#define BACKENDCOMPARISON_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "EmailTypes.h"
+#include "MsgParser.h"
+
+/**
+ * Conformance and speed check of the parse backends (ParseBackend).
+ *
+ * Each file is parsed once with every backend; the messages are reduced to
+ * the compared fields (subject, bodies, sender, recipients, date, attachment
+ * names and SHA-256 of their payloads) right away, so only the verdict and
+ * the timings are kept per file. The first backend is the reference the
+ * others are diffed against. Functions are safe to call from worker threads.
+ */
+class BackendComparison {
+public:
+    /** One backend's parse of a file. */
+    struct Run {
+        ParseBackend backend = ParseBackend::MapiStreams;
+        bool ok = false;
+        QString errorMessage;
+        /** CPU time of the parse (MsgParser::lastParseTimeNs()), unaffected by other threads' parses. */
+        qint64 elapsedUs = 0;
+    };
+    
+    struct FileResult {
+        QString filePath;
+        /** One run per backend, in MsgParser::availableBackends() order. */
+        QList<Run> runs;
+        /** For each backend after the reference: fields that differ from it (empty = agrees). */
+        QList<QStringList> differences;
+        
+        bool agrees() const;
+    };
+    
+    /** Latency distribution of one backend over a corpus. */
+    struct LatencySummary {
+        int count = 0;
+        double p50Ms = 0;
+        double p90Ms = 0;
+        double p99Ms = 0;
+        double maxMs = 0;
+        /** Files per second of parse CPU time (single-threaded equivalent). */
+        double filesPerSecond = 0;
+    };
+    
+    /** Parses filePath with every available backend and compares the results. */
+    static FileResult compareFile(const QString& filePath);
+    
+    /** Names of the compared fields in which a and b differ. */
+    static QStringList differences(const EmailMessage& a, const EmailMessage& b);
+    
+    /** Percentiles (nearest rank) and throughput of a set of parse times. */
+    static LatencySummary summarize(QList<qint64> elapsedUs);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef CODEPAGEDECODER_H
+#define CODEPAGEDECODER_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * Native decoding of 8-bit MSG string properties (PT_STRING8) and HTML bodies.
+ * Pure-ASCII runs are widened with SSE2, single-byte Windows/ISO codepages use
+ * lookup tables, and the result is written directly into the returned QString.
+ */
+namespace CodepageDecoder {
+
+/** Windows codepage identifiers with special handling. */
+enum Codepage {
+    CodepageUtf16Le = 1200,
+    CodepageUtf16Be = 1201,
+    CodepageWindows1252 = 1252,
+    CodepageAscii = 20127,
+    CodepageLatin1 = 28591,
+    CodepageUtf8 = 65001
+};
+
+/**
+ * Decodes size bytes in the given Windows codepage.
+ * Unknown codepages fall back to windows-1252; trailing NULs are dropped.
+ */
+QString decode(const char* data, qsizetype size, int codepage);
+QString decode(const QByteArray& data, int codepage);
+
+/** Decodes a PT_UNICODE (UTF-16LE) property stream. */
+QString decodeUtf16Le(const QByteArray& data);
+
+/** Maps a MIME/IANA charset name to a Windows codepage, or 0 if unknown. */
+int codepageForCharset(const QByteArray& charset);
+
+/** Returns the codepage declared by an HTML <meta> charset, or 0 if none. */
+int codepageFromHtml(const QByteArray& html);
+
+/** True if the codepage can be decoded (natively or through QStringDecoder). */
+bool isSupported(int codepage);
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "ConversationView.h"
+#include "MsgFileModel.h"
+#include <QDir>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+namespace {
+
+// Parsed headers are handed to the model at most this often, so views
+// relayout a few times per second rather than once per file
+constexpr int kFlushIntervalMs = 200;
+
+}
+
+ConversationView::ConversationView(QWidget* parent)
+    : QWidget(parent)
+    , m_model(new ThreadModel(this))
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    
+    QHBoxLayout* toolbar = new QHBoxLayout;
+    m_scanButton = new QPushButton(tr("Scan Folder..."));
+    connect(m_scanButton, &QPushButton::clicked, this, &ConversationView::onScanClicked);
+    toolbar->addWidget(m_scanButton);
+    m_statusLabel = new QLabel;
+    toolbar->addWidget(m_statusLabel, 1);
+    layout->addLayout(toolbar);
+    
+    m_treeView = new QTreeView;
+    m_treeView->setModel(m_model);
+    m_treeView->setUniformRowHeights(true);
+    m_treeView->setAlternatingRowColors(true);
+    m_treeView->header()->setSectionResizeMode(ThreadModel::SubjectColumn, QHeaderView::Stretch);
+    m_treeView->header()->setStretchLastSection(false);
+    connect(m_treeView, &QTreeView::doubleClicked, this, &ConversationView::onDoubleClicked);
+    layout->addWidget(m_treeView, 1);
+    
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushIntervalMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ConversationView::flushPending);
+}
+
+ConversationView::~ConversationView() {
+    // Parsing workers must not outlive the view
+    cancelScan();
+    for (QFutureWatcherBase* watcher : std::as_const(m_watchers)) {
+        watcher->waitForFinished();
+    }
+}
+
+void ConversationView::scanFolder(const QString& directory) {
+    cancelScan();
+    m_model->clear();
+    m_pending.clear();
+    m_fileCount = 0;
+    m_lastDirectory = directory;
+    
+    m_statusLabel->setText(tr("Listing files..."));
+    m_timer.start();
+    
+    const quint64 generation = m_generation;
+    QFutureWatcher<QStringList>* watcher = new QFutureWatcher<QStringList>(this);
+    m_watchers.append(watcher);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, generation]() {
+        m_watchers.removeOne(watcher);
+        watcher->deleteLater();
+        if (generation == m_generation) {
+            onFilesListed(watcher->result());
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&MsgFileModel::findMessageFiles, directory));
+}
+
+void ConversationView::onScanClicked() {
+    QString directory = QFileDialog::getExistingDirectory(this,
+        tr("Scan Folder for Conversations"),
+        m_lastDirectory.isEmpty() ? QDir::homePath() : m_lastDirectory);
+    
+    if (!directory.isEmpty()) {
+        scanFolder(directory);
+    }
+}
+
+void ConversationView::onFilesListed(const QStringList& files) {
+    m_fileCount = static_cast<int>(files.size());
+    if (files.isEmpty()) {
+        m_statusLabel->setText(tr("No MSG files found."));
+        return;
+    }
+    
+    const quint64 generation = m_generation;
+    QFutureWatcher<ThreadModel::MessageHeaders>* watcher = new QFutureWatcher<ThreadModel::MessageHeaders>(this);
+    m_watchers.append(watcher);
+    m_scanWatcher = watcher;
+    connect(watcher, &QFutureWatcher<ThreadModel::MessageHeaders>::resultsReadyAt, this,
+            [this, generation](int begin, int end) {
+        if (generation == m_generation) onResultsReady(begin, end);
+    });
+    connect(watcher, &QFutureWatcher<ThreadModel::MessageHeaders>::finished, this,
+            [this, watcher, generation]() {
+        m_watchers.removeOne(watcher);
+        watcher->deleteLater();
+        if (generation == m_generation) onScanFinished();
+    });
+    watcher->setFuture(QtConcurrent::mapped(files, &ThreadModel::readHeaders));
+}
+
+void ConversationView::onResultsReady(int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        m_pending.append(m_scanWatcher->resultAt(i));
+    }
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void ConversationView::flushPending() {
+    if (m_pending.isEmpty()) return;
+    
+    m_model->addMessages(m_pending);
+    m_pending.clear();
+    updateStatus();
+}
+
+void ConversationView::onScanFinished() {
+    m_flushTimer.stop();
+    flushPending();
+    m_scanWatcher = nullptr;
+    updateStatus();
+}
+
+void ConversationView::onDoubleClicked(const QModelIndex& index) {
+    const QString filePath = m_model->filePath(index);
+    if (!filePath.isEmpty()) {
+        emit fileActivated(filePath);
+    }
+}
+
+void ConversationView::cancelScan() {
+    ++m_generation;
+    for (QFutureWatcherBase* watcher : std::as_const(m_watchers)) {
+        watcher->cancel();
+    }
+    m_scanWatcher = nullptr;
+    m_flushTimer.stop();
+}
+
+void ConversationView::updateStatus() {
+    const qint64 elapsed = qMax<qint64>(1, m_timer.elapsed());
+    QString status = tr("%1 messages in %2 conversations")
+        .arg(m_model->messageCount()).arg(m_model->threadCount());
+    if (m_scanWatcher) {
+        status += tr(" (%1 of %2 files, %3 files/s)")
+            .arg(m_scanWatcher->progressValue()).arg(m_fileCount)
+            .arg(qint64(m_scanWatcher->progressValue()) * 1000 / elapsed);
+    } else {
+        status += tr(" (%1 s)").arg(elapsed / 1000.0, 0, 'f', 1);
+    }
+    m_statusLabel->setText(status);
+}
@@ -0,0 +1,75 @@
+#ifndef CONVERSATIONVIEW_H
+#define CONVERSATIONVIEW_H
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QWidget>
+#include "ThreadModel.h"
+
+class QLabel;
+class QPushButton;
+class QTreeView;
+
+/**
+ * Conversation browser: scans a folder for MSG files in the background and
+ * shows them threaded (ThreadModel). Headers are parsed on the global thread
+ * pool and handed to the model in batches while the scan runs.
+ */
+class ConversationView : public QWidget {
+    Q_OBJECT
+    
+public:
+    explicit ConversationView(QWidget* parent = nullptr);
+    ~ConversationView();
+    
+    /** Replaces the current threads with the messages found below directory. */
+    void scanFolder(const QString& directory);
+    
+signals:
+    /** Emitted when the user double-clicks a message. */
+    void fileActivated(const QString& filePath);
+    
+private slots:
+    /** Asks for a folder and scans it. */
+    void onScanClicked();
+    /** Hands queued headers to the model. */
+    void flushPending();
+    /** Opens the message under a double-clicked row. */
+    void onDoubleClicked(const QModelIndex& index);
+    
+private:
+    /** Starts parsing once the file list is ready. */
+    void onFilesListed(const QStringList& files);
+    /** Queues newly parsed headers for the next batch. */
+    void onResultsReady(int begin, int end);
+    /** Finishes the scan. */
+    void onScanFinished();
+    /**
+     * Cancels the running scan without waiting for it: its watchers delete
+     * themselves once their workers are done, and their notifications are
+     * ignored because the scan generation has moved on.
+     */
+    void cancelScan();
+    /** Shows message/thread counts and scan speed. */
+    void updateStatus();
+    
+    QPushButton* m_scanButton;
+    QLabel* m_statusLabel;
+    QTreeView* m_treeView;
+    ThreadModel* m_model;
+    
+    /** Watchers of the current and of canceled, still running scans; waited for on destruction. */
+    QList<QFutureWatcherBase*> m_watchers;
+    /** Header parse of the current scan, or nullptr. */
+    QFutureWatcher<ThreadModel::MessageHeaders>* m_scanWatcher = nullptr;
+    /** Incremented by cancelScan(); notifications of older scans are dropped. */
+    quint64 m_generation = 0;
+    QList<ThreadModel::MessageHeaders> m_pending;
+    QTimer m_flushTimer;
+    QElapsedTimer m_timer;
+    QString m_lastDirectory;
+    int m_fileCount = 0;
+};
+
+#endif
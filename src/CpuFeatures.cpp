@@ -0,0 +1,66 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * Feature flags detected once on first use.
+ * GCC/Clang builtins already verify OS support for AVX state (XGETBV);
+ * on MSVC this is checked explicitly.
+ */
+struct Features {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool avx2 = false;
+    
+    Features() {
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+        int info[4] = {0, 0, 0, 0};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        
+        __cpuid(info, 1);
+        sse2 = (info[3] & (1 << 26)) != 0;
+        ssse3 = (info[2] & (1 << 9)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#elif defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        sse2 = __builtin_cpu_supports("sse2");
+        ssse3 = __builtin_cpu_supports("ssse3");
+        avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+const Features& features() {
+    static const Features detected;
+    return detected;
+}
+
+}
+
+namespace CpuFeatures {
+
+bool hasSse2() {
+    return features().sse2;
+}
+
+bool hasSsse3() {
+    return features().ssse3;
+}
+
+bool hasAvx2() {
+    return features().avx2;
+}
+
+}
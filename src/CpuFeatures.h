@@ -0,0 +1,31 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+/**
+ * Runtime detection of x86 SIMD extensions used by the vectorized code paths.
+ * On non-x86 targets every query returns false and callers use their scalar code.
+ */
+namespace CpuFeatures {
+
+/** True if SSE2 is available (always true on x86-64). */
+bool hasSse2();
+/** True if SSSE3 (pshufb) is available. */
+bool hasSsse3();
+/** True if AVX2 is available and enabled by the operating system. */
+bool hasAvx2();
+
+}
+
+// Helpers for declaring functions compiled for a specific instruction set.
+// MSVC accepts intrinsics without per-function target attributes.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_FEATURES_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+#include "DuplicateFinder.h"
+#include "MessageIds.h"
+#include "MsgParser.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using MessageIds::kFnvOffset;
+using MessageIds::kFnvPrime;
+
+// Fewer shingles than this give SimHashes that collide for unrelated short bodies
+constexpr int kMinShingles = 4;
+
+// The 64-bit SimHash is split into 4 bands of 16 bits: two hashes within 3 bits
+// of each other agree on at least one band, so comparing band-mates finds them all
+constexpr int kBandCount = 4;
+constexpr int kBandBits = 16;
+
+/** Finalizer from SplitMix64; spreads the bits of weak shingle hashes. */
+quint64 mix64(quint64 x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+quint64 rotl64(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/** Case-folds and collapses whitespace so cosmetic header differences don't matter. */
+QString normalizeHeaderText(const QString& text) {
+    return text.simplified().toCaseFolded();
+}
+
+/** Hash that is never 0, so 0 can mean "absent". */
+quint64 nonZero(quint64 hash) {
+    return hash ? hash : 1;
+}
+
+/** Disjoint-set forest with path halving and union by size. */
+class UnionFind {
+public:
+    explicit UnionFind(int size)
+        : m_parent(size)
+        , m_size(size, 1)
+    {
+        for (int i = 0; i < size; ++i) m_parent[i] = i;
+    }
+    
+    int find(int i) {
+        while (m_parent[i] != i) {
+            m_parent[i] = m_parent[m_parent[i]];
+            i = m_parent[i];
+        }
+        return i;
+    }
+    
+    void unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (m_size[a] < m_size[b]) std::swap(a, b);
+        m_parent[b] = a;
+        m_size[a] += m_size[b];
+    }
+    
+private:
+    std::vector<int> m_parent;
+    std::vector<int> m_size;
+};
+
+/** Unites all entries sharing a non-zero key. */
+template <typename KeyOf>
+void uniteByKey(const QList<DuplicateFinder::Fingerprint>& fingerprints, UnionFind& sets, KeyOf keyOf) {
+    QHash<quint64, int> firstByKey;
+    firstByKey.reserve(fingerprints.size());
+    for (int i = 0; i < fingerprints.size(); ++i) {
+        const quint64 key = keyOf(fingerprints[i]);
+        if (!fingerprints[i].isValid || key == 0) continue;
+        auto it = firstByKey.constFind(key);
+        if (it == firstByKey.constEnd()) {
+            firstByKey.insert(key, i);
+        } else {
+            sets.unite(*it, i);
+        }
+    }
+}
+
+}
+
+DuplicateFinder::Fingerprint DuplicateFinder::fingerprint(const QString& filePath, const EmailMessage& msg) {
+    Fingerprint fp;
+    fp.filePath = filePath;
+    fp.isValid = msg.isValid;
+    fp.errorMessage = msg.errorMessage;
+    if (!msg.isValid) return fp;
+    
+    fp.subject = msg.subject;
+    fp.sender = msg.senderEmail.isEmpty() ? msg.senderName : msg.senderEmail;
+    fp.date = msg.date;
+    
+    fp.messageIdHash = MessageIds::messageIdKey(msg.messageId);
+    
+    // Subject + sender + send time (to the second) identify a message; without
+    // a date, or with neither subject nor sender, too many unrelated messages match
+    const QString subject = normalizeHeaderText(msg.subject);
+    const QString sender = normalizeHeaderText(fp.sender);
+    if (msg.date.isValid() && (!subject.isEmpty() || !sender.isEmpty())) {
+        quint64 hash = MessageIds::fnv1a(subject);
+        hash = (hash ^ 0x1f) * kFnvPrime;
+        hash = MessageIds::fnv1a(sender, hash);
+        const qint64 seconds = msg.date.toSecsSinceEpoch();
+        for (int shift = 0; shift < 64; shift += 8) {
+            hash = (hash ^ ((seconds >> shift) & 0xff)) * kFnvPrime;
+        }
+        fp.headerHash = nonZero(hash);
+    }
+    
+    fp.hasSimHash = simHash(msg.bodyPlainText, fp.simHash);
+    return fp;
+}
+
+DuplicateFinder::Fingerprint DuplicateFinder::fingerprintFile(const QString& filePath) {
+    MsgParser parser;
+    parser.setOptions(ParseOptions::headersAndBody());
+    return fingerprint(filePath, parser.parse(filePath));
+}
+
+/**
+ * Words are maximal runs of letters and digits, case-folded and hashed with
+ * FNV-1a as they are scanned, so no intermediate strings are built. Each
+ * shingle of three consecutive words votes on all 64 bits; the sign of each
+ * bit's tally gives the hash.
+ */
+bool DuplicateFinder::simHash(const QString& text, quint64& hash) {
+    int tally[64] = {};
+    quint64 window[3] = {0, 0, 0};
+    int words = 0;
+    int shingles = 0;
+    
+    auto addShingle = [&](quint64 shingle) {
+        shingle = mix64(shingle);
+        for (int bit = 0; bit < 64; ++bit) {
+            tally[bit] += ((shingle >> bit) & 1) ? 1 : -1;
+        }
+        ++shingles;
+    };
+    
+    auto endWord = [&](quint64 wordHash) {
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = wordHash;
+        if (++words >= 3) {
+            addShingle(window[0] ^ rotl64(window[1], 21) ^ rotl64(window[2], 42));
+        }
+    };
+    
+    quint64 wordHash = kFnvOffset;
+    bool inWord = false;
+    for (const QChar ch : text) {
+        if (ch.isLetterOrNumber()) {
+            const char16_t c = ch.toCaseFolded().unicode();
+            wordHash = (wordHash ^ (c & 0xff)) * kFnvPrime;
+            wordHash = (wordHash ^ (c >> 8)) * kFnvPrime;
+            inWord = true;
+        } else if (inWord) {
+            endWord(wordHash);
+            wordHash = kFnvOffset;
+            inWord = false;
+        }
+    }
+    if (inWord) {
+        endWord(wordHash);
+    }
+    
+    if (shingles < kMinShingles) return false;
+    
+    hash = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (tally[bit] > 0) hash |= quint64(1) << bit;
+    }
+    return true;
+}
+
+QList<DuplicateFinder::Group> DuplicateFinder::group(const QList<Fingerprint>& fingerprints, int maxDistance) {
+    maxDistance = qBound(0, maxDistance, kBandCount - 1);
+    const int count = static_cast<int>(fingerprints.size());
+    UnionFind sets(count);
+    
+    // Exact duplicates
+    uniteByKey(fingerprints, sets, [](const Fingerprint& fp) { return fp.messageIdHash; });
+    uniteByKey(fingerprints, sets, [](const Fingerprint& fp) { return fp.headerHash; });
+    
+    // Identical bodies, keeping one representative per distinct SimHash
+    uniteByKey(fingerprints, sets, [](const Fingerprint& fp) { return fp.hasSimHash ? nonZero(fp.simHash) : 0; });
+    
+    // Near duplicates: bucket the distinct SimHashes by band, compare within buckets
+    if (maxDistance > 0) {
+        QHash<quint64, int> distinct;
+        for (int i = 0; i < count; ++i) {
+            if (fingerprints[i].isValid && fingerprints[i].hasSimHash) {
+                distinct.insert(fingerprints[i].simHash, i);
+            }
+        }
+        
+        std::vector<std::pair<quint64, int>> bucketed;
+        bucketed.reserve(static_cast<size_t>(distinct.size()));
+        for (int band = 0; band < kBandCount; ++band) {
+            bucketed.clear();
+            for (auto it = distinct.cbegin(); it != distinct.cend(); ++it) {
+                bucketed.emplace_back(it.key(), it.value());
+            }
+            // Sort by band value first, then by the whole hash so neighbours are similar
+            const int shift = band * kBandBits;
+            std::sort(bucketed.begin(), bucketed.end(), [shift](const auto& a, const auto& b) {
+                const quint64 bandA = (a.first >> shift) & 0xffff;
+                const quint64 bandB = (b.first >> shift) & 0xffff;
+                return bandA != bandB ? bandA < bandB : a.first < b.first;
+            });
+            
+            for (size_t i = 0; i < bucketed.size(); ++i) {
+                const quint64 bandValue = (bucketed[i].first >> shift) & 0xffff;
+                // Every pair in a bucket is compared: a capped scan would miss matches the banding guarantees
+                for (size_t j = i + 1; j < bucketed.size(); ++j) {
+                    if (((bucketed[j].first >> shift) & 0xffff) != bandValue) break;
+                    if (qPopulationCount(bucketed[i].first ^ bucketed[j].first) <= uint(maxDistance)) {
+                        sets.unite(bucketed[i].second, bucketed[j].second);
+                    }
+                }
+            }
+        }
+    }
+    
+    // Collect sets with more than one member
+    QHash<int, QList<int>> members;
+    for (int i = 0; i < count; ++i) {
+        if (fingerprints[i].isValid) {
+            members[sets.find(i)].append(i);
+        }
+    }
+    
+    QList<Group> groups;
+    for (auto it = members.cbegin(); it != members.cend(); ++it) {
+        const QList<int>& indices = it.value();
+        if (indices.size() < 2) continue;
+        
+        Group group;
+        const Fingerprint& first = fingerprints[indices.first()];
+        bool sameMessageId = first.messageIdHash != 0;
+        bool sameHeaders = first.headerHash != 0;
+        for (int index : indices) {
+            const Fingerprint& fp = fingerprints[index];
+            sameMessageId = sameMessageId && fp.messageIdHash == first.messageIdHash;
+            sameHeaders = sameHeaders && fp.headerHash == first.headerHash;
+            group.members.append(fp);
+        }
+        group.match = sameMessageId ? Match::MessageId : sameHeaders ? Match::Headers : Match::Content;
+        std::sort(group.members.begin(), group.members.end(), [](const Fingerprint& a, const Fingerprint& b) {
+            return a.filePath < b.filePath;
+        });
+        groups.append(group);
+    }
+    
+    // Largest groups first
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+        if (a.members.size() != b.members.size()) return a.members.size() > b.members.size();
+        return a.members.first().filePath < b.members.first().filePath;
+    });
+    return groups;
+}
+
+QString DuplicateFinder::matchName(Match match) {
+    switch (match) {
+        case Match::MessageId: return QCoreApplication::translate("DuplicateFinder", "Same Message-ID");
+        case Match::Headers: return QCoreApplication::translate("DuplicateFinder", "Same headers");
+        case Match::Content: return QCoreApplication::translate("DuplicateFinder", "Similar content");
+    }
+    return QString();
+}
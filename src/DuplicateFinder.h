@@ -0,0 +1,77 @@
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include "EmailTypes.h"
+
+/**
+ * Exact and near-duplicate detection for MSG files.
+ *
+ * Each message is reduced to a small fingerprint: a hash of its Internet
+ * Message-ID, a hash of its normalized headers (subject, sender, send time)
+ * and a 64-bit SimHash of its body text. Messages sharing a Message-ID or
+ * header hash are exact duplicates; messages whose SimHashes differ in at
+ * most a few bits are near duplicates (re-exports, forwards, quoted copies).
+ *
+ * Near-duplicate candidates are found with locality-sensitive hashing: the
+ * SimHash is split into bands and only messages sharing a band are compared,
+ * so grouping stays close to linear in the number of messages.
+ */
+class DuplicateFinder {
+public:
+    /** Strongest evidence linking the members of a group. */
+    enum class Match {
+        MessageId,
+        Headers,
+        Content
+    };
+    
+    /** Per-message fingerprint; only this is kept in memory during a scan. */
+    struct Fingerprint {
+        QString filePath;
+        QString subject;
+        QString sender;
+        QDateTime date;
+        /** Hash of the Message-ID, 0 if the message has none. */
+        quint64 messageIdHash = 0;
+        /** Hash of the normalized headers, 0 if they are too sparse to identify a message. */
+        quint64 headerHash = 0;
+        quint64 simHash = 0;
+        /** False when the body is too short for a meaningful SimHash. */
+        bool hasSimHash = false;
+        bool isValid = false;
+        QString errorMessage;
+    };
+    
+    /** A set of files holding the same (or nearly the same) message. */
+    struct Group {
+        Match match;
+        QList<Fingerprint> members;
+    };
+    
+    /** Default SimHash distance (in bits) up to which two bodies count as near duplicates. */
+    static constexpr int DefaultMaxDistance = 3;
+    
+    /** Computes the fingerprint of a parsed message. */
+    static Fingerprint fingerprint(const QString& filePath, const EmailMessage& msg);
+    
+    /** Parses a file (headers and plain text body only) and fingerprints it. */
+    static Fingerprint fingerprintFile(const QString& filePath);
+    
+    /** 64-bit SimHash over word 3-shingles of the text; returns false if the text has too few words. */
+    static bool simHash(const QString& text, quint64& hash);
+    
+    /**
+     * Groups fingerprints into duplicate sets; singletons are omitted.
+     * maxDistance is clamped to 3, the largest distance the LSH banding is guaranteed to find
+     * (every pair sharing a band is compared).
+     */
+    static QList<Group> group(const QList<Fingerprint>& fingerprints, int maxDistance = DefaultMaxDistance);
+    
+    /** User-visible description of a match kind. */
+    static QString matchName(Match match);
+};
+
+#endif
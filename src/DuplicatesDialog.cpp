@@ -0,0 +1,174 @@
+#include "DuplicatesDialog.h"
+#include "MsgFileModel.h"
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QHeaderView>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+namespace {
+
+// Tree items keep the file path of member rows in this role
+constexpr int FilePathRole = Qt::UserRole + 1;
+
+}
+
+DuplicatesDialog::DuplicatesDialog(const QString& directory, QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Duplicates in %1").arg(QDir::toNativeSeparators(directory)));
+    setAttribute(Qt::WA_DeleteOnClose);
+    resize(900, 500);
+    
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    
+    m_statusLabel = new QLabel(tr("Listing files..."));
+    layout->addWidget(m_statusLabel);
+    
+    m_progressBar = new QProgressBar;
+    m_progressBar->setRange(0, 0);
+    layout->addWidget(m_progressBar);
+    
+    m_resultTree = new QTreeWidget;
+    m_resultTree->setHeaderLabels({tr("Subject / File"), tr("Sender"), tr("Date"), tr("Match")});
+    m_resultTree->setAlternatingRowColors(true);
+    m_resultTree->setUniformRowHeights(true);
+    m_resultTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_resultTree->header()->setStretchLastSection(false);
+    connect(m_resultTree, &QTreeWidget::itemDoubleClicked, this, &DuplicatesDialog::onItemDoubleClicked);
+    layout->addWidget(m_resultTree, 1);
+    
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    m_cancelButton = buttons->addButton(tr("Stop Scan"), QDialogButtonBox::ActionRole);
+    connect(m_cancelButton, &QPushButton::clicked, this, &DuplicatesDialog::onCancel);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+    
+    connect(&m_listWatcher, &QFutureWatcher<QStringList>::finished, this, &DuplicatesDialog::onFilesListed);
+    connect(&m_scanWatcher, &QFutureWatcher<DuplicateFinder::Fingerprint>::progressValueChanged,
+            this, &DuplicatesDialog::onScanProgress);
+    connect(&m_scanWatcher, &QFutureWatcher<DuplicateFinder::Fingerprint>::finished,
+            this, &DuplicatesDialog::onScanFinished);
+    connect(&m_groupWatcher, &QFutureWatcher<QList<DuplicateFinder::Group>>::finished,
+            this, &DuplicatesDialog::onGroupingFinished);
+    
+    m_timer.start();
+    m_listWatcher.setFuture(QtConcurrent::run(&MsgFileModel::findMessageFiles, directory));
+}
+
+DuplicatesDialog::~DuplicatesDialog() {
+    cancelScan();
+}
+
+void DuplicatesDialog::onFilesListed() {
+    if (m_listWatcher.isCanceled()) return;
+    
+    const QStringList files = m_listWatcher.result();
+    if (files.isEmpty()) {
+        m_statusLabel->setText(tr("No MSG files found."));
+        m_progressBar->hide();
+        m_cancelButton->setEnabled(false);
+        return;
+    }
+    
+    // Workers parse headers and plain text bodies only and keep just the
+    // fingerprint, so memory stays proportional to the number of files
+    m_progressBar->setRange(0, static_cast<int>(files.size()));
+    m_statusLabel->setText(tr("Scanning %1 files...").arg(files.size()));
+    m_scanWatcher.setFuture(QtConcurrent::mapped(files, &DuplicateFinder::fingerprintFile));
+}
+
+void DuplicatesDialog::onScanProgress(int value) {
+    m_progressBar->setValue(value);
+    const qint64 elapsed = m_timer.elapsed();
+    if (elapsed > 0) {
+        m_statusLabel->setText(tr("Scanning %1 of %2 files (%3 files/s)...")
+            .arg(value).arg(m_progressBar->maximum()).arg(value * 1000 / elapsed));
+    }
+}
+
+void DuplicatesDialog::onScanFinished() {
+    if (m_scanWatcher.isCanceled()) return;
+    
+    const QList<DuplicateFinder::Fingerprint> fingerprints = m_scanWatcher.future().results();
+    m_failedFiles = 0;
+    for (const auto& fp : fingerprints) {
+        if (!fp.isValid) ++m_failedFiles;
+    }
+    
+    m_progressBar->setRange(0, 0);
+    m_statusLabel->setText(tr("Grouping %1 messages...").arg(fingerprints.size()));
+    m_groupWatcher.setFuture(QtConcurrent::run([fingerprints]() {
+        return DuplicateFinder::group(fingerprints);
+    }));
+}
+
+void DuplicatesDialog::onGroupingFinished() {
+    if (m_groupWatcher.isCanceled()) return;
+    
+    const QList<DuplicateFinder::Group> groups = m_groupWatcher.result();
+    m_progressBar->hide();
+    m_cancelButton->setEnabled(false);
+    
+    int duplicateFiles = 0;
+    m_resultTree->setUpdatesEnabled(false);
+    for (const auto& group : groups) {
+        const DuplicateFinder::Fingerprint& first = group.members.first();
+        QTreeWidgetItem* groupItem = new QTreeWidgetItem(m_resultTree);
+        groupItem->setText(0, tr("%1 (%2 copies)")
+            .arg(first.subject.isEmpty() ? tr("(no subject)") : first.subject)
+            .arg(group.members.size()));
+        groupItem->setText(1, first.sender);
+        groupItem->setText(2, first.date.toLocalTime().toString(Qt::ISODate));
+        groupItem->setText(3, DuplicateFinder::matchName(group.match));
+        
+        for (const auto& member : group.members) {
+            QTreeWidgetItem* item = new QTreeWidgetItem(groupItem);
+            item->setText(0, QDir::toNativeSeparators(member.filePath));
+            item->setText(1, member.sender);
+            item->setText(2, member.date.toLocalTime().toString(Qt::ISODate));
+            item->setData(0, FilePathRole, member.filePath);
+        }
+        duplicateFiles += static_cast<int>(group.members.size()) - 1;
+    }
+    m_resultTree->setUpdatesEnabled(true);
+    m_resultTree->resizeColumnToContents(1);
+    m_resultTree->resizeColumnToContents(2);
+    m_resultTree->resizeColumnToContents(3);
+    
+    QString status = tr("%1 duplicate groups, %2 redundant files (%3 s)")
+        .arg(groups.size()).arg(duplicateFiles).arg(m_timer.elapsed() / 1000.0, 0, 'f', 1);
+    if (m_failedFiles > 0) {
+        status += tr("; %1 files could not be parsed").arg(m_failedFiles);
+    }
+    m_statusLabel->setText(status);
+    
+    emit groupsFound(groups);
+}
+
+void DuplicatesDialog::onItemDoubleClicked(QTreeWidgetItem* item, int column) {
+    Q_UNUSED(column);
+    const QString filePath = item->data(0, FilePathRole).toString();
+    if (!filePath.isEmpty()) {
+        emit fileActivated(filePath);
+    }
+}
+
+void DuplicatesDialog::onCancel() {
+    cancelScan();
+    m_progressBar->hide();
+    m_cancelButton->setEnabled(false);
+    m_statusLabel->setText(tr("Scan stopped."));
+}
+
+void DuplicatesDialog::cancelScan() {
+    // Listing and grouping cannot be interrupted; cancelling only drops their result
+    m_listWatcher.cancel();
+    m_scanWatcher.cancel();
+    m_groupWatcher.cancel();
+    m_scanWatcher.waitForFinished();
+}
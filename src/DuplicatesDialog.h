@@ -0,0 +1,63 @@
+#ifndef DUPLICATESDIALOG_H
+#define DUPLICATESDIALOG_H
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include "DuplicateFinder.h"
+
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/**
+ * Scans a directory tree for duplicate messages and lists the groups found.
+ * Files are enumerated, fingerprinted and grouped on the global thread pool
+ * (QtConcurrent); the dialog stays responsive and the scan can be cancelled.
+ */
+class DuplicatesDialog : public QDialog {
+    Q_OBJECT
+    
+public:
+    explicit DuplicatesDialog(const QString& directory, QWidget* parent = nullptr);
+    ~DuplicatesDialog();
+    
+signals:
+    /** Emitted when the user double-clicks a file in the result list. */
+    void fileActivated(const QString& filePath);
+    /** Emitted once the scan has finished grouping. */
+    void groupsFound(const QList<DuplicateFinder::Group>& groups);
+    
+private slots:
+    /** Starts fingerprinting once the file list is ready. */
+    void onFilesListed();
+    /** Updates the progress display while fingerprinting. */
+    void onScanProgress(int value);
+    /** Starts grouping once all fingerprints are computed. */
+    void onScanFinished();
+    /** Fills the result tree once grouping is done. */
+    void onGroupingFinished();
+    /** Opens the file under a double-clicked row. */
+    void onItemDoubleClicked(QTreeWidgetItem* item, int column);
+    /** Cancels a running scan. */
+    void onCancel();
+    
+private:
+    /** Stops any running step and waits for its workers. */
+    void cancelScan();
+    
+    QLabel* m_statusLabel;
+    QProgressBar* m_progressBar;
+    QTreeWidget* m_resultTree;
+    QPushButton* m_cancelButton;
+    
+    QFutureWatcher<QStringList> m_listWatcher;
+    QFutureWatcher<DuplicateFinder::Fingerprint> m_scanWatcher;
+    QFutureWatcher<QList<DuplicateFinder::Group>> m_groupWatcher;
+    QElapsedTimer m_timer;
+    int m_failedFiles = 0;
+};
+
+#endif
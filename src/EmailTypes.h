@@ -13,7 +13,7 @@ struct EmailAttachment {
     QString filename;
     QString mimeType;
     QByteArray data;
-    qint64 size;
+    qint64 size = 0;
 };
 
 /**
@@ -30,6 +30,11 @@ struct EmailMessage {
     QString ccRecipients;
     QString bccRecipients;
     QDateTime date;
+    QString messageId;
+    QString inReplyTo;
+    QString references;
+    QString conversationTopic;
+    QByteArray conversationIndex;
     QList<EmailAttachment> attachments;
     bool isValid = false;
     QString errorMessage;
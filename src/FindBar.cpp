@@ -0,0 +1,302 @@
+#include "FindBar.h"
+#include <QEvent>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QScrollBar>
+#include <QShortcut>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <QTimer>
+#include <QToolButton>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Highlights drawn at most, however many hits are visible
+constexpr int kMaxVisibleHighlights = 1000;
+
+}
+
+FindBar::FindBar(QTextEdit* view, QWidget* parent)
+    : QWidget(parent)
+    , m_view(view)
+{
+    QHBoxLayout* layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    
+    layout->addWidget(new QLabel(tr("Find:")));
+    
+    m_queryEdit = new QLineEdit;
+    m_queryEdit->setClearButtonEnabled(true);
+    m_queryEdit->installEventFilter(this);
+    connect(m_queryEdit, &QLineEdit::textChanged, this, &FindBar::onQueryChanged);
+    layout->addWidget(m_queryEdit, 1);
+    
+    m_statusLabel = new QLabel;
+    layout->addWidget(m_statusLabel);
+    
+    m_previousButton = new QToolButton;
+    m_previousButton->setArrowType(Qt::UpArrow);
+    m_previousButton->setToolTip(tr("Previous match (Shift+F3)"));
+    connect(m_previousButton, &QToolButton::clicked, this, &FindBar::findPrevious);
+    layout->addWidget(m_previousButton);
+    
+    m_nextButton = new QToolButton;
+    m_nextButton->setArrowType(Qt::DownArrow);
+    m_nextButton->setToolTip(tr("Next match (F3)"));
+    connect(m_nextButton, &QToolButton::clicked, this, &FindBar::findNext);
+    layout->addWidget(m_nextButton);
+    
+    QToolButton* closeButton = new QToolButton;
+    closeButton->setText(tr("Close"));
+    connect(closeButton, &QToolButton::clicked, this, &FindBar::onClose);
+    layout->addWidget(closeButton);
+    
+    QShortcut* escape = new QShortcut(QKeySequence(Qt::Key_Escape), this);
+    escape->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(escape, &QShortcut::activated, this, &FindBar::onClose);
+    
+    // Highlights cover the visible hits only, so they follow the viewport
+    connect(m_view->verticalScrollBar(), &QScrollBar::valueChanged, this, &FindBar::updateHighlights);
+    connect(m_view->horizontalScrollBar(), &QScrollBar::valueChanged, this, &FindBar::updateHighlights);
+    m_view->viewport()->installEventFilter(this);
+    
+    connect(&m_watcher, &QFutureWatcher<SearchOutcome>::finished, this, &FindBar::onSearchFinished);
+    
+    updateStatus();
+    hide();
+}
+
+FindBar::~FindBar() {
+    // The search works on its own copies; it only has to stop early
+    cancelSearch();
+}
+
+void FindBar::activate() {
+    show();
+    m_queryEdit->setFocus(Qt::ShortcutFocusReason);
+    m_queryEdit->selectAll();
+    // Hits are kept while hidden unless the document changed; then this searches again
+    startSearch();
+    updateHighlights();
+}
+
+void FindBar::findNext() {
+    if (isHidden() || m_queryEdit->text().isEmpty()) {
+        activate();
+        return;
+    }
+    if (m_hits.isEmpty()) return;
+    moveTo((m_current + 1) % m_hits.size());
+}
+
+void FindBar::findPrevious() {
+    if (isHidden() || m_queryEdit->text().isEmpty()) {
+        activate();
+        return;
+    }
+    if (m_hits.isEmpty()) return;
+    moveTo(m_current <= 0 ? m_hits.size() - 1 : m_current - 1);
+}
+
+void FindBar::reset() {
+    cancelSearch();
+    ++m_generation;
+    m_foldedText.clear();
+    m_textReady = false;
+    m_needle.clear();
+    m_hits.clear();
+    m_truncated = false;
+    m_current = -1;
+    if (!isHidden() && !m_queryEdit->text().isEmpty()) {
+        startSearch();
+    } else {
+        updateStatus();
+    }
+}
+
+bool FindBar::eventFilter(QObject* watched, QEvent* event) {
+    if (watched == m_view->viewport() && event->type() == QEvent::Resize) {
+        // The viewer lays the document out again after the viewport resized
+        QTimer::singleShot(0, this, &FindBar::updateHighlights);
+    } else if (watched == m_queryEdit && event->type() == QEvent::KeyPress) {
+        const QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+        if (keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter) {
+            if (keyEvent->modifiers() & Qt::ShiftModifier) {
+                findPrevious();
+            } else {
+                findNext();
+            }
+            return true;
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void FindBar::onQueryChanged() {
+    startSearch();
+}
+
+void FindBar::startSearch() {
+    const QString needle = TextSearch::fold(m_queryEdit->text());
+    if (needle.isEmpty()) {
+        cancelSearch();
+        m_searchPending = false;
+        m_needle.clear();
+        m_hits.clear();
+        m_truncated = false;
+        m_current = -1;
+        updateStatus();
+        updateHighlights();
+        return;
+    }
+    
+    if (m_watcher.isRunning()) {
+        // Search again once the running search has given up
+        cancelSearch();
+        m_searchPending = true;
+        return;
+    }
+    m_searchPending = false;
+    if (m_textReady && needle == m_needle) {
+        updateStatus();
+        return;
+    }
+    
+    SearchRequest request;
+    request.generation = m_generation;
+    request.needle = needle;
+    if (m_textReady) {
+        request.text = m_foldedText;
+        request.textFolded = true;
+        // Extending the query can only remove hits
+        request.refine = !m_needle.isEmpty() && !m_truncated && needle.startsWith(m_needle);
+        if (request.refine) request.baseHits = m_hits;
+    } else {
+        // Positions in the plain text are document positions; folding happens on the worker
+        request.text = m_view->document()->toPlainText();
+        m_statusLabel->setText(tr("Searching..."));
+    }
+    
+    m_cancel = QSharedPointer<QAtomicInt>::create();
+    m_watcher.setFuture(QtConcurrent::run(&FindBar::search, request, m_cancel));
+}
+
+void FindBar::cancelSearch() {
+    if (m_cancel) m_cancel->storeRelaxed(1);
+}
+
+FindBar::SearchOutcome FindBar::search(const SearchRequest& request, QSharedPointer<QAtomicInt> cancel) {
+    SearchOutcome outcome;
+    outcome.generation = request.generation;
+    outcome.needle = request.needle;
+    outcome.foldedText = request.textFolded ? request.text : TextSearch::fold(request.text);
+    outcome.result = request.refine
+        ? TextSearch::refine(outcome.foldedText, request.baseHits, request.needle, cancel.data())
+        : TextSearch::findAll(outcome.foldedText, request.needle, cancel.data());
+    return outcome;
+}
+
+void FindBar::onSearchFinished() {
+    const SearchOutcome outcome = m_watcher.result();
+    if (outcome.generation != m_generation) {
+        // Started for a document that has been replaced since
+        if (m_searchPending) startSearch();
+        return;
+    }
+    
+    // The folded text is worth keeping even if the search itself was canceled
+    if (!m_textReady) {
+        m_foldedText = outcome.foldedText;
+        m_textReady = true;
+    }
+    
+    if (!outcome.result.canceled) {
+        // Stay on the current hit if it is still a hit, else take the first one below it (or the viewport top)
+        const int anchor = m_current >= 0 && m_current < m_hits.size()
+            ? m_hits.at(m_current)
+            : m_view->cursorForPosition(QPoint(0, 0)).position();
+        m_needle = outcome.needle;
+        m_hits = outcome.result.hits;
+        m_truncated = outcome.result.truncated;
+        m_current = -1;
+        if (!m_searchPending && !m_hits.isEmpty()) {
+            const auto it = std::lower_bound(m_hits.cbegin(), m_hits.cend(), anchor);
+            moveTo(it == m_hits.cend() ? 0 : int(it - m_hits.cbegin()));
+        }
+    }
+    
+    if (m_searchPending) {
+        startSearch();
+        return;
+    }
+    updateStatus();
+    updateHighlights();
+}
+
+void FindBar::onClose() {
+    cancelSearch();
+    m_searchPending = false;
+    hide();
+    m_view->setExtraSelections({});
+    m_view->setFocus();
+}
+
+void FindBar::moveTo(int index) {
+    m_current = index;
+    QTextCursor cursor(m_view->document());
+    cursor.setPosition(m_hits.at(index));
+    m_view->setTextCursor(cursor);
+    // Scrolls only if the hit is not visible; the scroll bars then update the highlights
+    m_view->ensureCursorVisible();
+    updateStatus();
+    updateHighlights();
+}
+
+void FindBar::updateStatus() {
+    const bool hasHits = !m_hits.isEmpty();
+    m_previousButton->setEnabled(hasHits);
+    m_nextButton->setEnabled(hasHits);
+    if (m_queryEdit->text().isEmpty() || !m_textReady) {
+        m_statusLabel->clear();
+    } else if (!hasHits) {
+        m_statusLabel->setText(tr("No matches"));
+    } else {
+        m_statusLabel->setText(tr("%1 of %2%3")
+            .arg(m_current + 1).arg(m_hits.size()).arg(m_truncated ? QStringLiteral("+") : QString()));
+    }
+}
+
+void FindBar::updateHighlights() {
+    if (isHidden() || m_hits.isEmpty()) {
+        m_view->setExtraSelections({});
+        return;
+    }
+    
+    // Document range shown in the viewport; a hit starting just above it may still reach into it
+    const QRect area = m_view->viewport()->rect();
+    const int first = m_view->cursorForPosition(area.topLeft()).position() - int(m_needle.size());
+    const int last = m_view->cursorForPosition(area.bottomRight()).position();
+    
+    QTextCharFormat hitFormat;
+    hitFormat.setBackground(QColor(255, 235, 60));
+    hitFormat.setForeground(Qt::black);
+    QTextCharFormat currentFormat = hitFormat;
+    currentFormat.setBackground(QColor(255, 150, 30));
+    
+    QList<QTextEdit::ExtraSelection> selections;
+    for (auto it = std::lower_bound(m_hits.cbegin(), m_hits.cend(), first);
+         it != m_hits.cend() && *it <= last && selections.size() < kMaxVisibleHighlights; ++it) {
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(m_view->document());
+        selection.cursor.setPosition(*it);
+        selection.cursor.setPosition(*it + int(m_needle.size()), QTextCursor::KeepAnchor);
+        selection.format = it - m_hits.cbegin() == m_current ? currentFormat : hitFormat;
+        selections.append(selection);
+    }
+    m_view->setExtraSelections(selections);
+}
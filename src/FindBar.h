@@ -0,0 +1,99 @@
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QWidget>
+#include "TextSearch.h"
+
+class QLabel;
+class QLineEdit;
+class QTextEdit;
+class QToolButton;
+
+/**
+ * Find-in-message bar below a body viewer (Ctrl+F, F3, Shift+F3, Escape).
+ *
+ * Searches run on the global thread pool over the case-folded plain text of
+ * the document, which is built once per document and kept until reset().
+ * While the query is being extended, only the previous hits are re-checked.
+ * A search still running when the query changes is canceled. Only the hits
+ * inside the visible part of the viewer are highlighted; the highlights
+ * follow scrolling and resizing.
+ */
+class FindBar : public QWidget {
+    Q_OBJECT
+    
+public:
+    explicit FindBar(QTextEdit* view, QWidget* parent = nullptr);
+    ~FindBar();
+    
+    /** Shows the bar and selects the query so it can be replaced. */
+    void activate();
+    /** Moves to the next hit, wrapping around; shows the bar if there is no query yet. */
+    void findNext();
+    /** Moves to the previous hit, wrapping around. */
+    void findPrevious();
+    /** Forgets hits and the cached text; call whenever the viewer's document is replaced. */
+    void reset();
+    
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+    
+private slots:
+    void onQueryChanged();
+    void onSearchFinished();
+    /** Hides the bar and removes the highlights. */
+    void onClose();
+    /** Highlights the hits in the visible part of the viewer. */
+    void updateHighlights();
+    
+private:
+    /** Input of a background search; with refine set only baseHits are re-checked. */
+    struct SearchRequest {
+        int generation = 0;
+        QString text;
+        bool textFolded = false;
+        QString needle;
+        bool refine = false;
+        QList<int> baseHits;
+    };
+    
+    struct SearchOutcome {
+        int generation = 0;
+        QString foldedText;
+        QString needle;
+        TextSearch::Result result;
+    };
+    
+    static SearchOutcome search(const SearchRequest& request, QSharedPointer<QAtomicInt> cancel);
+    /** Starts a search for the current query, or notes that one is due once the running one stops. */
+    void startSearch();
+    void cancelSearch();
+    /** Makes hit index the current one and scrolls it into view. */
+    void moveTo(int index);
+    void updateStatus();
+    
+    QTextEdit* m_view;
+    QLineEdit* m_queryEdit;
+    QLabel* m_statusLabel;
+    QToolButton* m_previousButton;
+    QToolButton* m_nextButton;
+    
+    /** Bumped by reset(), so results for a replaced document are dropped. */
+    int m_generation = 0;
+    /** Case-folded plain text of the document; valid if m_textReady. */
+    QString m_foldedText;
+    bool m_textReady = false;
+    /** Folded query the hits belong to. */
+    QString m_needle;
+    QList<int> m_hits;
+    bool m_truncated = false;
+    int m_current = -1;
+    
+    QFutureWatcher<SearchOutcome> m_watcher;
+    QSharedPointer<QAtomicInt> m_cancel;
+    bool m_searchPending = false;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "FolderAnalytics.h"
+#include "MsgParser.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Files handed to a worker per lock of the shared directory iterator
+constexpr int kBatchSize = 32;
+
+const QString kOtherType = QStringLiteral("(other)");
+
+/** Adds to a type's totals; once MaxAttachmentTypes types exist, new ones go to "(other)". */
+void addType(QHash<QString, FolderAnalytics::TypeStats>& types, const QString& type,
+             qint64 attachments, qint64 bytes) {
+    auto it = types.find(type);
+    if (it == types.end()) {
+        if (types.size() >= FolderAnalytics::MaxAttachmentTypes - 1 && type != kOtherType) {
+            it = types.find(kOtherType);
+            if (it == types.end()) it = types.insert(kOtherType, FolderAnalytics::TypeStats());
+        } else {
+            it = types.insert(type, FolderAnalytics::TypeStats());
+        }
+    }
+    it->attachments += attachments;
+    it->bytes += bytes;
+}
+
+QString attachmentType(const EmailAttachment& att) {
+    const QString suffix = QFileInfo(att.filename).suffix().toLower();
+    if (!suffix.isEmpty()) return suffix;
+    if (!att.mimeType.isEmpty()) return att.mimeType.toLower();
+    return QStringLiteral("(none)");
+}
+
+int sizeBucket(qint64 size) {
+    int bits = 0;
+    while (size > 0) {
+        ++bits;
+        size >>= 1;
+    }
+    return qBound(0, bits - 10, FolderAnalytics::SizeBuckets - 1);
+}
+
+QJsonArray topArray(const TopCounter& counter, const char* keyName, int topCount) {
+    QJsonArray array;
+    for (const TopCounter::Item& item : counter.top(topCount)) {
+        QJsonObject row;
+        row[QLatin1String(keyName)] = item.key;
+        row["messages"] = item.count;
+        row["maxOverestimate"] = item.error;
+        array.append(row);
+    }
+    return array;
+}
+
+QByteArray csvField(const QString& text) {
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n')) return text.toUtf8();
+    QString quoted = text;
+    quoted.replace('"', QLatin1String("\"\""));
+    return '"' + quoted.toUtf8() + '"';
+}
+
+void csvRow(QByteArray& csv, const char* table, const QString& key, qint64 count,
+            qint64 bytes = -1, qint64 error = -1) {
+    csv += table;
+    csv += ',' + csvField(key) + ',' + QByteArray::number(count) + ',';
+    if (bytes >= 0) csv += QByteArray::number(bytes);
+    csv += ',';
+    if (error >= 0) csv += QByteArray::number(error);
+    csv += '\n';
+}
+
+}
+
+void FolderAnalytics::Report::add(const EmailMessage& msg) {
+    ++messages;
+    ++messagesPerMonth[msg.date.isValid() ? msg.date.toLocalTime().toString("yyyy-MM") : QStringLiteral("unknown")];
+    
+    const QString email = msg.senderEmail.trimmed().toLower();
+    if (!email.isEmpty()) {
+        senders.add(email);
+        const qsizetype at = email.lastIndexOf('@');
+        senderDomains.add(at >= 0 ? email.mid(at + 1) : QStringLiteral("(none)"));
+    } else {
+        senders.add(msg.senderName.isEmpty() ? QStringLiteral("(unknown)") : msg.senderName.trimmed());
+        senderDomains.add(QStringLiteral("(none)"));
+    }
+    
+    for (const EmailAttachment& att : msg.attachments) {
+        ++attachments;
+        attachmentBytes += att.size;
+        addType(attachmentTypes, attachmentType(att), 1, att.size);
+        ++attachmentSizes[sizeBucket(att.size)];
+    }
+}
+
+void FolderAnalytics::Report::merge(const Report& other) {
+    messages += other.messages;
+    failedFiles += other.failedFiles;
+    attachments += other.attachments;
+    attachmentBytes += other.attachmentBytes;
+    for (auto it = other.messagesPerMonth.cbegin(); it != other.messagesPerMonth.cend(); ++it) {
+        messagesPerMonth[it.key()] += it.value();
+    }
+    for (auto it = other.attachmentTypes.cbegin(); it != other.attachmentTypes.cend(); ++it) {
+        addType(attachmentTypes, it.key(), it->attachments, it->bytes);
+    }
+    for (int i = 0; i < SizeBuckets; ++i) {
+        attachmentSizes[i] += other.attachmentSizes.at(i);
+    }
+    senders.merge(other.senders);
+    senderDomains.merge(other.senderDomains);
+}
+
+QStringList FolderAnalytics::Report::attachmentTypesByBytes() const {
+    QStringList keys = attachmentTypes.keys();
+    std::sort(keys.begin(), keys.end(), [this](const QString& a, const QString& b) {
+        const qint64 bytesA = attachmentTypes.value(a).bytes;
+        const qint64 bytesB = attachmentTypes.value(b).bytes;
+        return bytesA != bytesB ? bytesA > bytesB : a < b;
+    });
+    return keys;
+}
+
+QByteArray FolderAnalytics::Report::toJson(int topCount) const {
+    QJsonObject root;
+    root["directory"] = directory;
+    root["messages"] = messages;
+    root["failedFiles"] = failedFiles;
+    root["attachments"] = attachments;
+    root["attachmentBytes"] = attachmentBytes;
+    
+    QJsonArray months;
+    for (auto it = messagesPerMonth.cbegin(); it != messagesPerMonth.cend(); ++it) {
+        months.append(QJsonObject{{"month", it.key()}, {"messages", it.value()}});
+    }
+    root["messagesPerMonth"] = months;
+    
+    QJsonArray types;
+    for (const QString& type : attachmentTypesByBytes()) {
+        const TypeStats stats = attachmentTypes.value(type);
+        types.append(QJsonObject{{"type", type}, {"attachments", stats.attachments}, {"bytes", stats.bytes}});
+    }
+    root["attachmentTypes"] = types;
+    
+    QJsonArray sizes;
+    for (int i = 0; i < SizeBuckets; ++i) {
+        if (attachmentSizes.at(i) == 0) continue;
+        sizes.append(QJsonObject{{"belowBytes", sizeBucketLimit(i)}, {"attachments", attachmentSizes.at(i)}});
+    }
+    root["attachmentSizes"] = sizes;
+    
+    root["topSenders"] = topArray(senders, "sender", topCount);
+    root["topSenderDomains"] = topArray(senderDomains, "domain", topCount);
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray FolderAnalytics::Report::toCsv(int topCount) const {
+    QByteArray csv = "table,key,count,bytes,max_overestimate\n";
+    csvRow(csv, "total", "messages", messages);
+    csvRow(csv, "total", "failed_files", failedFiles);
+    csvRow(csv, "total", "attachments", attachments, attachmentBytes);
+    for (auto it = messagesPerMonth.cbegin(); it != messagesPerMonth.cend(); ++it) {
+        csvRow(csv, "month", it.key(), it.value());
+    }
+    for (const QString& type : attachmentTypesByBytes()) {
+        const TypeStats stats = attachmentTypes.value(type);
+        csvRow(csv, "attachment_type", type, stats.attachments, stats.bytes);
+    }
+    for (int i = 0; i < SizeBuckets; ++i) {
+        if (attachmentSizes.at(i) == 0) continue;
+        csvRow(csv, "attachment_size_below", QString::number(sizeBucketLimit(i)), attachmentSizes.at(i));
+    }
+    for (const TopCounter::Item& item : senders.top(topCount)) {
+        csvRow(csv, "sender", item.key, item.count, -1, item.error);
+    }
+    for (const TopCounter::Item& item : senderDomains.top(topCount)) {
+        csvRow(csv, "sender_domain", item.key, item.count, -1, item.error);
+    }
+    return csv;
+}
+
+FolderAnalytics::Report FolderAnalytics::analyze(const QString& directory, Progress* progress) {
+    QMutex iteratorMutex;
+    QDirIterator files(directory, QStringList() << "*.msg", QDir::Files, QDirIterator::Subdirectories);
+    
+    auto nextBatch = [&](QStringList* batch) {
+        batch->clear();
+        QMutexLocker locker(&iteratorMutex);
+        while (batch->size() < kBatchSize && files.hasNext()) {
+            batch->append(files.next());
+        }
+        return !batch->isEmpty();
+    };
+    
+    // Each worker owns a partial report; nothing is shared but the iterator
+    auto worker = [&]() {
+        Report partial;
+        MsgParser parser;
+        parser.setOptions(ParseOptions::headersAndAttachmentList());
+        QStringList batch;
+        while (nextBatch(&batch)) {
+            for (const QString& filePath : batch) {
+                if (progress && progress->canceled.loadRelaxed()) return partial;
+                
+                const EmailMessage msg = parser.parse(filePath);
+                if (msg.isValid) {
+                    partial.add(msg);
+                } else {
+                    ++partial.failedFiles;
+                }
+                if (progress) progress->scanned.fetchAndAddRelaxed(1);
+            }
+        }
+        return partial;
+    };
+    
+    // The calling thread is one of the workers
+    QList<QFuture<Report>> helpers;
+    for (int i = 1; i < QThreadPool::globalInstance()->maxThreadCount(); ++i) {
+        helpers.append(QtConcurrent::run(worker));
+    }
+    Report report = worker();
+    for (QFuture<Report>& helper : helpers) {
+        report.merge(helper.result());
+    }
+    report.directory = directory;
+    return report;
+}
+
+qint64 FolderAnalytics::sizeBucketLimit(int bucket) {
+    return qint64(1) << (bucket + 10);
+}
@@ -0,0 +1,82 @@
+#ifndef FOLDERANALYTICS_H
+#define FOLDERANALYTICS_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include "EmailTypes.h"
+#include "TopCounter.h"
+
+/**
+ * Folder-level statistics: messages per month, attachment volume by type
+ * and size, top senders and sender domains.
+ *
+ * A scan parses headers and the attachment list only (no bodies, no
+ * payloads). Every worker thread folds its messages into its own Report and
+ * the partial reports are merged once at the end, so workers never contend
+ * on shared counters. A Report has a bounded size: months and size buckets
+ * are few, attachment types are capped and senders are kept in a fixed
+ * number of Space-Saving counters, so memory does not grow with the number
+ * of files. Files are enumerated while they are scanned, not listed first.
+ */
+class FolderAnalytics {
+public:
+    /** Rows in the top-N tables unless asked otherwise. */
+    static constexpr int DefaultTopCount = 20;
+    /** Distinct attachment types tracked; further types are counted as "(other)". */
+    static constexpr int MaxAttachmentTypes = 256;
+    /** Attachment size buckets: bucket i holds sizes below 2^(i + 10) bytes (1 KiB, 2 KiB, ...). */
+    static constexpr int SizeBuckets = 24;
+    
+    struct TypeStats {
+        qint64 attachments = 0;
+        qint64 bytes = 0;
+    };
+    
+    /** Aggregated statistics of a set of messages. */
+    struct Report {
+        QString directory;
+        qint64 messages = 0;
+        qint64 failedFiles = 0;
+        qint64 attachments = 0;
+        qint64 attachmentBytes = 0;
+        /** Messages per "yyyy-MM" (local time); "unknown" for messages without a date. */
+        QMap<QString, qint64> messagesPerMonth;
+        /** Keyed by lower-case file extension, else MIME type, else "(none)". */
+        QHash<QString, TypeStats> attachmentTypes;
+        QList<qint64> attachmentSizes = QList<qint64>(SizeBuckets);
+        TopCounter senders;
+        TopCounter senderDomains;
+        
+        /** Counts one parsed message. */
+        void add(const EmailMessage& msg);
+        /** Adds the counts of other into this report. */
+        void merge(const Report& other);
+        /** Attachment types by total bytes, largest first. */
+        QStringList attachmentTypesByBytes() const;
+        
+        QByteArray toJson(int topCount = DefaultTopCount) const;
+        /** One table in long format: table,key,count,bytes,max_overestimate. */
+        QByteArray toCsv(int topCount = DefaultTopCount) const;
+    };
+    
+    /** Shared with a running scan: files done so far, and a flag to stop early. */
+    struct Progress {
+        QAtomicInt scanned;
+        QAtomicInt canceled;
+    };
+    
+    /**
+     * Scans .msg files under directory (recursively) on the global thread pool
+     * and the calling thread; returns when all are counted or progress is canceled.
+     */
+    static Report analyze(const QString& directory, Progress* progress = nullptr);
+    
+    /** Upper bound (exclusive) of an attachment size bucket, in bytes. */
+    static qint64 sizeBucketLimit(int bucket);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "LatencyHistogram.h"
+#include <QtAlgorithms>
+#include <cmath>
+
+namespace {
+
+// Buckets per power of two (2^kSubBucketBits) and the number of exact buckets below them
+constexpr int kSubBucketBits = 5;
+constexpr int kSubBuckets = 1 << kSubBucketBits;
+constexpr int kLinearBuckets = 2 * kSubBuckets;
+
+}
+
+LatencyHistogram::LatencyHistogram()
+    : m_min(~quint64(0))
+{
+}
+
+void LatencyHistogram::record(quint64 value) {
+    m_counts[bucketFor(value)].fetchAndAddRelaxed(1);
+    m_sum.fetchAndAddRelaxed(value);
+    
+    quint64 current = m_min.loadRelaxed();
+    while (value < current && !m_min.testAndSetRelaxed(current, value, current)) {}
+    current = m_max.loadRelaxed();
+    while (value > current && !m_max.testAndSetRelaxed(current, value, current)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.counts.resize(BucketCount);
+    for (int i = 0; i < BucketCount; ++i) {
+        snapshot.counts[i] = m_counts[i].loadRelaxed();
+        snapshot.count += snapshot.counts.at(i);
+    }
+    if (snapshot.count > 0) {
+        snapshot.sum = m_sum.loadRelaxed();
+        snapshot.min = m_min.loadRelaxed();
+        snapshot.max = m_max.loadRelaxed();
+    }
+    return snapshot;
+}
+
+int LatencyHistogram::bucketFor(quint64 value) {
+    value = qMin(value, MaxValue);
+    if (value < quint64(kLinearBuckets)) return int(value);
+    
+    // The top kSubBucketBits + 1 bits select the bucket within the value's power of two
+    const int magnitude = 63 - qCountLeadingZeroBits(value);
+    const int shift = magnitude - kSubBucketBits;
+    return kLinearBuckets + (magnitude - kSubBucketBits - 1) * kSubBuckets + int(value >> shift) - kSubBuckets;
+}
+
+quint64 LatencyHistogram::bucketLowerBound(int bucket) {
+    if (bucket < kLinearBuckets) return quint64(bucket);
+    const int offset = bucket - kLinearBuckets;
+    const int shift = offset / kSubBuckets + 1;
+    return quint64(offset % kSubBuckets + kSubBuckets) << shift;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int bucket) {
+    if (bucket < kLinearBuckets) return quint64(bucket);
+    const int shift = (bucket - kLinearBuckets) / kSubBuckets + 1;
+    return bucketLowerBound(bucket) + (quint64(1) << shift) - 1;
+}
+
+quint64 LatencyHistogram::Snapshot::valueAtPercentile(double percentile) const {
+    if (count == 0) return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, percentile, 100.0) / 100.0 * count)));
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); ++i) {
+        seen += counts.at(i);
+        if (seen >= rank) return qMin(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+quint64 LatencyHistogram::Snapshot::countAtOrBelow(quint64 value) const {
+    quint64 total = 0;
+    for (int i = 0; i < counts.size() && bucketUpperBound(i) <= value; ++i) {
+        total += counts.at(i);
+    }
+    return total;
+}
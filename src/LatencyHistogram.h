@@ -0,0 +1,55 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QAtomicInteger>
+#include <QList>
+
+/**
+ * Fixed-size latency histogram in the style of HdrHistogram.
+ *
+ * Values (microseconds) below 64 get a bucket each; above that every power
+ * of two is split into 32 buckets, so a reported percentile is within about
+ * 3% of the true value from 1 us up to 2^36 us (19 hours, larger values are
+ * clamped). record() is a few relaxed atomic increments, so it can be called
+ * from any thread without locking; snapshot() reads the counters without
+ * stopping writers.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int BucketCount = 1024;
+    /** Values at or above this are counted in the last bucket. */
+    static constexpr quint64 MaxValue = (quint64(1) << 36) - 1;
+    
+    /** Point-in-time copy of the counters. */
+    struct Snapshot {
+        QList<quint64> counts;
+        quint64 count = 0;
+        quint64 sum = 0;
+        quint64 min = 0;
+        quint64 max = 0;
+        
+        /** Highest value of the bucket holding the given percentile (0-100), capped at max; 0 if empty. */
+        quint64 valueAtPercentile(double percentile) const;
+        double mean() const { return count ? double(sum) / count : 0.0; }
+        /** Values in buckets that end at or below value (the bucket straddling value is left out). */
+        quint64 countAtOrBelow(quint64 value) const;
+    };
+    
+    LatencyHistogram();
+    
+    void record(quint64 value);
+    Snapshot snapshot() const;
+    
+    static int bucketFor(quint64 value);
+    /** Smallest and largest value counted in a bucket. */
+    static quint64 bucketLowerBound(int bucket);
+    static quint64 bucketUpperBound(int bucket);
+    
+private:
+    QAtomicInteger<quint64> m_counts[BucketCount];
+    QAtomicInteger<quint64> m_sum;
+    QAtomicInteger<quint64> m_min;
+    QAtomicInteger<quint64> m_max;
+};
+
+#endif
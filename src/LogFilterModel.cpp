@@ -0,0 +1,24 @@
+#include "LogFilterModel.h"
+
+LogFilterModel::LogFilterModel(QObject* parent)
+    : QSortFilterProxyModel(parent)
+{
+}
+
+void LogFilterModel::setMinimumLevel(LogModel::Level level) {
+    if (level == m_minimumLevel) return;
+    
+    m_minimumLevel = level;
+    invalidateFilter();
+}
+
+LogModel::Level LogFilterModel::minimumLevel() const {
+    return m_minimumLevel;
+}
+
+bool LogFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const {
+    if (m_minimumLevel == LogModel::Level::Info) return true;
+    
+    const QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    return index.data(LogModel::LevelRole).toInt() >= static_cast<int>(m_minimumLevel);
+}
@@ -0,0 +1,27 @@
+#ifndef LOGFILTERMODEL_H
+#define LOGFILTERMODEL_H
+
+#include <QSortFilterProxyModel>
+#include "LogModel.h"
+
+/**
+ * Proxy over LogModel that hides entries below a minimum level.
+ */
+class LogFilterModel : public QSortFilterProxyModel {
+    Q_OBJECT
+    
+public:
+    explicit LogFilterModel(QObject* parent = nullptr);
+    
+    /** Shows only entries at or above level (Info shows everything). */
+    void setMinimumLevel(LogModel::Level level);
+    LogModel::Level minimumLevel() const;
+    
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+    
+private:
+    LogModel::Level m_minimumLevel = LogModel::Level::Info;
+};
+
+#endif
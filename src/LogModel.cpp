@@ -0,0 +1,224 @@
+#include "LogModel.h"
+#include <QBrush>
+#include <QColor>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <atomic>
+
+namespace {
+
+// Target of the Qt message handler installed by LogModel::installMessageHandler().
+// Threads that log hold the read lock for as long as they append to the target;
+// uninstalling takes the write lock, so the model cannot be destroyed under them.
+// Recursive, so a message logged while appending cannot deadlock against a waiting writer.
+QReadWriteLock s_handlerLock(QReadWriteLock::Recursive);
+LogModel* s_handlerTarget = nullptr;
+std::atomic<QtMessageHandler> s_previousHandler{nullptr};
+
+void routeQtMessage(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    {
+        QReadLocker lock(&s_handlerLock);
+        if (s_handlerTarget) {
+            LogModel::Level level = LogModel::Level::Info;
+            if (type == QtWarningMsg) level = LogModel::Level::Warning;
+            else if (type == QtCriticalMsg || type == QtFatalMsg) level = LogModel::Level::Error;
+            
+            const QString category = QString::fromLatin1(context.category ? context.category : "");
+            s_handlerTarget->append(level,
+                category.isEmpty() || category == "default" ? QStringLiteral("qt") : category,
+                message);
+        }
+    }
+    if (QtMessageHandler previous = s_previousHandler.load()) {
+        previous(type, context, message);
+    }
+}
+
+}
+
+LogModel::LogModel(int capacity, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_capacity(qMax(1, capacity))
+    , m_ring(static_cast<size_t>(m_capacity))
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushIntervalMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LogModel::flush);
+}
+
+LogModel::~LogModel() {
+    uninstallMessageHandler();
+    // Entries still queued never reach a view, but belong in the mirror file
+    QMutexLocker locker(&m_pendingMutex);
+    writeMirror(m_pending);
+}
+
+void LogModel::append(Level level, const QString& source, const QString& message) {
+    Entry entry{level, QDateTime::currentMSecsSinceEpoch(), source, message};
+    
+    QMutexLocker locker(&m_pendingMutex);
+    // A flood between two flushes can never show more than capacity entries anyway
+    if (m_pending.size() >= m_capacity) {
+        m_pending.removeFirst();
+    }
+    m_pending.append(std::move(entry));
+    
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        // Start the timer in the model's thread; append() may run on a worker
+        QMetaObject::invokeMethod(this, [this]() { m_flushTimer.start(); }, Qt::QueuedConnection);
+    }
+}
+
+int LogModel::capacity() const {
+    return m_capacity;
+}
+
+bool LogModel::setMirrorFile(const QString& path) {
+    flush();
+    if (m_mirror.isOpen()) {
+        m_mirror.close();
+    }
+    m_mirror.setFileName(path);
+    if (path.isEmpty()) return true;
+    
+    if (!m_mirror.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        m_mirror.setFileName(QString());
+        return false;
+    }
+    return true;
+}
+
+QString LogModel::mirrorFile() const {
+    return m_mirror.isOpen() ? m_mirror.fileName() : QString();
+}
+
+void LogModel::installMessageHandler() {
+    QWriteLocker lock(&s_handlerLock);
+    if (s_handlerTarget == this) return;
+    
+    QtMessageHandler previous = qInstallMessageHandler(routeQtMessage);
+    // Keep the original handler when re-targeting from another model
+    if (previous != routeQtMessage) {
+        s_previousHandler.store(previous);
+    }
+    s_handlerTarget = this;
+}
+
+void LogModel::uninstallMessageHandler() {
+    // Waits until no thread is appending to this model any more
+    QWriteLocker lock(&s_handlerLock);
+    if (s_handlerTarget != this) return;
+    
+    s_handlerTarget = nullptr;
+    qInstallMessageHandler(s_previousHandler.exchange(nullptr));
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return m_count;
+}
+
+QVariant LogModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_count) return QVariant();
+    
+    const Entry& entry = entryAt(index.row());
+    switch (role) {
+        case Qt::DisplayRole:
+            return formatLine(entry, false);
+        case Qt::ToolTipRole:
+            return tr("%1 [%2]")
+                .arg(QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString("yyyy-MM-dd hh:mm:ss.zzz"), entry.source);
+        case Qt::ForegroundRole:
+            if (entry.level == Level::Warning) return QBrush(QColor(255, 165, 0));
+            if (entry.level == Level::Error) return QBrush(Qt::red);
+            return QVariant();
+        case LevelRole:
+            return static_cast<int>(entry.level);
+        case SourceRole:
+            return entry.source;
+        case TimestampRole:
+            return entry.timestamp;
+    }
+    return QVariant();
+}
+
+QString LogModel::levelName(Level level) {
+    switch (level) {
+        case Level::Warning: return QStringLiteral("WARNING");
+        case Level::Error: return QStringLiteral("ERROR");
+        case Level::Info: break;
+    }
+    return QString();
+}
+
+void LogModel::flush() {
+    QList<Entry> batch;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        batch.swap(m_pending);
+        m_flushScheduled = false;
+    }
+    if (batch.isEmpty()) return;
+    
+    writeMirror(batch);
+    
+    const int count = static_cast<int>(batch.size());
+    if (count >= m_capacity) {
+        // The batch alone fills the buffer: keep its newest entries
+        beginResetModel();
+        for (int i = 0; i < m_capacity; ++i) {
+            m_ring[static_cast<size_t>(i)] = std::move(batch[count - m_capacity + i]);
+        }
+        m_first = 0;
+        m_count = m_capacity;
+        endResetModel();
+        return;
+    }
+    
+    const int overflow = m_count + count - m_capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        m_first = (m_first + overflow) % m_capacity;
+        m_count -= overflow;
+        endRemoveRows();
+    }
+    
+    beginInsertRows(QModelIndex(), m_count, m_count + count - 1);
+    for (Entry& entry : batch) {
+        m_ring[static_cast<size_t>((m_first + m_count) % m_capacity)] = std::move(entry);
+        ++m_count;
+    }
+    endInsertRows();
+}
+
+void LogModel::writeMirror(const QList<Entry>& entries) {
+    if (!m_mirror.isOpen() || entries.isEmpty()) return;
+    
+    // One write per flush rather than one per line
+    QByteArray lines;
+    for (const Entry& entry : entries) {
+        lines += formatLine(entry, true).toUtf8();
+        lines += '\n';
+    }
+    m_mirror.write(lines);
+    m_mirror.flush();
+}
+
+const LogModel::Entry& LogModel::entryAt(int row) const {
+    return m_ring[static_cast<size_t>((m_first + row) % m_capacity)];
+}
+
+QString LogModel::formatLine(const Entry& entry, bool withDate) {
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(entry.timestamp);
+    QString line = QString("[%1] ").arg(time.toString(withDate ? "yyyy-MM-dd hh:mm:ss.zzz" : "hh:mm:ss"));
+    if (withDate) {
+        line += QString("[%1] ").arg(entry.source);
+    }
+    const QString level = levelName(entry.level);
+    if (!level.isEmpty()) {
+        line += level + QStringLiteral(": ");
+    }
+    return line + entry.message;
+}
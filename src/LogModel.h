@@ -0,0 +1,96 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QFile>
+#include <QMutex>
+#include <QTimer>
+#include <vector>
+
+/**
+ * Bounded, structured status log.
+ *
+ * Entries live in a fixed-capacity ring buffer; once it is full the oldest
+ * entries are dropped. append() is thread-safe and only queues the entry:
+ * queued entries are inserted (and mirrored to a file, if enabled) by a
+ * single flush at most once per frame, so bursts of log lines cost one model
+ * update and one repaint. Text is formatted lazily in data(), i.e. only for
+ * rows a view actually shows.
+ */
+class LogModel : public QAbstractListModel {
+    Q_OBJECT
+    
+public:
+    enum class Level {
+        Info,
+        Warning,
+        Error
+    };
+    
+    enum Role {
+        LevelRole = Qt::UserRole + 1,
+        SourceRole,
+        TimestampRole
+    };
+    
+    struct Entry {
+        Level level;
+        /** Milliseconds since epoch. */
+        qint64 timestamp;
+        QString source;
+        QString message;
+    };
+    
+    static constexpr int DefaultCapacity = 10000;
+    /** Queued entries are flushed after at most this delay (one frame at 60 Hz). */
+    static constexpr int FlushIntervalMs = 16;
+    
+    explicit LogModel(int capacity = DefaultCapacity, QObject* parent = nullptr);
+    ~LogModel();
+    
+    /** Queues an entry; safe to call from any thread. */
+    void append(Level level, const QString& source, const QString& message);
+    /** Maximum number of entries kept. */
+    int capacity() const;
+    
+    /** Appends every entry to a text file as well; an empty path stops mirroring. Returns false if the file cannot be opened. */
+    bool setMirrorFile(const QString& path);
+    QString mirrorFile() const;
+    
+    /** Routes qDebug()/qWarning()/qCritical() output into this log (and still to the previous handler). */
+    void installMessageHandler();
+    /** Restores the previous handler if this log is the target; waits for messages being appended meanwhile. Called by the destructor. */
+    void uninstallMessageHandler();
+    
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    
+    /** Upper-case label of a level as shown in the log ("WARNING"), empty for Info. */
+    static QString levelName(Level level);
+    
+private slots:
+    /** Moves queued entries into the ring buffer and the mirror file. */
+    void flush();
+    
+private:
+    /** Appends entries to the mirror file, if one is open. */
+    void writeMirror(const QList<Entry>& entries);
+    /** Entry at a model row (0 = oldest kept). */
+    const Entry& entryAt(int row) const;
+    /** Formats an entry as a single log line (without trailing newline). */
+    static QString formatLine(const Entry& entry, bool withDate);
+    
+    int m_capacity;
+    std::vector<Entry> m_ring;
+    int m_first = 0;
+    int m_count = 0;
+    
+    QMutex m_pendingMutex;
+    QList<Entry> m_pending;
+    bool m_flushScheduled = false;
+    QTimer m_flushTimer;
+    
+    QFile m_mirror;
+};
+
+#endif
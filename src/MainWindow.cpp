@@ -10,21 +10,51 @@
 #include <QHeaderView>
 #include <QApplication>
 #include <QStyle>
-#include <QTime>
+#include <QScrollBar>
+#include <QElapsedTimer>
+#include <QDragEnterEvent>
+#include <QDropEvent>
+#include <QMimeData>
+#include <QDesktopServices>
+#include <QUrl>
+#include <QtConcurrent>
+#include <algorithm>
+#include "Metrics.h"
+#include "MimeWriter.h"
+#include "PdfExporter.h"
+#include "AnalyticsDialog.h"
+#include "DuplicatesDialog.h"
+#include "FindBar.h"
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , m_fileModel(new MsgFileModel(this))
-    , m_attachmentModel(new AttachmentModel(this))
+    , m_logModel(new LogModel(LogModel::DefaultCapacity, this))
+    , m_logFilter(new LogFilterModel(this))
 {
     setupUi();
     setupMenus();
+    // Parser and Python bridge diagnostics (qWarning etc.) show up in the status log
+    m_logModel->installMessageHandler();
+    setAcceptDrops(true);
     
     resize(1000, 700);
     setWindowTitle(tr("Qt MSG Reader"));
 }
 
-MainWindow::~MainWindow() = default;
+MainWindow::~MainWindow() {
+    // Dialog workers may still log while children are destroyed; stop routing to the model first
+    m_logModel->uninstallMessageHandler();
+    // Parsing workers must not outlive the window (and the Python interpreter)
+    for (QFutureWatcher<MessageView::LoadedMessage>* watcher : m_openWatchers) {
+        watcher->cancel();
+        watcher->waitForFinished();
+    }
+    // Attachment writers use m_attachmentFiles, and may be re-parsing an evicted message
+    for (QFutureWatcher<OpenFileCache::Result>* watcher : m_attachmentWriters) {
+        watcher->waitForFinished();
+    }
+}
 
 void MainWindow::setupMenus() {
     // Create File menu
@@ -34,12 +64,59 @@ void MainWindow::setupMenus() {
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, this, &MainWindow::onOpenFile);
     
+    m_exportEmlAction = fileMenu->addAction(tr("Export as &EML..."));
+    m_exportEmlAction->setEnabled(false);
+    connect(m_exportEmlAction, &QAction::triggered, this, &MainWindow::onExportEml);
+    
+    m_exportPdfAction = fileMenu->addAction(tr("Export as &PDF..."));
+    m_exportPdfAction->setEnabled(false);
+    connect(m_exportPdfAction, &QAction::triggered, this, &MainWindow::onExportPdf);
+    
+    m_closeTabAction = fileMenu->addAction(tr("&Close Tab"));
+    m_closeTabAction->setShortcut(QKeySequence::Close);
+    m_closeTabAction->setEnabled(false);
+    connect(m_closeTabAction, &QAction::triggered, this, [this]() {
+        if (m_messageTabs->currentIndex() >= 0) {
+            onMessageTabCloseRequested(m_messageTabs->currentIndex());
+        }
+    });
+    
     fileMenu->addSeparator();
     
     QAction* exitAction = fileMenu->addAction(tr("E&xit"));
     exitAction->setShortcut(QKeySequence::Quit);
     connect(exitAction, &QAction::triggered, qApp, &QApplication::quit);
     
+    // Create Edit menu; find acts on the body of the current tab
+    QMenu* editMenu = menuBar()->addMenu(tr("&Edit"));
+    m_findAction = editMenu->addAction(tr("&Find..."));
+    m_findAction->setShortcut(QKeySequence::Find);
+    m_findAction->setEnabled(false);
+    connect(m_findAction, &QAction::triggered, this, [this]() {
+        if (MessageView* view = currentMessageView()) view->findBar()->activate();
+    });
+    
+    m_findNextAction = editMenu->addAction(tr("Find &Next"));
+    m_findNextAction->setShortcut(QKeySequence::FindNext);
+    m_findNextAction->setEnabled(false);
+    connect(m_findNextAction, &QAction::triggered, this, [this]() {
+        if (MessageView* view = currentMessageView()) view->findBar()->findNext();
+    });
+    
+    m_findPreviousAction = editMenu->addAction(tr("Find &Previous"));
+    m_findPreviousAction->setShortcut(QKeySequence::FindPrevious);
+    m_findPreviousAction->setEnabled(false);
+    connect(m_findPreviousAction, &QAction::triggered, this, [this]() {
+        if (MessageView* view = currentMessageView()) view->findBar()->findPrevious();
+    });
+    
+    // Create Tools menu
+    QMenu* toolsMenu = menuBar()->addMenu(tr("&Tools"));
+    QAction* duplicatesAction = toolsMenu->addAction(tr("Find &Duplicates..."));
+    connect(duplicatesAction, &QAction::triggered, this, &MainWindow::onFindDuplicates);
+    QAction* analyticsAction = toolsMenu->addAction(tr("Folder &Analytics..."));
+    connect(analyticsAction, &QAction::triggered, this, &MainWindow::onFolderAnalytics);
+    
     // Create Help menu
     QMenu* helpMenu = menuBar()->addMenu(tr("&Help"));
     QAction* aboutAction = helpMenu->addAction(tr("&About"));
@@ -54,8 +131,12 @@ void MainWindow::setupUi() {
     m_mainSplitter = new QSplitter(Qt::Horizontal, this);
     setCentralWidget(m_mainSplitter);
     
+    // Browser panel: file tree and conversation threads
+    m_browserTabs = new QTabWidget(m_mainSplitter);
+    m_browserTabs->setMinimumWidth(200);
+    
     // File browser panel
-    m_fileBrowser = new QTreeView(m_mainSplitter);
+    m_fileBrowser = new QTreeView;
     m_fileBrowser->setModel(m_fileModel);
     QModelIndex rootIndex = m_fileModel->setRootPath(QDir::homePath());
     m_fileBrowser->setRootIndex(rootIndex);
@@ -64,104 +145,87 @@ void MainWindow::setupUi() {
     m_fileBrowser->setSortingEnabled(true);
     m_fileBrowser->sortByColumn(0, Qt::AscendingOrder);
     m_fileBrowser->setAlternatingRowColors(true);
+    m_fileBrowser->setSelectionMode(QAbstractItemView::ExtendedSelection);
     connect(m_fileBrowser, &QTreeView::doubleClicked, this, &MainWindow::onFileDoubleClicked);
+    QAction* openSelectedAction = new QAction(tr("Open Selected"), m_fileBrowser);
+    openSelectedAction->setShortcut(Qt::Key_Return);
+    openSelectedAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(openSelectedAction, &QAction::triggered, this, &MainWindow::onOpenSelectedFiles);
+    m_fileBrowser->addAction(openSelectedAction);
+    m_fileBrowser->setContextMenuPolicy(Qt::ActionsContextMenu);
+    m_browserTabs->addTab(m_fileBrowser, tr("Files"));
+    
+    // Conversation view, filled by scanning a folder
+    m_conversationView = new ConversationView;
+    connect(m_conversationView, &ConversationView::fileActivated, this, &MainWindow::loadFile);
+    m_browserTabs->addTab(m_conversationView, tr("Conversations"));
     
     // Vertical splitter for message content
     m_contentSplitter = new QSplitter(Qt::Vertical, m_mainSplitter);
     
-    // Message panel with header and body
-    m_messagePanel = new QWidget(m_contentSplitter);
-    QVBoxLayout* messageLayout = new QVBoxLayout(m_messagePanel);
-    messageLayout->setContentsMargins(8, 8, 8, 8);
-    
-    // Header section with labels
-    QGroupBox* headerGroup = new QGroupBox(tr("Message Header"), m_messagePanel);
-    QGridLayout* headerLayout = new QGridLayout(headerGroup);
-    
-    int row = 0;
-    headerLayout->addWidget(new QLabel(tr("<b>Subject:</b>")), row, 0);
-    m_subjectLabel = new QLabel;
-    m_subjectLabel->setWordWrap(true);
-    m_subjectLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
-    headerLayout->addWidget(m_subjectLabel, row, 1);
-    
-    ++row;
-    headerLayout->addWidget(new QLabel(tr("<b>From:</b>")), row, 0);
-    m_fromLabel = new QLabel;
-    m_fromLabel->setWordWrap(true);
-    m_fromLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
-    headerLayout->addWidget(m_fromLabel, row, 1);
-    
-    ++row;
-    headerLayout->addWidget(new QLabel(tr("<b>To:</b>")), row, 0);
-    m_toLabel = new QLabel;
-    m_toLabel->setWordWrap(true);
-    m_toLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
-    headerLayout->addWidget(m_toLabel, row, 1);
-    
-    ++row;
-    headerLayout->addWidget(new QLabel(tr("<b>Cc:</b>")), row, 0);
-    m_ccLabel = new QLabel;
-    m_ccLabel->setWordWrap(true);
-    m_ccLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
-    headerLayout->addWidget(m_ccLabel, row, 1);
-    
-    ++row;
-    headerLayout->addWidget(new QLabel(tr("<b>Date:</b>")), row, 0);
-    m_dateLabel = new QLabel;
-    m_dateLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
-    headerLayout->addWidget(m_dateLabel, row, 1);
-    
-    headerLayout->setColumnStretch(1, 1);
-    messageLayout->addWidget(headerGroup);
-    
-    // Body section
-    QGroupBox* bodyGroup = new QGroupBox(tr("Message Body"), m_messagePanel);
-    QVBoxLayout* bodyLayout = new QVBoxLayout(bodyGroup);
-    
-    m_bodyView = new QTextEdit;
-    m_bodyView->setReadOnly(true);
-    bodyLayout->addWidget(m_bodyView);
-    
-    messageLayout->addWidget(bodyGroup, 1);
-    
-    m_contentSplitter->addWidget(m_messagePanel);
-    
-    // Attachments section
-    QGroupBox* attachmentGroup = new QGroupBox(tr("Attachments"), m_contentSplitter);
-    QVBoxLayout* attachmentLayout = new QVBoxLayout(attachmentGroup);
-    
-    m_attachmentView = new QTableView;
-    m_attachmentView->setModel(m_attachmentModel);
-    m_attachmentView->setSelectionBehavior(QAbstractItemView::SelectRows);
-    m_attachmentView->setSelectionMode(QAbstractItemView::SingleSelection);
-    m_attachmentView->horizontalHeader()->setStretchLastSection(true);
-    m_attachmentView->verticalHeader()->setVisible(false);
-    m_attachmentView->setAlternatingRowColors(true);
-    connect(m_attachmentView, &QTableView::doubleClicked, this, &MainWindow::onAttachmentDoubleClicked);
-    
-    attachmentLayout->addWidget(m_attachmentView);
-    
-    m_contentSplitter->addWidget(attachmentGroup);
+    // Message tabs, one MessageView per open file
+    m_messageTabs = new QTabWidget(m_contentSplitter);
+    m_messageTabs->setTabsClosable(true);
+    m_messageTabs->setMovable(true);
+    m_messageTabs->setDocumentMode(true);
+    connect(m_messageTabs, &QTabWidget::currentChanged, this, &MainWindow::onMessageTabChanged);
+    connect(m_messageTabs, &QTabWidget::tabCloseRequested, this, &MainWindow::onMessageTabCloseRequested);
+    m_contentSplitter->addWidget(m_messageTabs);
     
     // Status log section
     QGroupBox* statusGroup = new QGroupBox(tr("Status Log"), m_contentSplitter);
     QVBoxLayout* statusLayout = new QVBoxLayout(statusGroup);
     
-    m_statusLog = new QTextEdit;
-    m_statusLog->setReadOnly(true);
-    m_statusLog->setFont(QFont("monospace"));
-    m_statusLog->setMaximumHeight(120);
-    statusLayout->addWidget(m_statusLog);
+    QHBoxLayout* statusToolbar = new QHBoxLayout;
+    m_logLevelFilter = new QComboBox;
+    m_logLevelFilter->addItem(tr("All messages"), static_cast<int>(LogModel::Level::Info));
+    m_logLevelFilter->addItem(tr("Warnings and errors"), static_cast<int>(LogModel::Level::Warning));
+    m_logLevelFilter->addItem(tr("Errors only"), static_cast<int>(LogModel::Level::Error));
+    connect(m_logLevelFilter, &QComboBox::currentIndexChanged, this, [this](int index) {
+        m_logFilter->setMinimumLevel(static_cast<LogModel::Level>(m_logLevelFilter->itemData(index).toInt()));
+    });
+    statusToolbar->addWidget(m_logLevelFilter);
+    m_logMirrorCheck = new QCheckBox(tr("Mirror to file"));
+    connect(m_logMirrorCheck, &QCheckBox::toggled, this, &MainWindow::onMirrorLogToggled);
+    statusToolbar->addWidget(m_logMirrorCheck);
+    statusToolbar->addStretch(1);
+    statusLayout->addLayout(statusToolbar);
+    
+    // Only visible rows are formatted and painted, so the view stays cheap at full capacity
+    m_logFilter->setSourceModel(m_logModel);
+    m_logView = new QListView;
+    m_logView->setModel(m_logFilter);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_logView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_logView->setFont(QFont("monospace"));
+    m_logView->setMaximumHeight(120);
+    statusLayout->addWidget(m_logView);
+    
+    // Keep following new entries unless the user scrolled up
+    connect(m_logFilter, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() {
+        const QScrollBar* bar = m_logView->verticalScrollBar();
+        m_logFollowTail = bar->value() == bar->maximum();
+    });
+    connect(m_logFilter, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (m_logFollowTail) m_logView->scrollToBottom();
+    });
     
     m_contentSplitter->addWidget(statusGroup);
     
-    m_contentSplitter->setSizes({400, 100, 100});
+    m_contentSplitter->setSizes({500, 100});
     m_mainSplitter->setSizes({250, 750});
 }
 
 void MainWindow::loadFile(const QString& filePath) {
+    if (MessageView* view = findMessageTab(filePath)) {
+        m_messageTabs->setCurrentWidget(view);
+        return;
+    }
+    
     log(tr("Loading file: %1").arg(filePath));
+    QElapsedTimer timer;
+    timer.start();
     
     MsgParser parser;
     EmailMessage msg = parser.parse(filePath);
@@ -173,67 +237,138 @@ void MainWindow::loadFile(const QString& filePath) {
         return;
     }
     
-    m_currentFile = filePath;
-    m_currentMessage = msg;
-    updateMessageView(msg);
-    
-    setWindowTitle(tr("Qt MSG Reader - %1").arg(QFileInfo(filePath).fileName()));
+    addMessageTab(filePath, msg, true);
+    Metrics::record(Metrics::Open, timer.nsecsElapsed());
     log(tr("File loaded successfully"));
 }
 
-void MainWindow::updateMessageView(const EmailMessage& msg) {
-    // Update subject
-    m_subjectLabel->setText(msg.subject.isEmpty() ? tr("(no subject)") : msg.subject);
-    log(tr("Subject: %1").arg(msg.subject.isEmpty() ? tr("(no subject)") : msg.subject));
-    
-    // Format sender display
-    QString fromText;
-    if (!msg.senderName.isEmpty() && !msg.senderEmail.isEmpty()) {
-        fromText = QString("%1 <%2>").arg(msg.senderName, msg.senderEmail);
-    } else if (!msg.senderName.isEmpty()) {
-        fromText = msg.senderName;
-    } else if (!msg.senderEmail.isEmpty()) {
-        fromText = msg.senderEmail;
-    } else {
-        fromText = tr("(unknown sender)");
+void MainWindow::openFiles(const QStringList& filePaths) {
+    QStringList toParse;
+    for (const QString& filePath : filePaths) {
+        if (!findMessageTab(filePath) && !toParse.contains(filePath)) {
+            toParse.append(filePath);
+        }
     }
-    m_fromLabel->setText(fromText);
     
-    // Update recipients
-    m_toLabel->setText(msg.toRecipients.isEmpty() ? tr("(no recipients)") : msg.toRecipients);
-    m_ccLabel->setText(msg.ccRecipients.isEmpty() ? tr("-") : msg.ccRecipients);
+    if (toParse.size() <= 1) {
+        // A single file keeps the synchronous path with its error dialog
+        const QString filePath = toParse.isEmpty() ? filePaths.value(0) : toParse.first();
+        if (!filePath.isEmpty()) loadFile(filePath);
+        return;
+    }
     
-    // Update date
-    if (msg.date.isValid()) {
-        m_dateLabel->setText(msg.date.toLocalTime().toString(Qt::ISODate));
-    } else {
-        m_dateLabel->setText(tr("(unknown date)"));
+    log(tr("Opening %1 files").arg(toParse.size()));
+    QElapsedTimer timer;
+    timer.start();
+    
+    // Parse on the global thread pool; tabs are added in the background as results arrive
+    QFutureWatcher<MessageView::LoadedMessage>* watcher = new QFutureWatcher<MessageView::LoadedMessage>(this);
+    m_openWatchers.append(watcher);
+    connect(watcher, &QFutureWatcher<MessageView::LoadedMessage>::resultsReadyAt, this,
+            [this, watcher, timer](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const MessageView::LoadedMessage loaded = watcher->resultAt(i);
+            if (!loaded.message.isValid) {
+                logError(tr("Failed to parse file: %1 (%2)").arg(loaded.filePath, loaded.message.errorMessage));
+            } else if (!findMessageTab(loaded.filePath)) {
+                addMessageTab(loaded.filePath, loaded.message, false);
+                // Measured from the request, so waiting behind the other files of the batch counts
+                Metrics::record(Metrics::Open, timer.nsecsElapsed());
+            }
+        }
+    });
+    connect(watcher, &QFutureWatcher<MessageView::LoadedMessage>::finished, this,
+            [this, watcher, toParse, timer]() {
+        m_openWatchers.removeOne(watcher);
+        watcher->deleteLater();
+        if (MessageView* first = findMessageTab(toParse.first())) {
+            m_messageTabs->setCurrentWidget(first);
+        }
+        log(tr("Opened %1 files in %2 ms").arg(toParse.size()).arg(timer.elapsed()));
+    });
+    watcher->setFuture(QtConcurrent::mapped(toParse, &MessageView::load));
+}
+
+void MainWindow::setTabMemoryBudget(qint64 bytes) {
+    m_tabMemoryBudget = qMax<qint64>(0, bytes);
+    enforceMemoryBudget();
+}
+
+MessageView* MainWindow::addMessageTab(const QString& filePath, const EmailMessage& msg, bool makeCurrent) {
+    MessageView* view = new MessageView;
+    view->setMessage(filePath, msg);
+    connect(view, &MessageView::attachmentActivated, this, &MainWindow::onAttachmentActivated);
+    connect(view, &MessageView::attachmentOpenRequested, this, &MainWindow::onOpenAttachment);
+    connect(view, &MessageView::archiveEntryActivated, this, &MainWindow::onArchiveEntryActivated);
+    
+    const int index = m_messageTabs->addTab(view,
+        fontMetrics().elidedText(view->title(), Qt::ElideRight, 200));
+    m_messageTabs->setTabToolTip(index, filePath);
+    logMessageSummary(msg);
+    
+    if (makeCurrent) {
+        m_messageTabs->setCurrentIndex(index);
+    }
+    enforceMemoryBudget();
+    return view;
+}
+
+MessageView* MainWindow::findMessageTab(const QString& filePath) const {
+    for (int i = 0; i < m_messageTabs->count(); ++i) {
+        MessageView* view = qobject_cast<MessageView*>(m_messageTabs->widget(i));
+        if (view && view->filePath() == filePath) return view;
+    }
+    return nullptr;
+}
+
+MessageView* MainWindow::currentMessageView() const {
+    return qobject_cast<MessageView*>(m_messageTabs->currentWidget());
+}
+
+void MainWindow::enforceMemoryBudget() {
+    if (m_tabMemoryBudget <= 0) return;
+    
+    QList<MessageView*> views;
+    qint64 total = 0;
+    for (int i = 0; i < m_messageTabs->count(); ++i) {
+        if (MessageView* view = qobject_cast<MessageView*>(m_messageTabs->widget(i))) {
+            total += view->memoryCost();
+            views.append(view);
+        }
     }
+    if (total <= m_tabMemoryBudget) return;
     
-    // Update body - prefer HTML over plain text
-    QString bodyText = msg.bodyHtml.isEmpty() ? msg.bodyPlainText : msg.bodyHtml;
-    bodyText.remove('\0');
+    // Least recently used first; the selected tab is never evicted
+    std::sort(views.begin(), views.end(), [](const MessageView* a, const MessageView* b) {
+        return a->lastActivated() < b->lastActivated();
+    });
+    const MessageView* current = currentMessageView();
+    for (MessageView* view : views) {
+        if (total <= m_tabMemoryBudget) break;
+        if (view == current || view->isEvicted()) continue;
+        
+        const qint64 before = view->memoryCost();
+        view->evict();
+        total -= before - view->memoryCost();
+        log(tr("Evicted background tab: %1 (%2 KiB freed)")
+            .arg(view->title()).arg((before - view->memoryCost()) / 1024));
+    }
+}
+
+void MainWindow::logMessageSummary(const EmailMessage& msg) {
+    log(tr("Subject: %1").arg(msg.subject.isEmpty() ? tr("(no subject)") : msg.subject));
     
     if (!msg.bodyHtml.isEmpty()) {
-        m_bodyView->setHtml(bodyText);
         log(tr("Body: HTML (%1 chars)").arg(msg.bodyHtml.length()));
     } else if (!msg.bodyPlainText.isEmpty()) {
-        m_bodyView->setPlainText(bodyText);
         log(tr("Body: Plain text (%1 chars)").arg(msg.bodyPlainText.length()));
     } else {
-        m_bodyView->setPlainText(tr("(no message body)"));
         logWarning(tr("No message body found"));
     }
     
-    // Update attachments
-    m_attachmentModel->setAttachments(msg.attachments);
-    
     if (msg.attachments.isEmpty()) {
-        m_attachmentView->hide();
         log(tr("Attachments: None"));
     } else {
-        m_attachmentView->show();
-        m_attachmentView->resizeColumnsToContents();
         log(tr("Attachments: %1 found").arg(msg.attachments.size()));
         for (const auto& att : msg.attachments) {
             log(tr("  - %1 (%2 bytes)").arg(att.filename).arg(att.size));
@@ -242,36 +377,130 @@ void MainWindow::updateMessageView(const EmailMessage& msg) {
 }
 
 void MainWindow::onOpenFile() {
-    QString filePath = QFileDialog::getOpenFileName(this,
-        tr("Open MSG File"),
+    QStringList filePaths = QFileDialog::getOpenFileNames(this,
+        tr("Open MSG Files"),
         QDir::homePath(),
         tr("MSG Files (*.msg *.MSG);;All Files (*)"));
     
-    if (!filePath.isEmpty()) {
-        loadFile(filePath);
+    if (!filePaths.isEmpty()) {
+        openFiles(filePaths);
     }
 }
 
 void MainWindow::onSaveAttachment() {
-    QModelIndex index = m_attachmentView->currentIndex();
-    if (!index.isValid()) return;
+    MessageView* view = currentMessageView();
+    if (!view || view->currentAttachment() < 0) return;
     
-    const EmailAttachment& att = m_attachmentModel->attachment(index.row());
+    saveAttachment(view->currentAttachment());
+}
+
+void MainWindow::onExportEml() {
+    MessageView* view = currentMessageView();
+    if (!view) return;
     
+    const QString currentFile = view->filePath();
+    QString defaultPath = QFileInfo(currentFile).absolutePath() + "/"
+        + QFileInfo(currentFile).completeBaseName() + ".eml";
     QString savePath = QFileDialog::getSaveFileName(this,
-        tr("Save Attachment"),
-        QDir::homePath() + "/" + att.filename);
+        tr("Export as EML"),
+        defaultPath,
+        tr("EML Files (*.eml);;All Files (*)"));
     
-    if (!savePath.isEmpty()) {
+    if (savePath.isEmpty()) return;
+    
+    // Attachment payloads of a once-evicted tab are re-read for the export
+    withLoadedMessage(view, [this, view, savePath]() {
         QFile file(savePath);
-        if (file.open(QIODevice::WriteOnly)) {
-            file.write(att.data);
-            file.close();
-        } else {
+        if (!file.open(QIODevice::WriteOnly)) {
+            logError(tr("Failed to export message: %1").arg(savePath));
             QMessageBox::warning(this, tr("Error"),
-                tr("Failed to save attachment: %1").arg(savePath));
+                tr("Failed to export message: %1").arg(savePath));
+            return;
         }
-    }
+        
+        QElapsedTimer timer;
+        timer.start();
+        MimeWriter writer(&file);
+        bool ok = writer.write(view->message());
+        file.close();
+        
+        if (!ok) {
+            logError(tr("Failed to export message: %1 (%2)").arg(savePath, writer.errorString()));
+            QMessageBox::warning(this, tr("Error"),
+                tr("Failed to export message: %1\n\n%2").arg(savePath, writer.errorString()));
+            return;
+        }
+        
+        Metrics::record(Metrics::Save, timer.nsecsElapsed(), writer.bytesWritten());
+        log(tr("Exported message: %1 (%2 bytes in %3 ms)")
+            .arg(savePath).arg(writer.bytesWritten()).arg(timer.elapsed()));
+    });
+}
+
+void MainWindow::onExportPdf() {
+    MessageView* view = currentMessageView();
+    if (!view) return;
+    
+    const QString currentFile = view->filePath();
+    QString defaultPath = QFileInfo(currentFile).absolutePath() + "/"
+        + QFileInfo(currentFile).completeBaseName() + ".pdf";
+    QString savePath = QFileDialog::getSaveFileName(this,
+        tr("Export as PDF"),
+        defaultPath,
+        tr("PDF Files (*.pdf);;All Files (*)"));
+    
+    if (savePath.isEmpty()) return;
+    
+    // Inline images come from attachment payloads, which an evicted tab may have dropped
+    withLoadedMessage(view, [this, view, savePath]() {
+        QElapsedTimer timer;
+        timer.start();
+        int pageCount = 0;
+        QString errorString;
+        if (!PdfExporter::write(view->message(), savePath, &pageCount, &errorString)) {
+            logError(tr("Failed to export message: %1 (%2)").arg(savePath, errorString));
+            QMessageBox::warning(this, tr("Error"),
+                tr("Failed to export message: %1\n\n%2").arg(savePath, errorString));
+            return;
+        }
+        
+        log(tr("Exported message: %1 (%2 pages in %3 ms)")
+            .arg(savePath).arg(pageCount).arg(timer.elapsed()));
+    });
+}
+
+void MainWindow::onFindDuplicates() {
+    QString directory = QFileDialog::getExistingDirectory(this,
+        tr("Find Duplicates in Folder"),
+        currentMessageView() ? QFileInfo(currentMessageView()->filePath()).absolutePath() : QDir::homePath());
+    
+    if (directory.isEmpty()) return;
+    
+    log(tr("Scanning for duplicates: %1").arg(directory));
+    DuplicatesDialog* dialog = new DuplicatesDialog(directory, this);
+    connect(dialog, &DuplicatesDialog::fileActivated, this, &MainWindow::loadFile);
+    connect(dialog, &DuplicatesDialog::groupsFound, this, [this](const QList<DuplicateFinder::Group>& groups) {
+        m_fileModel->setDuplicateGroups(groups);
+        m_fileBrowser->viewport()->update();
+        log(tr("Duplicate scan finished: %1 groups").arg(groups.size()));
+    });
+    dialog->show();
+}
+
+void MainWindow::onFolderAnalytics() {
+    QString directory = QFileDialog::getExistingDirectory(this,
+        tr("Folder Analytics"),
+        currentMessageView() ? QFileInfo(currentMessageView()->filePath()).absolutePath() : QDir::homePath());
+    
+    if (directory.isEmpty()) return;
+    
+    log(tr("Computing analytics: %1").arg(directory));
+    AnalyticsDialog* dialog = new AnalyticsDialog(directory, this);
+    connect(dialog, &AnalyticsDialog::reportReady, this, [this](const FolderAnalytics::Report& report) {
+        log(tr("Analytics finished: %1 messages, %2 attachments in %3")
+            .arg(report.messages).arg(report.attachments).arg(report.directory));
+    });
+    dialog->show();
 }
 
 void MainWindow::onFileDoubleClicked(const QModelIndex& index) {
@@ -282,20 +511,111 @@ void MainWindow::onFileDoubleClicked(const QModelIndex& index) {
     }
 }
 
-void MainWindow::onAttachmentDoubleClicked(const QModelIndex& index) {
-    if (!index.isValid()) return;
+void MainWindow::onOpenSelectedFiles() {
+    QStringList filePaths;
+    const QModelIndexList rows = m_fileBrowser->selectionModel()->selectedRows(0);
+    for (const QModelIndex& index : rows) {
+        const QString filePath = m_fileModel->filePath(index);
+        if (filePath.endsWith(".msg", Qt::CaseInsensitive)) {
+            filePaths.append(filePath);
+        }
+    }
+    if (!filePaths.isEmpty()) {
+        openFiles(filePaths);
+    }
+}
+
+void MainWindow::onAttachmentActivated(int row) {
+    saveAttachment(row);
+}
+
+void MainWindow::onOpenAttachment(int row) {
+    MessageView* view = currentMessageView();
+    if (!view || row < 0 || row >= view->message().attachments.size()) return;
+    // Shares the payload; it stays alive even if the tab is closed or evicted meanwhile
+    const EmailAttachment att = view->message().attachments.at(row);
+    
+    // The name comes from the sender; don't run a program or script from it without asking
+    if (OpenFileCache::isExecutableType(att.filename)) {
+        const QMessageBox::StandardButton answer = QMessageBox::warning(this, tr("Open Attachment"),
+            tr("%1 is a program or script. Opening it may run code from this message on your computer.\n\n"
+               "Open it anyway?").arg(att.filename),
+            QMessageBox::Open | QMessageBox::Cancel, QMessageBox::Cancel);
+        if (answer != QMessageBox::Open) return;
+        logWarning(tr("Opening executable attachment: %1").arg(att.filename));
+    }
     
-    const EmailAttachment& att = m_attachmentModel->attachment(index.row());
+    // Opened before and the file is still there: no reload, no write
+    const QByteArray key = OpenFileCache::keyFor(view->filePath(), row, att.size);
+    const QString cachedPath = m_attachmentFiles.lookup(key);
+    if (!cachedPath.isEmpty()) {
+        log(tr("Opening attachment: %1 (cached)").arg(cachedPath));
+        if (!QDesktopServices::openUrl(QUrl::fromLocalFile(cachedPath))) {
+            logError(tr("No application to open: %1").arg(cachedPath));
+            QMessageBox::warning(this, tr("Error"),
+                tr("No application to open: %1").arg(cachedPath));
+        }
+        return;
+    }
+    
+    // Large payloads take a while to write; keep the UI responsive
+    QElapsedTimer timer;
+    timer.start();
+    QFutureWatcher<OpenFileCache::Result>* watcher = new QFutureWatcher<OpenFileCache::Result>(this);
+    m_attachmentWriters.append(watcher);
+    connect(watcher, &QFutureWatcher<OpenFileCache::Result>::finished, this, [this, watcher, timer]() {
+        m_attachmentWriters.removeOne(watcher);
+        watcher->deleteLater();
+        const OpenFileCache::Result result = watcher->result();
+        if (!result.ok) {
+            logError(tr("Failed to write temporary file: %1").arg(result.errorString));
+            QMessageBox::warning(this, tr("Error"),
+                tr("Failed to write temporary file: %1").arg(result.errorString));
+            return;
+        }
+        log(tr("Opening attachment: %1 (written in %2 ms)").arg(result.path).arg(timer.elapsed()));
+        if (!QDesktopServices::openUrl(QUrl::fromLocalFile(result.path))) {
+            logError(tr("No application to open: %1").arg(result.path));
+            QMessageBox::warning(this, tr("Error"),
+                tr("No application to open: %1").arg(result.path));
+        }
+    });
+    // An evicted tab has dropped the payload: the worker re-reads the file, and the tab stays compact
+    const QString sourcePath = view->filePath();
+    const qsizetype attachmentCount = view->message().attachments.size();
+    watcher->setFuture(QtConcurrent::run([this, key, att, sourcePath, row, attachmentCount]() {
+        if (!att.data.isEmpty() || att.size == 0) {
+            return m_attachmentFiles.store(key, att.filename, att.data);
+        }
+        const MessageView::LoadedMessage loaded = MessageView::load(sourcePath);
+        if (!loaded.message.isValid || loaded.message.attachments.size() != attachmentCount) {
+            return OpenFileCache::Result{QString(), false, QString("Cannot reload %1").arg(sourcePath)};
+        }
+        return m_attachmentFiles.store(key, att.filename, loaded.message.attachments.at(row).data);
+    }));
+}
+
+void MainWindow::saveAttachment(int row) {
+    MessageView* view = currentMessageView();
+    if (!view || row < 0 || row >= view->message().attachments.size()) return;
     
     QString savePath = QFileDialog::getSaveFileName(this,
         tr("Save Attachment"),
-        QDir::homePath() + "/" + att.filename);
+        QDir::homePath() + "/" + view->message().attachments.at(row).filename);
     
-    if (!savePath.isEmpty()) {
+    if (savePath.isEmpty()) return;
+    
+    // The tab may have been evicted since it was opened
+    withLoadedMessage(view, [this, view, row, savePath]() {
+        const EmailAttachment& att = view->message().attachments.at(row);
+        
+        QElapsedTimer timer;
+        timer.start();
         QFile file(savePath);
         if (file.open(QIODevice::WriteOnly)) {
             file.write(att.data);
             file.close();
+            Metrics::record(Metrics::Save, timer.nsecsElapsed(), att.data.size());
             log(tr("Saved attachment: %1").arg(savePath));
             QMessageBox::information(this, tr("Saved"),
                 tr("Attachment saved to: %1").arg(savePath));
@@ -304,20 +624,146 @@ void MainWindow::onAttachmentDoubleClicked(const QModelIndex& index) {
             QMessageBox::warning(this, tr("Error"),
                 tr("Failed to save attachment: %1").arg(savePath));
         }
+    });
+}
+
+void MainWindow::onArchiveEntryActivated(int attachmentRow, const ZipArchive::Entry& entry) {
+    MessageView* view = currentMessageView();
+    if (!view) return;
+    
+    QString savePath = QFileDialog::getSaveFileName(this,
+        tr("Extract File"),
+        QDir::homePath() + "/" + QFileInfo(entry.name).fileName());
+    
+    if (savePath.isEmpty()) return;
+    
+    withLoadedMessage(view, [this, view, attachmentRow, entry, savePath]() {
+        if (attachmentRow >= view->message().attachments.size()) return;
+        // Shares the payload; it stays alive even if the tab is closed or evicted meanwhile
+        const QByteArray archive = view->message().attachments.at(attachmentRow).data;
+        
+        // Only this member is decompressed, streamed straight into the file on a worker
+        QElapsedTimer timer;
+        timer.start();
+        QFutureWatcher<ZipArchive::ExtractResult>* watcher = new QFutureWatcher<ZipArchive::ExtractResult>(this);
+        connect(watcher, &QFutureWatcher<ZipArchive::ExtractResult>::finished, this, [this, watcher, entry, timer]() {
+            watcher->deleteLater();
+            const ZipArchive::ExtractResult result = watcher->result();
+            if (!result.ok) {
+                logError(tr("Failed to extract %1: %2").arg(entry.name, result.errorString));
+                QMessageBox::warning(this, tr("Error"),
+                    tr("Failed to extract %1:\n\n%2").arg(entry.name, result.errorString));
+                return;
+            }
+            Metrics::record(Metrics::Save, timer.nsecsElapsed(), entry.uncompressedSize);
+            log(tr("Extracted %1 to %2 (%3 bytes in %4 ms)")
+                .arg(entry.name, result.path).arg(entry.uncompressedSize).arg(timer.elapsed()));
+        });
+        watcher->setFuture(QtConcurrent::run(&ZipArchive::extractToFile, archive, entry, savePath));
+    });
+}
+
+void MainWindow::onMessageTabChanged(int index) {
+    Q_UNUSED(index);
+    MessageView* view = currentMessageView();
+    m_exportEmlAction->setEnabled(view != nullptr);
+    m_exportPdfAction->setEnabled(view != nullptr);
+    m_closeTabAction->setEnabled(view != nullptr);
+    m_findAction->setEnabled(view != nullptr);
+    m_findNextAction->setEnabled(view != nullptr);
+    m_findPreviousAction->setEnabled(view != nullptr);
+    if (!view) {
+        setWindowTitle(tr("Qt MSG Reader"));
+        return;
+    }
+    
+    if (view->isEvicted()) {
+        QElapsedTimer timer;
+        timer.start();
+        view->rehydrate();
+        log(tr("Restored tab: %1 (%2 ms)").arg(view->title()).arg(timer.elapsed()));
+    }
+    view->setLastActivated(++m_activationCounter);
+    setWindowTitle(tr("Qt MSG Reader - %1").arg(QFileInfo(view->filePath()).fileName()));
+    enforceMemoryBudget();
+}
+
+void MainWindow::onMessageTabCloseRequested(int index) {
+    QWidget* view = m_messageTabs->widget(index);
+    m_messageTabs->removeTab(index);
+    view->deleteLater();
+}
+
+void MainWindow::dragEnterEvent(QDragEnterEvent* event) {
+    for (const QUrl& url : event->mimeData()->urls()) {
+        if (url.isLocalFile() && url.toLocalFile().endsWith(".msg", Qt::CaseInsensitive)) {
+            event->acceptProposedAction();
+            return;
+        }
+    }
+}
+
+void MainWindow::dropEvent(QDropEvent* event) {
+    QStringList filePaths;
+    for (const QUrl& url : event->mimeData()->urls()) {
+        if (url.isLocalFile() && url.toLocalFile().endsWith(".msg", Qt::CaseInsensitive)) {
+            filePaths.append(url.toLocalFile());
+        }
     }
+    if (!filePaths.isEmpty()) {
+        event->acceptProposedAction();
+        openFiles(filePaths);
+    }
+}
+
+void MainWindow::onMirrorLogToggled(bool checked) {
+    if (!checked) {
+        const QString path = m_logModel->mirrorFile();
+        m_logModel->setMirrorFile(QString());
+        if (!path.isEmpty()) log(tr("Stopped mirroring log to %1").arg(path));
+        return;
+    }
+    
+    QString path = QFileDialog::getSaveFileName(this,
+        tr("Mirror Log to File"),
+        QDir::homePath() + "/msgreader.log",
+        tr("Log Files (*.log *.txt);;All Files (*)"));
+    
+    if (path.isEmpty()) {
+        const QSignalBlocker blocker(m_logMirrorCheck);
+        m_logMirrorCheck->setChecked(false);
+        return;
+    }
+    
+    if (!m_logModel->setMirrorFile(path)) {
+        const QSignalBlocker blocker(m_logMirrorCheck);
+        m_logMirrorCheck->setChecked(false);
+        logError(tr("Failed to open log file: %1").arg(path));
+        return;
+    }
+    log(tr("Mirroring log to %1").arg(path));
+}
+
+void MainWindow::withLoadedMessage(MessageView* view, const std::function<void()>& action) {
+    view->ensureLoaded([this, view, action](bool ok) {
+        if (!ok) {
+            logError(tr("Failed to reload message: %1").arg(view->filePath()));
+            QMessageBox::warning(this, tr("Error"),
+                tr("Failed to reload message: %1").arg(view->filePath()));
+            return;
+        }
+        action();
+    });
 }
 
-void MainWindow::log(const QString& message) {
-    QString timestamp = QTime::currentTime().toString("hh:mm:ss");
-    m_statusLog->append(QString("[%1] %2").arg(timestamp, message));
+void MainWindow::log(const QString& message, const QString& source) {
+    m_logModel->append(LogModel::Level::Info, source, message);
 }
 
-void MainWindow::logWarning(const QString& message) {
-    QString timestamp = QTime::currentTime().toString("hh:mm:ss");
-    m_statusLog->append(QString("<span style='color: orange;'>[%1] WARNING: %2</span>").arg(timestamp, message));
+void MainWindow::logWarning(const QString& message, const QString& source) {
+    m_logModel->append(LogModel::Level::Warning, source, message);
 }
 
-void MainWindow::logError(const QString& message) {
-    QString timestamp = QTime::currentTime().toString("hh:mm:ss");
-    m_statusLog->append(QString("<span style='color: red;'>[%1] ERROR: %2</span>").arg(timestamp, message));
+void MainWindow::logError(const QString& message, const QString& source) {
+    m_logModel->append(LogModel::Level::Error, source, message);
 }
@@ -3,73 +3,136 @@
 
 #include <QMainWindow>
 #include <QTreeView>
-#include <QTextEdit>
 #include <QLabel>
-#include <QTableView>
 #include <QSplitter>
+#include <QAction>
+#include <QTabWidget>
+#include <QListView>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QFutureWatcher>
+#include <functional>
 #include "MsgParser.h"
 #include "MsgFileModel.h"
-#include "AttachmentModel.h"
+#include "MessageView.h"
+#include "ConversationView.h"
+#include "LogModel.h"
+#include "LogFilterModel.h"
+#include "OpenFileCache.h"
+
+class QDragEnterEvent;
+class QDropEvent;
 
 /**
  * Main application window for viewing MSG email files.
- * Provides a file browser, message header display, body viewer, attachments table, and status log.
+ * Provides a file browser, conversation view, message tabs (MessageView) and status log.
+ * Background tabs are evicted to a compact form once all tabs together exceed a memory budget.
  */
 class MainWindow : public QMainWindow {
     Q_OBJECT
     
 public:
+    /** Default memory budget for all open message tabs together. */
+    static constexpr qint64 DefaultTabMemoryBudget = 256LL * 1024 * 1024;
+    
     explicit MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
     
-    /** Loads and displays an MSG file. */
+    /** Loads an MSG file and shows it in a tab (or selects the tab it is already open in). */
     void loadFile(const QString& filePath);
+    /** Opens several MSG files in tabs, parsing them concurrently. */
+    void openFiles(const QStringList& filePaths);
+    /** Sets the memory budget for open tabs in bytes (0 = never evict). */
+    void setTabMemoryBudget(qint64 bytes);
+    
+protected:
+    void dragEnterEvent(QDragEnterEvent* event) override;
+    void dropEvent(QDropEvent* event) override;
     
 private slots:
-    /** Opens file dialog to select an MSG file. */
+    /** Opens file dialog to select one or more MSG files. */
     void onOpenFile();
     /** Saves the currently selected attachment. */
     void onSaveAttachment();
+    /** Exports the current message as an RFC 5322 .eml file. */
+    void onExportEml();
+    /** Exports the current message as a PDF (same layout as --export-pdf). */
+    void onExportPdf();
+    /** Scans a folder for duplicate messages. */
+    void onFindDuplicates();
+    /** Computes sender/month/attachment statistics for a folder. */
+    void onFolderAnalytics();
     /** Handles double-click on a file in the browser. */
     void onFileDoubleClicked(const QModelIndex& index);
+    /** Opens all MSG files selected in the browser. */
+    void onOpenSelectedFiles();
     /** Handles double-click on an attachment to save it. */
-    void onAttachmentDoubleClicked(const QModelIndex& index);
+    void onAttachmentActivated(int row);
+    /** Opens an attachment of the current message in its default application. */
+    void onOpenAttachment(int row);
+    /** Extracts a member of a ZIP attachment to a file chosen by the user. */
+    void onArchiveEntryActivated(int attachmentRow, const ZipArchive::Entry& entry);
+    /** Rehydrates the selected tab and updates title and actions. */
+    void onMessageTabChanged(int index);
+    /** Closes a message tab. */
+    void onMessageTabCloseRequested(int index);
+    /** Starts or stops mirroring the status log to a file. */
+    void onMirrorLogToggled(bool checked);
     
 private:
     /** Sets up the UI layout and widgets. */
     void setupUi();
-    /** Creates the menu bar with File and Help menus. */
+    /** Creates the menu bar with File, Tools and Help menus. */
     void setupMenus();
-    /** Updates the message view with parsed email data. */
-    void updateMessageView(const EmailMessage& msg);
+    /** Adds a tab for a parsed message. */
+    MessageView* addMessageTab(const QString& filePath, const EmailMessage& msg, bool makeCurrent);
+    /** Tab showing filePath, or nullptr. */
+    MessageView* findMessageTab(const QString& filePath) const;
+    /** Message in the selected tab, or nullptr. */
+    MessageView* currentMessageView() const;
+    /** Evicts least recently used background tabs until all tabs fit the memory budget. */
+    void enforceMemoryBudget();
+    /** Logs subject, body type and attachments of a loaded message. */
+    void logMessageSummary(const EmailMessage& msg);
+    /** Asks for a path and saves an attachment of the current message. */
+    void saveAttachment(int row);
+    /** Runs action once view has its attachment payloads again (see MessageView::ensureLoaded()); reports a failed reload. */
+    void withLoadedMessage(MessageView* view, const std::function<void()>& action);
     /** Logs a message to the status log with timestamp. */
-    void log(const QString& message);
+    void log(const QString& message, const QString& source = QStringLiteral("app"));
     /** Logs a warning message (orange) to the status log. */
-    void logWarning(const QString& message);
+    void logWarning(const QString& message, const QString& source = QStringLiteral("app"));
     /** Logs an error message (red) to the status log. */
-    void logError(const QString& message);
+    void logError(const QString& message, const QString& source = QStringLiteral("app"));
     
     QSplitter* m_mainSplitter;
     QSplitter* m_contentSplitter;
     
+    QTabWidget* m_browserTabs;
     QTreeView* m_fileBrowser;
     MsgFileModel* m_fileModel;
+    ConversationView* m_conversationView;
     
-    QWidget* m_messagePanel;
-    QLabel* m_subjectLabel;
-    QLabel* m_fromLabel;
-    QLabel* m_toLabel;
-    QLabel* m_ccLabel;
-    QLabel* m_dateLabel;
-    QTextEdit* m_bodyView;
-    
-    QTableView* m_attachmentView;
-    AttachmentModel* m_attachmentModel;
+    QTabWidget* m_messageTabs;
+    QList<QFutureWatcher<MessageView::LoadedMessage>*> m_openWatchers;
+    OpenFileCache m_attachmentFiles;
+    QList<QFutureWatcher<OpenFileCache::Result>*> m_attachmentWriters;
+    qint64 m_tabMemoryBudget = DefaultTabMemoryBudget;
+    quint64 m_activationCounter = 0;
     
-    QTextEdit* m_statusLog;
+    LogModel* m_logModel;
+    LogFilterModel* m_logFilter;
+    QListView* m_logView;
+    QComboBox* m_logLevelFilter;
+    QCheckBox* m_logMirrorCheck;
+    bool m_logFollowTail = true;
     
-    QString m_currentFile;
-    EmailMessage m_currentMessage;
+    QAction* m_exportEmlAction;
+    QAction* m_exportPdfAction;
+    QAction* m_closeTabAction;
+    QAction* m_findAction;
+    QAction* m_findNextAction;
+    QAction* m_findPreviousAction;
 };
 
 #endif
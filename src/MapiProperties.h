@@ -0,0 +1,295 @@
+#ifndef MAPIPROPERTIES_H
+#define MAPIPROPERTIES_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QTimeZone>
+#include <type_traits>
+#include "CodepageDecoder.h"
+#include "EmailTypes.h"
+
+/**
+ * Compile-time registry of MAPI properties stored in MSG files (MS-OXMSG).
+ *
+ * Each property is a constexpr PropertyTag; PropertyTraits<Type> knows how a
+ * property of that type is stored and decoded. Stream names are built at
+ * compile time, so reading a property costs only the stream access itself.
+ *
+ * Readers are templated on a Source type that provides:
+ *   QByteArray stream(const char* name) const;        // null if missing
+ *   bool fixedValue(quint32 tag, quint64& value) const; // from the property stream
+ *   int codepage() const;                               // for PT_STRING8 values
+ */
+namespace Mapi {
+
+enum PropertyType : quint16 {
+    PT_LONG = 0x0003,
+    PT_BOOLEAN = 0x000B,
+    PT_STRING8 = 0x001E,
+    PT_UNICODE = 0x001F,
+    PT_SYSTIME = 0x0040,
+    PT_BINARY = 0x0102,
+    PT_MV_STRING8 = 0x101E,
+    PT_MV_UNICODE = 0x101F
+};
+
+/** A MAPI property: 16-bit ID, 16-bit type and its canonical name. */
+struct PropertyTag {
+    quint16 id;
+    quint16 type;
+    const char* name;
+    
+    constexpr quint32 tag() const { return (quint32(id) << 16) | type; }
+};
+
+/** NUL-terminated stream name "__substg1.0_XXXXYYYY". */
+struct StreamName {
+    char chars[21];
+};
+
+constexpr StreamName makeStreamName(quint16 id, quint16 type) {
+    StreamName name{};
+    const char prefix[] = "__substg1.0_";
+    const char hex[] = "0123456789ABCDEF";
+    for (int i = 0; i < 12; ++i) name.chars[i] = prefix[i];
+    const quint32 tag = (quint32(id) << 16) | type;
+    for (int i = 0; i < 8; ++i) name.chars[12 + i] = hex[(tag >> (28 - 4 * i)) & 0xf];
+    name.chars[20] = '\0';
+    return name;
+}
+
+/** Stream name of a property, evaluated at compile time. */
+template <quint16 Id, quint16 Type>
+inline constexpr StreamName kStreamName = makeStreamName(Id, Type);
+
+/** Message-level properties known to the parser. */
+namespace Tags {
+inline constexpr PropertyTag Subject{0x0037, PT_UNICODE, "PR_SUBJECT"};
+inline constexpr PropertyTag ClientSubmitTime{0x0039, PT_SYSTIME, "PR_CLIENT_SUBMIT_TIME"};
+inline constexpr PropertyTag ConversationTopic{0x0070, PT_UNICODE, "PR_CONVERSATION_TOPIC"};
+inline constexpr PropertyTag ConversationIndex{0x0071, PT_BINARY, "PR_CONVERSATION_INDEX"};
+inline constexpr PropertyTag SenderName{0x0C1A, PT_UNICODE, "PR_SENDER_NAME"};
+inline constexpr PropertyTag MessageDeliveryTime{0x0E06, PT_SYSTIME, "PR_MESSAGE_DELIVERY_TIME"};
+inline constexpr PropertyTag Body{0x1000, PT_UNICODE, "PR_BODY"};
+inline constexpr PropertyTag Html{0x1013, PT_BINARY, "PR_HTML"};
+inline constexpr PropertyTag InternetMessageId{0x1035, PT_UNICODE, "PR_INTERNET_MESSAGE_ID"};
+inline constexpr PropertyTag InternetReferences{0x1039, PT_UNICODE, "PR_INTERNET_REFERENCES"};
+inline constexpr PropertyTag InReplyToId{0x1042, PT_UNICODE, "PR_IN_REPLY_TO_ID"};
+inline constexpr PropertyTag InternetCodepage{0x3FDE, PT_LONG, "PR_INTERNET_CPID"};
+inline constexpr PropertyTag MessageCodepage{0x3FFD, PT_LONG, "PR_MESSAGE_CODEPAGE"};
+inline constexpr PropertyTag SenderSmtpAddress{0x5D01, PT_UNICODE, "PR_SENDER_SMTP_ADDRESS"};
+}
+
+/** Attachment properties, read from an "__attach_version1.0_#XXXXXXXX" storage. */
+namespace AttachmentTags {
+inline constexpr PropertyTag DisplayName{0x3001, PT_UNICODE, "PR_DISPLAY_NAME"};
+inline constexpr PropertyTag DataBinary{0x3701, PT_BINARY, "PR_ATTACH_DATA_BIN"};
+inline constexpr PropertyTag Filename{0x3704, PT_UNICODE, "PR_ATTACH_FILENAME"};
+inline constexpr PropertyTag LongFilename{0x3707, PT_UNICODE, "PR_ATTACH_LONG_FILENAME"};
+inline constexpr PropertyTag MimeTag{0x370E, PT_UNICODE, "PR_ATTACH_MIME_TAG"};
+}
+
+/** How a property type is stored and decoded; specialized per PT_* type. */
+template <quint16 Type>
+struct PropertyTraits;
+
+/** PT_UNICODE: UTF-16LE stream; falls back to the PT_STRING8 stream decoded with the message codepage. */
+template <>
+struct PropertyTraits<PT_UNICODE> {
+    using ValueType = QString;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, QString& value) {
+        QByteArray raw = source.stream(kStreamName<Id, PT_UNICODE>.chars);
+        if (!raw.isNull()) {
+            value = CodepageDecoder::decodeUtf16Le(raw);
+            return true;
+        }
+        raw = source.stream(kStreamName<Id, PT_STRING8>.chars);
+        if (!raw.isNull()) {
+            value = CodepageDecoder::decode(raw, source.codepage());
+            return true;
+        }
+        return false;
+    }
+};
+
+/** PT_STRING8 is stored either way depending on the store; both read the same. */
+template <>
+struct PropertyTraits<PT_STRING8> : PropertyTraits<PT_UNICODE> {};
+
+/** PT_BINARY: raw stream contents. */
+template <>
+struct PropertyTraits<PT_BINARY> {
+    using ValueType = QByteArray;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, QByteArray& value) {
+        QByteArray raw = source.stream(kStreamName<Id, PT_BINARY>.chars);
+        if (raw.isNull()) return false;
+        value = raw;
+        return true;
+    }
+};
+
+/** PT_LONG: 32-bit value from the fixed-size property stream. */
+template <>
+struct PropertyTraits<PT_LONG> {
+    using ValueType = qint32;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, qint32& value) {
+        quint64 raw = 0;
+        if (!source.fixedValue((quint32(Id) << 16) | PT_LONG, raw)) return false;
+        value = static_cast<qint32>(raw & 0xffffffff);
+        return true;
+    }
+};
+
+/** PT_BOOLEAN: fixed-size property, non-zero low byte is true. */
+template <>
+struct PropertyTraits<PT_BOOLEAN> {
+    using ValueType = bool;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, bool& value) {
+        quint64 raw = 0;
+        if (!source.fixedValue((quint32(Id) << 16) | PT_BOOLEAN, raw)) return false;
+        value = (raw & 0xff) != 0;
+        return true;
+    }
+};
+
+/** PT_SYSTIME: FILETIME (100 ns ticks since 1601-01-01 UTC) from the fixed-size property stream. */
+template <>
+struct PropertyTraits<PT_SYSTIME> {
+    using ValueType = QDateTime;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, QDateTime& value) {
+        constexpr quint64 kUnixEpochFileTime = 116444736000000000ULL;
+        quint64 fileTime = 0;
+        if (!source.fixedValue((quint32(Id) << 16) | PT_SYSTIME, fileTime)) return false;
+        if (fileTime < kUnixEpochFileTime) return false;
+        value = QDateTime::fromMSecsSinceEpoch(
+            static_cast<qint64>((fileTime - kUnixEpochFileTime) / 10000), QTimeZone::UTC);
+        return true;
+    }
+};
+
+/**
+ * PT_MV_UNICODE / PT_MV_STRING8: the "__substg1.0_XXXX101F" stream holds one
+ * 4-byte length per value; value N lives in "__substg1.0_XXXX101F-0000000N".
+ */
+template <quint16 ElementType>
+struct MultiValuedStringTraits {
+    using ValueType = QStringList;
+    
+    template <quint16 Id, typename Source>
+    static bool read(const Source& source, QStringList& value) {
+        constexpr quint16 type = ElementType | 0x1000;
+        const QByteArray lengths = source.stream(kStreamName<Id, type>.chars);
+        if (lengths.isNull()) return false;
+        
+        value.clear();
+        const qsizetype count = lengths.size() / 4;
+        for (qsizetype i = 0; i < count; ++i) {
+            const QByteArray name = QByteArray(kStreamName<Id, type>.chars) + '-'
+                + QByteArray::number(static_cast<qulonglong>(i), 16).rightJustified(8, '0').toUpper();
+            const QByteArray raw = source.stream(name.constData());
+            value.append(ElementType == PT_UNICODE
+                ? CodepageDecoder::decodeUtf16Le(raw)
+                : CodepageDecoder::decode(raw, source.codepage()));
+        }
+        return true;
+    }
+};
+
+template <>
+struct PropertyTraits<PT_MV_UNICODE> : MultiValuedStringTraits<PT_UNICODE> {};
+template <>
+struct PropertyTraits<PT_MV_STRING8> : MultiValuedStringTraits<PT_STRING8> {};
+
+/** Reads a property into value; returns false if the message does not contain it. */
+template <const PropertyTag& Tag, typename Source>
+bool readProperty(const Source& source, typename PropertyTraits<Tag.type>::ValueType& value) {
+    return PropertyTraits<Tag.type>::template read<Tag.id>(source, value);
+}
+
+/** True if a field has not been filled yet (earlier registry entries take precedence). */
+inline bool isUnset(const QString& value) { return value.isEmpty(); }
+inline bool isUnset(const QByteArray& value) { return value.isEmpty(); }
+inline bool isUnset(const QStringList& value) { return value.isEmpty(); }
+inline bool isUnset(const QDateTime& value) { return !value.isValid(); }
+inline bool isUnset(qint32 value) { return value == 0; }
+
+/** Binds a property to the member of the target struct it fills. */
+template <const PropertyTag& Tag, auto Member>
+struct Field {
+    template <typename Source, typename Target>
+    static void read(const Source& source, Target& target) {
+        auto& member = target.*Member;
+        using Traits = PropertyTraits<Tag.type>;
+        static_assert(std::is_same_v<std::decay_t<decltype(member)>, typename Traits::ValueType>,
+                      "Target member type does not match the property type");
+        if (isUnset(member)) {
+            Traits::template read<Tag.id>(source, member);
+        }
+    }
+};
+
+/** A list of field bindings, read in order; the first property found wins. */
+template <typename... Fields>
+struct FieldList {
+    template <typename Source, typename Target>
+    static void read(const Source& source, Target& target) {
+        (Fields::read(source, target), ...);
+    }
+};
+
+/** EmailMessage header fields filled from top-level message properties. Add a property here to extract it. */
+using HeaderFields = FieldList<
+    Field<Tags::Subject, &EmailMessage::subject>,
+    Field<Tags::SenderName, &EmailMessage::senderName>,
+    Field<Tags::SenderSmtpAddress, &EmailMessage::senderEmail>,
+    Field<Tags::ClientSubmitTime, &EmailMessage::date>,
+    Field<Tags::MessageDeliveryTime, &EmailMessage::date>,
+    Field<Tags::InternetMessageId, &EmailMessage::messageId>,
+    Field<Tags::InReplyToId, &EmailMessage::inReplyTo>,
+    Field<Tags::InternetReferences, &EmailMessage::references>,
+    Field<Tags::ConversationTopic, &EmailMessage::conversationTopic>,
+    Field<Tags::ConversationIndex, &EmailMessage::conversationIndex>
+>;
+
+/** Body fields, read separately so header-only parses can skip the (large) body stream. */
+using BodyFields = FieldList<
+    Field<Tags::Body, &EmailMessage::bodyPlainText>
+>;
+
+/** EmailAttachment name and type, for attachment lists read without the payload stream. */
+using AttachmentFields = FieldList<
+    Field<AttachmentTags::LongFilename, &EmailAttachment::filename>,
+    Field<AttachmentTags::Filename, &EmailAttachment::filename>,
+    Field<AttachmentTags::DisplayName, &EmailAttachment::filename>,
+    Field<AttachmentTags::MimeTag, &EmailAttachment::mimeType>
+>;
+
+/**
+ * Size in bytes of a variable-length property, from its property stream entry
+ * (the low 32 bits of the value field), without reading the property's stream.
+ */
+template <const PropertyTag& Tag, typename Source>
+bool readPropertySize(const Source& source, qint64& size) {
+    static_assert(Tag.type == PT_BINARY || Tag.type == PT_UNICODE || Tag.type == PT_STRING8,
+                  "only variable-length properties have a size entry");
+    quint64 raw = 0;
+    if (!source.fixedValue(Tag.tag(), raw)) return false;
+    size = static_cast<qint64>(raw & 0xffffffff);
+    return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef MESSAGEIDS_H
+#define MESSAGEIDS_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/**
+ * Compact 64-bit keys for message identifiers (Internet Message-IDs and
+ * conversation indexes), so indexes over many messages hash and compare
+ * integers instead of strings. Keys are never 0; 0 means "no identifier".
+ */
+namespace MessageIds {
+
+constexpr quint64 kFnvOffset = 14695981039346656037ULL;
+constexpr quint64 kFnvPrime = 1099511628211ULL;
+
+/** FNV-1a over raw bytes, continuing from hash. */
+inline quint64 fnv1a(const char* data, qsizetype size, quint64 hash = kFnvOffset) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    for (qsizetype i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * kFnvPrime;
+    }
+    return hash;
+}
+
+/** FNV-1a over the UTF-16 code units of a string, continuing from hash. */
+inline quint64 fnv1a(const QString& text, quint64 hash = kFnvOffset) {
+    return fnv1a(reinterpret_cast<const char*>(text.utf16()), text.size() * 2, hash);
+}
+
+/** Key of an Internet Message-ID; surrounding whitespace and angle brackets are ignored. */
+inline quint64 messageIdKey(const QString& id) {
+    QString trimmed = id.trimmed();
+    if (trimmed.startsWith('<') && trimmed.endsWith('>')) {
+        trimmed = trimmed.mid(1, trimmed.size() - 2).trimmed();
+    }
+    if (trimmed.isEmpty()) return 0;
+    const quint64 hash = fnv1a(trimmed);
+    return hash ? hash : 1;
+}
+
+/**
+ * Key of a PR_CONVERSATION_INDEX value (or a prefix of one). A different
+ * seed keeps these keys apart from Message-ID keys in a shared index.
+ */
+inline quint64 conversationIndexKey(const char* data, qsizetype size) {
+    if (size <= 0) return 0;
+    const quint64 hash = fnv1a(data, size, fnv1a("ci:", 3));
+    return hash ? hash : 1;
+}
+
+/** Splits a References / In-Reply-To value into its "<...>" identifiers, in order. */
+inline QList<QString> parseIdList(const QString& value) {
+    QList<QString> ids;
+    qsizetype pos = 0;
+    while ((pos = value.indexOf('<', pos)) >= 0) {
+        const qsizetype end = value.indexOf('>', pos + 1);
+        if (end < 0) break;
+        ids.append(value.mid(pos, end - pos + 1));
+        pos = end + 1;
+    }
+    // Some clients omit the brackets; fall back to whitespace-separated tokens
+    if (ids.isEmpty()) {
+        const QString simplified = value.simplified();
+        if (!simplified.isEmpty()) ids = simplified.split(' ');
+    }
+    return ids;
+}
+
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "MessageView.h"
+#include "AttachmentModel.h"
+#include "FindBar.h"
+#include "Metrics.h"
+#include "MsgParser.h"
+#include "ThumbnailCache.h"
+#include <QAction>
+#include <QFileInfo>
+#include <QGridLayout>
+#include <QGroupBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QSplitter>
+#include <QTreeView>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+#include <utility>
+
+namespace {
+
+// Rough heap cost of a laid-out QTextDocument per character of content
+// (fragments, formats, layout lines); only used to weigh tabs against each other
+constexpr qint64 kRenderedBytesPerChar = 8;
+
+// Body text shorter than this is kept as is when a tab is evicted
+constexpr qsizetype kCompressThreshold = 4096;
+
+qint64 textCost(const QString& text) {
+    return text.size() * qint64(sizeof(QChar));
+}
+
+}
+
+MessageView::MessageView(QWidget* parent)
+    : QWidget(parent)
+    , m_attachmentModel(new AttachmentModel(this))
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    
+    QSplitter* splitter = new QSplitter(Qt::Vertical);
+    layout->addWidget(splitter);
+    
+    // Message panel with header and body
+    QWidget* messagePanel = new QWidget(splitter);
+    QVBoxLayout* messageLayout = new QVBoxLayout(messagePanel);
+    messageLayout->setContentsMargins(8, 8, 8, 8);
+    
+    // Header section with labels
+    QGroupBox* headerGroup = new QGroupBox(tr("Message Header"), messagePanel);
+    QGridLayout* headerLayout = new QGridLayout(headerGroup);
+    
+    int row = 0;
+    headerLayout->addWidget(new QLabel(tr("<b>Subject:</b>")), row, 0);
+    m_subjectLabel = new QLabel;
+    m_subjectLabel->setWordWrap(true);
+    m_subjectLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_subjectLabel, row, 1);
+    
+    ++row;
+    headerLayout->addWidget(new QLabel(tr("<b>From:</b>")), row, 0);
+    m_fromLabel = new QLabel;
+    m_fromLabel->setWordWrap(true);
+    m_fromLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_fromLabel, row, 1);
+    
+    ++row;
+    headerLayout->addWidget(new QLabel(tr("<b>To:</b>")), row, 0);
+    m_toLabel = new QLabel;
+    m_toLabel->setWordWrap(true);
+    m_toLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_toLabel, row, 1);
+    
+    ++row;
+    headerLayout->addWidget(new QLabel(tr("<b>Cc:</b>")), row, 0);
+    m_ccLabel = new QLabel;
+    m_ccLabel->setWordWrap(true);
+    m_ccLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_ccLabel, row, 1);
+    
+    ++row;
+    headerLayout->addWidget(new QLabel(tr("<b>Date:</b>")), row, 0);
+    m_dateLabel = new QLabel;
+    m_dateLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_dateLabel, row, 1);
+    
+    headerLayout->setColumnStretch(1, 1);
+    messageLayout->addWidget(headerGroup);
+    
+    // Body section
+    QGroupBox* bodyGroup = new QGroupBox(tr("Message Body"), messagePanel);
+    QVBoxLayout* bodyLayout = new QVBoxLayout(bodyGroup);
+    
+    m_bodyView = new QTextEdit;
+    m_bodyView->setReadOnly(true);
+    // Dropped files go to the main window, which opens them in new tabs
+    m_bodyView->setAcceptDrops(false);
+    bodyLayout->addWidget(m_bodyView);
+    
+    m_findBar = new FindBar(m_bodyView);
+    bodyLayout->addWidget(m_findBar);
+    
+    messageLayout->addWidget(bodyGroup, 1);
+    
+    // Attachments section
+    QGroupBox* attachmentGroup = new QGroupBox(tr("Attachments"), splitter);
+    QVBoxLayout* attachmentLayout = new QVBoxLayout(attachmentGroup);
+    
+    // A tree so ZIP attachments can be expanded; double-click saves/extracts, the arrow expands
+    m_attachmentView = new QTreeView;
+    m_attachmentView->setModel(m_attachmentModel);
+    m_attachmentView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_attachmentView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_attachmentView->header()->setStretchLastSection(true);
+    m_attachmentView->setAlternatingRowColors(true);
+    m_attachmentView->setExpandsOnDoubleClick(false);
+    connect(m_attachmentView, &QTreeView::doubleClicked, this, &MessageView::onAttachmentDoubleClicked);
+    // Expanding an archive of an evicted tab re-reads the payloads first
+    connect(m_attachmentModel, &AttachmentModel::payloadsRequested, this, [this]() {
+        ensureLoaded([this](bool ok) {
+            if (!ok) m_attachmentModel->failPendingArchives(tr("The message file can no longer be read"));
+        });
+    });
+    
+    // Context menu (and Enter) for the selected attachment
+    QAction* openAction = new QAction(tr("&Open"), m_attachmentView);
+    openAction->setShortcut(Qt::Key_Return);
+    openAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(openAction, &QAction::triggered, this, [this]() {
+        if (currentAttachment() >= 0) emit attachmentOpenRequested(currentAttachment());
+    });
+    m_attachmentView->addAction(openAction);
+    QAction* saveAction = new QAction(tr("&Save As..."), m_attachmentView);
+    connect(saveAction, &QAction::triggered, this, [this]() {
+        if (currentAttachment() >= 0) emit attachmentActivated(currentAttachment());
+    });
+    m_attachmentView->addAction(saveAction);
+    m_attachmentView->setContextMenuPolicy(Qt::ActionsContextMenu);
+    
+    attachmentLayout->addWidget(m_attachmentView);
+    
+    splitter->setSizes({400, 100});
+}
+
+MessageView::~MessageView() {
+    if (m_reloadWatcher) {
+        m_reloadWatcher->disconnect(this);
+        m_reloadWatcher->waitForFinished();
+    }
+}
+
+MessageView::LoadedMessage MessageView::load(const QString& filePath) {
+    MsgParser parser;
+    return LoadedMessage{filePath, parser.parse(filePath)};
+}
+
+void MessageView::setMessage(const QString& filePath, const EmailMessage& message) {
+    m_filePath = filePath;
+    m_message = message;
+    m_evicted = false;
+    m_attachmentsDropped = false;
+    m_compressedPlainText.clear();
+    m_compressedHtml.clear();
+    
+    m_subjectLabel->setText(message.subject.isEmpty() ? tr("(no subject)") : message.subject);
+    
+    // Format sender display
+    QString fromText;
+    if (!message.senderName.isEmpty() && !message.senderEmail.isEmpty()) {
+        fromText = QString("%1 <%2>").arg(message.senderName, message.senderEmail);
+    } else if (!message.senderName.isEmpty()) {
+        fromText = message.senderName;
+    } else if (!message.senderEmail.isEmpty()) {
+        fromText = message.senderEmail;
+    } else {
+        fromText = tr("(unknown sender)");
+    }
+    m_fromLabel->setText(fromText);
+    
+    // Update recipients
+    m_toLabel->setText(message.toRecipients.isEmpty() ? tr("(no recipients)") : message.toRecipients);
+    m_ccLabel->setText(message.ccRecipients.isEmpty() ? tr("-") : message.ccRecipients);
+    
+    // Update date
+    if (message.date.isValid()) {
+        m_dateLabel->setText(message.date.toLocalTime().toString(Qt::ISODate));
+    } else {
+        m_dateLabel->setText(tr("(unknown date)"));
+    }
+    
+    renderBody();
+    
+    // Update attachments
+    m_attachmentModel->setAttachments(message.attachments);
+    if (message.attachments.isEmpty()) {
+        m_attachmentView->hide();
+    } else {
+        m_attachmentView->show();
+        // Thumbnail-sized icons only when there are thumbnails; an invalid size restores the style default
+        m_attachmentView->setIconSize(m_attachmentModel->hasImages()
+            ? QSize(ThumbnailCache::IconSize, ThumbnailCache::IconSize) : QSize());
+        m_attachmentView->resizeColumnToContents(AttachmentModel::ColumnFilename);
+    }
+}
+
+QString MessageView::filePath() const {
+    return m_filePath;
+}
+
+const EmailMessage& MessageView::message() const {
+    return m_message;
+}
+
+QString MessageView::title() const {
+    return m_message.subject.isEmpty() ? QFileInfo(m_filePath).fileName() : m_message.subject;
+}
+
+qint64 MessageView::memoryCost() const {
+    qint64 cost = textCost(m_message.bodyPlainText) + textCost(m_message.bodyHtml)
+        + m_compressedPlainText.size() + m_compressedHtml.size();
+    for (const EmailAttachment& att : m_message.attachments) {
+        cost += att.data.size();
+    }
+    if (!m_evicted) {
+        cost += m_bodyView->document()->characterCount() * kRenderedBytesPerChar;
+    }
+    return cost;
+}
+
+bool MessageView::isEvicted() const {
+    return m_evicted;
+}
+
+void MessageView::evict() {
+    if (m_evicted) return;
+    
+    // Drop the laid-out document (the bulk of an HTML body's footprint)
+    m_bodyView->clear();
+    m_findBar->reset();
+    
+    if (m_message.bodyPlainText.size() >= kCompressThreshold) {
+        m_compressedPlainText = qCompress(m_message.bodyPlainText.toUtf8());
+        m_message.bodyPlainText = QString();
+    }
+    if (m_message.bodyHtml.size() >= kCompressThreshold) {
+        m_compressedHtml = qCompress(m_message.bodyHtml.toUtf8());
+        m_message.bodyHtml = QString();
+    }
+    
+    // Keep names and sizes for the table, drop the payloads
+    for (EmailAttachment& att : m_message.attachments) {
+        if (!att.data.isEmpty()) {
+            att.data = QByteArray();
+            m_attachmentsDropped = true;
+        }
+    }
+    // The model holds its own copy; release it too (thumbnails are kept)
+    m_attachmentModel->releasePayloads();
+    
+    m_evicted = true;
+}
+
+void MessageView::rehydrate() {
+    if (!m_evicted) return;
+    
+    if (!m_compressedPlainText.isEmpty()) {
+        m_message.bodyPlainText = QString::fromUtf8(qUncompress(m_compressedPlainText));
+        m_compressedPlainText.clear();
+    }
+    if (!m_compressedHtml.isEmpty()) {
+        m_message.bodyHtml = QString::fromUtf8(qUncompress(m_compressedHtml));
+        m_compressedHtml.clear();
+    }
+    renderBody();
+    m_evicted = false;
+}
+
+void MessageView::ensureLoaded(const std::function<void(bool)>& done) {
+    rehydrate();
+    if (!m_attachmentsDropped) {
+        done(true);
+        return;
+    }
+    
+    // Several actions may wait for the same reload
+    m_reloadCallbacks.append(done);
+    if (m_reloadWatcher) return;
+    
+    m_attachmentView->setEnabled(false);
+    m_attachmentView->setCursor(Qt::BusyCursor);
+    m_reloadWatcher = new QFutureWatcher<LoadedMessage>(this);
+    connect(m_reloadWatcher, &QFutureWatcher<LoadedMessage>::finished, this, &MessageView::onReloadFinished);
+    m_reloadWatcher->setFuture(QtConcurrent::run(&MessageView::load, m_filePath));
+}
+
+bool MessageView::isLoading() const {
+    return m_reloadWatcher != nullptr;
+}
+
+void MessageView::onReloadFinished() {
+    const EmailMessage reloaded = m_reloadWatcher->result().message;
+    m_reloadWatcher->deleteLater();
+    m_reloadWatcher = nullptr;
+    m_attachmentView->unsetCursor();
+    m_attachmentView->setEnabled(true);
+    
+    // The tab may have been evicted meanwhile; the waiting actions need the body too
+    rehydrate();
+    const bool ok = reloaded.isValid && reloaded.attachments.size() == m_message.attachments.size();
+    if (ok) {
+        m_message.attachments = reloaded.attachments;
+        m_attachmentModel->restorePayloads(m_message.attachments);
+        m_attachmentsDropped = false;
+    }
+    
+    const QList<std::function<void(bool)>> callbacks = std::exchange(m_reloadCallbacks, {});
+    for (const std::function<void(bool)>& done : callbacks) {
+        done(ok);
+    }
+}
+
+int MessageView::currentAttachment() const {
+    const QModelIndex index = m_attachmentView->currentIndex();
+    return index.isValid() && !index.parent().isValid() ? index.row() : -1;
+}
+
+void MessageView::onAttachmentDoubleClicked(const QModelIndex& index) {
+    if (!index.isValid()) return;
+    
+    const QModelIndex first = index.siblingAtColumn(0);
+    if (const ZipArchive::Entry* entry = m_attachmentModel->archiveEntry(first)) {
+        // A copy: reloading payloads for extraction may rebuild the model if the file changed
+        const ZipArchive::Entry member = *entry;
+        emit archiveEntryActivated(m_attachmentModel->attachmentRow(first), member);
+    } else if (first.parent().isValid()) {
+        // Archive folder
+        m_attachmentView->setExpanded(first, !m_attachmentView->isExpanded(first));
+    } else {
+        emit attachmentActivated(first.row());
+    }
+}
+
+void MessageView::renderBody() {
+    Metrics::Timer metricsTimer(Metrics::Render);
+    
+    // Prefer HTML over plain text
+    QString bodyText = m_message.bodyHtml.isEmpty() ? m_message.bodyPlainText : m_message.bodyHtml;
+    bodyText.remove('\0');
+    
+    if (!m_message.bodyHtml.isEmpty()) {
+        m_bodyView->setHtml(bodyText);
+    } else if (!m_message.bodyPlainText.isEmpty()) {
+        m_bodyView->setPlainText(bodyText);
+    } else {
+        m_bodyView->setPlainText(tr("(no message body)"));
+    }
+    // Hits refer to positions in the previous document
+    m_findBar->reset();
+}
@@ -0,0 +1,119 @@
+#ifndef MESSAGEVIEW_H
+#define MESSAGEVIEW_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <functional>
+#include "EmailTypes.h"
+#include "ZipArchive.h"
+
+class QLabel;
+class QTreeView;
+class QTextEdit;
+class AttachmentModel;
+class FindBar;
+
+/**
+ * One open message: header labels, body viewer and attachments tree.
+ * MainWindow shows one MessageView per tab.
+ *
+ * Background tabs can be evicted to a compact form: the rendered body
+ * document and attachment payloads are dropped and the body text is kept
+ * compressed. Reselecting the tab rehydrates the body from that text;
+ * attachment payloads are re-read from the file, on a worker thread, only
+ * when they are needed.
+ * A find bar below the body searches the rendered body text.
+ */
+class MessageView : public QWidget {
+    Q_OBJECT
+    
+public:
+    /** A parsed file, as produced on a worker thread by load(). */
+    struct LoadedMessage {
+        QString filePath;
+        EmailMessage message;
+    };
+    
+    explicit MessageView(QWidget* parent = nullptr);
+    /** Waits for a reload started by ensureLoaded() (the parse must not outlive the window). */
+    ~MessageView();
+    
+    /** Parses filePath; safe to call from any thread. */
+    static LoadedMessage load(const QString& filePath);
+    
+    /** Shows a parsed message. */
+    void setMessage(const QString& filePath, const EmailMessage& message);
+    QString filePath() const;
+    /** The message; body and attachment payloads may be missing while evicted (see ensureLoaded()). */
+    const EmailMessage& message() const;
+    /** Short title for the tab (subject, else file name). */
+    QString title() const;
+    
+    /** Approximate bytes held for this message, including the rendered body. */
+    qint64 memoryCost() const;
+    bool isEvicted() const;
+    /** Drops the rendered body and attachment payloads and compresses the body text. */
+    void evict();
+    /** Renders the body again after evict(); attachment payloads stay unloaded. */
+    void rehydrate();
+    /**
+     * Re-reads attachment payloads dropped by evict() on the thread pool, then
+     * calls done with false if the file cannot be parsed any more. done runs
+     * right away when nothing was dropped, and never if the view is destroyed
+     * first. The attachment list is disabled while the reload runs.
+     */
+    void ensureLoaded(const std::function<void(bool)>& done);
+    /** True while ensureLoaded() is re-reading the file. */
+    bool isLoading() const;
+    
+    /** Find bar of the body viewer (Ctrl+F / F3 are routed here by MainWindow). */
+    FindBar* findBar() const { return m_findBar; }
+    
+    /** Row of the selected attachment (not archive member), or -1. */
+    int currentAttachment() const;
+    
+    /** Monotonic stamp of the last activation, used for least-recently-used eviction. */
+    quint64 lastActivated() const { return m_lastActivated; }
+    void setLastActivated(quint64 stamp) { m_lastActivated = stamp; }
+    
+signals:
+    /** Emitted when the user double-clicks an attachment (or picks Save As). */
+    void attachmentActivated(int row);
+    /** Emitted when the user asks to open an attachment in its default application. */
+    void attachmentOpenRequested(int row);
+    /** Emitted when the user double-clicks a member of a ZIP attachment. */
+    void archiveEntryActivated(int attachmentRow, const ZipArchive::Entry& entry);
+    
+private slots:
+    /** Saves attachments, extracts archive members, toggles archive folders. */
+    void onAttachmentDoubleClicked(const QModelIndex& index);
+    
+private:
+    /** Sets the body viewer from the message body (HTML preferred). */
+    void renderBody();
+    /** Puts the reloaded payloads back and runs the waiting ensureLoaded() callbacks. */
+    void onReloadFinished();
+    
+    QLabel* m_subjectLabel;
+    QLabel* m_fromLabel;
+    QLabel* m_toLabel;
+    QLabel* m_ccLabel;
+    QLabel* m_dateLabel;
+    QTextEdit* m_bodyView;
+    FindBar* m_findBar;
+    QTreeView* m_attachmentView;
+    AttachmentModel* m_attachmentModel;
+    
+    QString m_filePath;
+    EmailMessage m_message;
+    
+    bool m_evicted = false;
+    bool m_attachmentsDropped = false;
+    QByteArray m_compressedPlainText;
+    QByteArray m_compressedHtml;
+    QFutureWatcher<LoadedMessage>* m_reloadWatcher = nullptr;
+    QList<std::function<void(bool)>> m_reloadCallbacks;
+    quint64 m_lastActivated = 0;
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include "Metrics.h"
+#include "LatencyHistogram.h"
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+
+#if defined(Q_OS_UNIX)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct OperationStats {
+    /** Microseconds. */
+    LatencyHistogram latency;
+    QAtomicInteger<quint64> bytes;
+};
+
+struct Session {
+    OperationStats operations[Metrics::OperationCount];
+    QDateTime started = QDateTime::currentDateTimeUtc();
+    QElapsedTimer uptime;
+    
+    Session() { uptime.start(); }
+};
+
+// Created before main(), so uptime covers the whole process
+Session s_session;
+
+// Serializes dumps from the signal helper and the one on exit
+QMutex s_writeMutex;
+
+// Bucket bounds for Prometheus (seconds); the fine histogram is summed up to each of them
+constexpr double kPrometheusBounds[] = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300
+};
+
+constexpr double kPercentiles[] = {50, 90, 99, 99.9};
+
+double uptimeSeconds() {
+    return qMax<qint64>(s_session.uptime.elapsed(), 1) / 1000.0;
+}
+
+QByteArray number(double value) {
+    return QByteArray::number(value, 'g', 10);
+}
+
+#if defined(Q_OS_UNIX)
+int s_signalPipe[2] = {-1, -1};
+
+void onDumpSignal(int) {
+    // Only async-signal-safe calls here; the helper thread does the dump
+    const int savedErrno = errno;
+    const char byte = 1;
+    // A full pipe means a dump is pending anyway
+    const ssize_t written = ::write(s_signalPipe[1], &byte, 1);
+    Q_UNUSED(written);
+    errno = savedErrno;
+}
+#endif
+
+}
+
+void Metrics::record(Operation operation, qint64 elapsedNs, qint64 bytes) {
+    OperationStats& stats = s_session.operations[operation];
+    stats.latency.record(quint64(qMax<qint64>(0, elapsedNs)) / 1000);
+    if (bytes > 0) stats.bytes.fetchAndAddRelaxed(quint64(bytes));
+}
+
+Metrics::Timer::Timer(Operation operation)
+    : m_operation(operation)
+{
+    m_timer.start();
+}
+
+Metrics::Timer::~Timer() {
+    record(m_operation, m_timer.nsecsElapsed(), m_bytes);
+}
+
+const char* Metrics::operationName(Operation operation) {
+    switch (operation) {
+        case Open:
+            return "open";
+        case Parse:
+            return "parse";
+        case Render:
+            return "render";
+        case Save:
+            return "save";
+    }
+    return "unknown";
+}
+
+QByteArray Metrics::toJson() {
+    const double uptime = uptimeSeconds();
+    QJsonObject root;
+    root["version"] = QCoreApplication::applicationVersion();
+    root["started"] = s_session.started.toString(Qt::ISODate);
+    root["uptimeSeconds"] = uptime;
+    
+    QJsonObject operations;
+    for (int i = 0; i < OperationCount; ++i) {
+        const OperationStats& stats = s_session.operations[i];
+        const LatencyHistogram::Snapshot snapshot = stats.latency.snapshot();
+        const quint64 bytes = stats.bytes.loadRelaxed();
+        
+        QJsonObject operation;
+        operation["count"] = qint64(snapshot.count);
+        operation["perSecond"] = snapshot.count / uptime;
+        operation["bytes"] = qint64(bytes);
+        operation["bytesPerSecond"] = bytes / uptime;
+        operation["minMs"] = snapshot.min / 1000.0;
+        operation["meanMs"] = snapshot.mean() / 1000.0;
+        operation["p50Ms"] = snapshot.valueAtPercentile(50) / 1000.0;
+        operation["p90Ms"] = snapshot.valueAtPercentile(90) / 1000.0;
+        operation["p99Ms"] = snapshot.valueAtPercentile(99) / 1000.0;
+        operation["p999Ms"] = snapshot.valueAtPercentile(99.9) / 1000.0;
+        operation["maxMs"] = snapshot.max / 1000.0;
+        
+        // Non-empty buckets only, so histograms from different runs can be merged offline
+        QJsonArray buckets;
+        for (int b = 0; b < snapshot.counts.size(); ++b) {
+            if (snapshot.counts.at(b) == 0) continue;
+            buckets.append(QJsonObject{
+                {"fromUs", qint64(LatencyHistogram::bucketLowerBound(b))},
+                {"toUs", qint64(LatencyHistogram::bucketUpperBound(b))},
+                {"count", qint64(snapshot.counts.at(b))}});
+        }
+        operation["histogram"] = buckets;
+        operations[operationName(Operation(i))] = operation;
+    }
+    root["operations"] = operations;
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray Metrics::toPrometheus() {
+    QByteArray out;
+    out += "# HELP msgreader_operation_duration_seconds Duration of open, parse, render and save operations.\n";
+    out += "# TYPE msgreader_operation_duration_seconds histogram\n";
+    QList<LatencyHistogram::Snapshot> snapshots;
+    for (int i = 0; i < OperationCount; ++i) {
+        const LatencyHistogram::Snapshot snapshot = s_session.operations[i].latency.snapshot();
+        const QByteArray label = QByteArray("operation=\"") + operationName(Operation(i)) + '"';
+        for (double bound : kPrometheusBounds) {
+            // A fine bucket that straddles the bound is counted in the next one
+            out += "msgreader_operation_duration_seconds_bucket{" + label + ",le=\"" + number(bound) + "\"} "
+                + QByteArray::number(snapshot.countAtOrBelow(quint64(bound * 1e6))) + '\n';
+        }
+        out += "msgreader_operation_duration_seconds_bucket{" + label + ",le=\"+Inf\"} "
+            + QByteArray::number(snapshot.count) + '\n';
+        out += "msgreader_operation_duration_seconds_sum{" + label + "} " + number(snapshot.sum / 1e6) + '\n';
+        out += "msgreader_operation_duration_seconds_count{" + label + "} " + QByteArray::number(snapshot.count) + '\n';
+        snapshots.append(snapshot);
+    }
+    
+    // Percentiles from the fine histogram, more precise than histogram_quantile() over the buckets above
+    out += "# HELP msgreader_operation_duration_quantile_seconds Duration percentiles since the session started.\n";
+    out += "# TYPE msgreader_operation_duration_quantile_seconds gauge\n";
+    for (int i = 0; i < OperationCount; ++i) {
+        for (double percentile : kPercentiles) {
+            out += QByteArray("msgreader_operation_duration_quantile_seconds{operation=\"") + operationName(Operation(i))
+                + "\",quantile=\"" + number(percentile / 100) + "\"} "
+                + number(snapshots.at(i).valueAtPercentile(percentile) / 1e6) + '\n';
+        }
+    }
+    
+    out += "# HELP msgreader_operation_bytes_total Bytes read or written by the operations.\n";
+    out += "# TYPE msgreader_operation_bytes_total counter\n";
+    for (int i = 0; i < OperationCount; ++i) {
+        out += QByteArray("msgreader_operation_bytes_total{operation=\"") + operationName(Operation(i)) + "\"} "
+            + QByteArray::number(s_session.operations[i].bytes.loadRelaxed()) + '\n';
+    }
+    
+    out += "# HELP msgreader_uptime_seconds Seconds since the process started.\n";
+    out += "# TYPE msgreader_uptime_seconds gauge\n";
+    out += "msgreader_uptime_seconds " + number(uptimeSeconds()) + '\n';
+    return out;
+}
+
+bool Metrics::writeJson(const QString& path, QString* errorString) {
+    const QByteArray json = toJson();
+    QMutexLocker lock(&s_writeMutex);
+    if (path.isEmpty()) {
+        QFile out;
+        if (!out.open(stderr, QIODevice::WriteOnly) || out.write(json) < 0) {
+            if (errorString) *errorString = out.errorString();
+            return false;
+        }
+        return true;
+    }
+    
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) < 0 || !out.commit()) {
+        if (errorString) *errorString = out.errorString();
+        return false;
+    }
+    return true;
+}
+
+void Metrics::dumpOnSignal(const QString& path) {
+#if defined(Q_OS_UNIX)
+    if (s_signalPipe[0] >= 0 || ::pipe(s_signalPipe) != 0) return;
+    ::fcntl(s_signalPipe[1], F_SETFL, O_NONBLOCK);
+    
+    // Blocks in read() for the rest of the process, so it is never joined
+    QThread* thread = QThread::create([path]() {
+        char byte;
+        while (true) {
+            const ssize_t n = ::read(s_signalPipe[0], &byte, 1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            writeJson(path);
+        }
+    });
+    thread->start();
+    
+    struct sigaction action = {};
+    action.sa_handler = onDumpSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGUSR1, &action, nullptr);
+#else
+    Q_UNUSED(path);
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+/**
+ * Session-wide latency histograms (LatencyHistogram) and byte counters for
+ * opening, parsing, rendering and saving messages.
+ *
+ * Recording is lock-free and may happen on any thread. The totals can be
+ * written as JSON (--metrics-json, on exit and on SIGUSR1) or served in
+ * Prometheus text format from a loopback-only endpoint (MetricsServer).
+ */
+class Metrics {
+public:
+    enum Operation {
+        /** From asking to open a file until its tab is shown. */
+        Open,
+        /** One MsgParser::parse() call, including waiting for the GIL. */
+        Parse,
+        /** Laying out a body in a viewer, or a whole message as PDF. */
+        Render,
+        /** Writing an attachment, archive member or EML file. */
+        Save
+    };
+    static constexpr int OperationCount = Save + 1;
+    
+    /** Records one operation that took elapsedNs nanoseconds and processed bytes. */
+    static void record(Operation operation, qint64 elapsedNs, qint64 bytes = 0);
+    
+    /** Records the time from construction to destruction as one operation. */
+    class Timer {
+    public:
+        explicit Timer(Operation operation);
+        ~Timer();
+        void setBytes(qint64 bytes) { m_bytes = bytes; }
+    
+    private:
+        Operation m_operation;
+        qint64 m_bytes = 0;
+        QElapsedTimer m_timer;
+    };
+    
+    /** Lower-case operation name as used in the JSON and Prometheus output. */
+    static const char* operationName(Operation operation);
+    
+    /** Counts, throughput, percentiles and the non-empty histogram buckets per operation. */
+    static QByteArray toJson();
+    /** Prometheus text exposition format (version 0.0.4). */
+    static QByteArray toPrometheus();
+    /** Writes toJson() to path, or to stderr if path is empty. */
+    static bool writeJson(const QString& path, QString* errorString = nullptr);
+    
+    /**
+     * Makes SIGUSR1 write toJson() to path (stderr if empty) while the process
+     * keeps running. The dump runs on a helper thread, so it also works while
+     * a batch job keeps the main thread busy. No-op on Windows.
+     */
+    static void dumpOnSignal(const QString& path);
+};
+
+#endif
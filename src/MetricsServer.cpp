@@ -0,0 +1,86 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace {
+
+// Anything larger is not a metrics scrape
+constexpr qint64 kMaxRequestBytes = 8192;
+
+QByteArray response(const QByteArray& status, const QByteArray& contentType, const QByteArray& body) {
+    return "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: " + contentType + "\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+}
+
+/** Answers once the request headers are complete (closing with unread input would reset the connection). */
+void onReadyRead(QTcpSocket* socket) {
+    const QByteArray pending = socket->peek(kMaxRequestBytes);
+    const qsizetype headerEnd = pending.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (pending.size() >= kMaxRequestBytes) {
+            socket->abort();
+            socket->deleteLater();
+        }
+        return;
+    }
+    socket->skip(headerEnd + 4);
+    
+    const QList<QByteArray> requestLine = pending.left(pending.indexOf("\r\n")).split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QByteArray target = requestLine.value(1);
+    if (method != "GET") {
+        socket->write(response("405 Method Not Allowed", "text/plain", "Only GET is supported\n"));
+    } else if (target == "/metrics") {
+        socket->write(response("200 OK", "text/plain; version=0.0.4; charset=utf-8", Metrics::toPrometheus()));
+    } else if (target == "/metrics.json") {
+        socket->write(response("200 OK", "application/json", Metrics::toJson()));
+    } else {
+        socket->write(response("404 Not Found", "text/plain", "Try /metrics or /metrics.json\n"));
+    }
+    socket->disconnectFromHost();
+}
+
+}
+
+MetricsServer::MetricsServer() {
+    m_thread.setObjectName("MetricsServer");
+}
+
+MetricsServer::~MetricsServer() {
+    // The server (and its open connections) is deleted on the helper thread when it finishes
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool MetricsServer::start(quint16 port, QString* errorString) {
+    if (m_server) return true;
+    
+    m_server = new QTcpServer;
+    m_server->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, m_server, &QObject::deleteLater);
+    QObject::connect(m_server, &QTcpServer::newConnection, m_server, [server = m_server]() {
+        while (QTcpSocket* socket = server->nextPendingConnection()) {
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket]() { onReadyRead(socket); });
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    });
+    m_thread.start();
+    
+    // Listen on the helper thread, so the socket notifiers belong to its event loop
+    bool listening = false;
+    QMetaObject::invokeMethod(m_server, [this, port, &listening, errorString]() {
+        listening = m_server->listen(QHostAddress::LocalHost, port);
+        if (!listening && errorString) *errorString = m_server->errorString();
+    }, Qt::BlockingQueuedConnection);
+    
+    if (!listening) {
+        m_thread.quit();
+        m_thread.wait();
+        m_server = nullptr;
+    }
+    return listening;
+}
@@ -0,0 +1,32 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QString>
+#include <QThread>
+
+class QTcpServer;
+
+/**
+ * Minimal HTTP endpoint for Metrics on 127.0.0.1 (never other interfaces).
+ * GET /metrics answers in Prometheus text format, GET /metrics.json with
+ * Metrics::toJson(). The server runs its own event loop on a helper thread,
+ * so scrapes are answered while a batch job blocks the main thread.
+ */
+class MetricsServer {
+public:
+    MetricsServer();
+    /** Stops serving. */
+    ~MetricsServer();
+    
+    /** Starts listening on the given loopback port; returns false with errorString set if it cannot. */
+    bool start(quint16 port, QString* errorString);
+    
+private:
+    Q_DISABLE_COPY(MetricsServer)
+    
+    QThread m_thread;
+    /** Lives in m_thread. */
+    QTcpServer* m_server = nullptr;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "MimeEncoding.h"
+#include "CpuFeatures.h"
+#include <cstring>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const char kHexDigits[] = "0123456789ABCDEF";
+
+/**
+ * Scalar base64 encoder, used for CPUs without SSSE3 and for the tail
+ * left over by the vector kernels. Appends '=' padding for the last group.
+ */
+std::size_t base64EncodeScalar(const unsigned char* src, std::size_t len, char* dst) {
+    char* out = dst;
+    std::size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        const unsigned int v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        out[0] = kBase64Alphabet[(v >> 18) & 0x3f];
+        out[1] = kBase64Alphabet[(v >> 12) & 0x3f];
+        out[2] = kBase64Alphabet[(v >> 6) & 0x3f];
+        out[3] = kBase64Alphabet[v & 0x3f];
+        out += 4;
+    }
+    
+    const std::size_t rest = len - i;
+    if (rest == 1) {
+        const unsigned int v = src[i] << 16;
+        out[0] = kBase64Alphabet[(v >> 18) & 0x3f];
+        out[1] = kBase64Alphabet[(v >> 12) & 0x3f];
+        out[2] = '=';
+        out[3] = '=';
+        out += 4;
+    } else if (rest == 2) {
+        const unsigned int v = (src[i] << 16) | (src[i + 1] << 8);
+        out[0] = kBase64Alphabet[(v >> 18) & 0x3f];
+        out[1] = kBase64Alphabet[(v >> 12) & 0x3f];
+        out[2] = kBase64Alphabet[(v >> 6) & 0x3f];
+        out[3] = '=';
+        out += 4;
+    }
+    
+    return out - dst;
+}
+
+#ifdef CPU_FEATURES_X86
+
+/*
+ * Vector kernels after Muła/Lemire, "Faster Base64 Encoding and Decoding
+ * using AVX2 Instructions". Each 32-bit lane receives 3 input bytes, which
+ * are split into four 6-bit indices with two multiplies and then mapped to
+ * ASCII with a single pshufb offset lookup.
+ * The kernels only consume whole vectors and return the number of input
+ * bytes processed; the caller finishes the tail.
+ */
+
+CPU_TARGET("ssse3")
+inline __m128i base64IndicesSsse3(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+CPU_TARGET("ssse3")
+inline __m128i base64LookupSsse3(__m128i indices) {
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i offsetIndex = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    offsetIndex = _mm_or_si128(offsetIndex, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, offsetIndex), indices);
+}
+
+/** Encodes 12 bytes per iteration; reads 16, so needs 4 bytes of slack. */
+CPU_TARGET("ssse3")
+std::size_t base64EncodeSsse3(const unsigned char* src, std::size_t len, char* dst) {
+    std::size_t i = 0;
+    for (; len - i >= 16; i += 12) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i chars = base64LookupSsse3(base64IndicesSsse3(in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), chars);
+        dst += 16;
+    }
+    return i;
+}
+
+/** Encodes 24 bytes per iteration; the upper lane loads at +12, so needs 4 bytes of slack. */
+CPU_TARGET("avx2")
+std::size_t base64EncodeAvx2(const unsigned char* src, std::size_t len, char* dst) {
+    const __m256i shuffle = _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    
+    std::size_t i = 0;
+    for (; len - i >= 28; i += 24) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+        
+        __m256i offsetIndex = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        offsetIndex = _mm256_or_si256(offsetIndex, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        const __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, offsetIndex), indices);
+        
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), chars);
+        dst += 32;
+    }
+    return i;
+}
+
+#endif
+
+enum class Base64Impl { Scalar, Ssse3, Avx2 };
+
+Base64Impl selectBase64Impl() {
+#ifdef CPU_FEATURES_X86
+    if (CpuFeatures::hasAvx2()) return Base64Impl::Avx2;
+    if (CpuFeatures::hasSsse3()) return Base64Impl::Ssse3;
+#endif
+    return Base64Impl::Scalar;
+}
+
+Base64Impl base64Impl() {
+    static const Base64Impl impl = selectBase64Impl();
+    return impl;
+}
+
+/**
+ * Quoted-printable byte classes: literal bytes are printable ASCII except '=',
+ * space and tab are literal unless they end a line, everything else is escaped.
+ */
+enum QpClass : unsigned char { QpEscape = 0, QpLiteral = 1, QpWhitespace = 2 };
+
+struct QpTable {
+    unsigned char cls[256];
+    
+    constexpr QpTable() : cls() {
+        for (int c = 0; c < 256; ++c) {
+            if (c == ' ' || c == '\t') cls[c] = QpWhitespace;
+            else if (c >= 33 && c <= 126 && c != '=') cls[c] = QpLiteral;
+            else cls[c] = QpEscape;
+        }
+    }
+};
+
+constexpr QpTable kQpTable;
+
+// RFC 2045 limits encoded lines to 76 characters; one is reserved for the soft break '='
+constexpr int kQpMaxColumn = 75;
+
+}
+
+namespace MimeEncoding {
+
+std::size_t base64Encode(const char* src, std::size_t len, char* dst) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    std::size_t consumed = 0;
+    char* out = dst;
+
+#ifdef CPU_FEATURES_X86
+    switch (base64Impl()) {
+        case Base64Impl::Avx2:
+            consumed = base64EncodeAvx2(in, len, out);
+            out += consumed / 3 * 4;
+            // AVX2 implies SSSE3; let it take the remaining full vectors
+            [[fallthrough]];
+        case Base64Impl::Ssse3: {
+            const std::size_t n = base64EncodeSsse3(in + consumed, len - consumed, out);
+            consumed += n;
+            out += n / 3 * 4;
+            break;
+        }
+        case Base64Impl::Scalar:
+            break;
+    }
+#endif
+
+    out += base64EncodeScalar(in + consumed, len - consumed, out);
+    return out - dst;
+}
+
+const char* base64Implementation() {
+    switch (base64Impl()) {
+        case Base64Impl::Avx2: return "avx2";
+        case Base64Impl::Ssse3: return "ssse3";
+        case Base64Impl::Scalar: break;
+    }
+    return "scalar";
+}
+
+std::size_t quotedPrintableEncode(const char* src, std::size_t len, const char* limit,
+                                  char* dst, int& column) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* end = p + len;
+    const unsigned char* dataEnd = reinterpret_cast<const unsigned char*>(limit);
+    char* out = dst;
+    
+    while (p < end) {
+        const unsigned char c = *p;
+        
+        // Hard line break: LF or CRLF in the input becomes CRLF
+        if (c == '\n') {
+            *out++ = '\r';
+            *out++ = '\n';
+            column = 0;
+            ++p;
+            continue;
+        }
+        if (c == '\r' && p + 1 < dataEnd && p[1] == '\n') {
+            ++p;
+            continue;
+        }
+        
+        const unsigned char cls = kQpTable.cls[c];
+        
+        // Fast path: copy a run of literal bytes up to the line limit
+        if (cls == QpLiteral) {
+            const unsigned char* run = p + 1;
+            while (run < end && kQpTable.cls[*run] == QpLiteral) ++run;
+            
+            std::size_t n = static_cast<std::size_t>(run - p);
+            if (column >= kQpMaxColumn) {
+                *out++ = '=';
+                *out++ = '\r';
+                *out++ = '\n';
+                column = 0;
+            }
+            if (n > static_cast<std::size_t>(kQpMaxColumn - column)) {
+                n = kQpMaxColumn - column;
+            }
+            std::memcpy(out, p, n);
+            out += n;
+            column += static_cast<int>(n);
+            p += n;
+            continue;
+        }
+        
+        bool escape = (cls == QpEscape);
+        if (cls == QpWhitespace) {
+            // Whitespace before a line break or at the end of data must be encoded
+            const unsigned char* next = p + 1;
+            escape = next >= dataEnd || *next == '\n'
+                || (*next == '\r' && next + 1 < dataEnd && next[1] == '\n');
+        }
+        
+        const int tokenLength = escape ? 3 : 1;
+        if (column + tokenLength > kQpMaxColumn) {
+            *out++ = '=';
+            *out++ = '\r';
+            *out++ = '\n';
+            column = 0;
+        }
+        
+        if (escape) {
+            *out++ = '=';
+            *out++ = kHexDigits[c >> 4];
+            *out++ = kHexDigits[c & 0x0f];
+        } else {
+            *out++ = static_cast<char>(c);
+        }
+        column += tokenLength;
+        ++p;
+    }
+    
+    return out - dst;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef MIMEENCODING_H
+#define MIMEENCODING_H
+
+#include <cstddef>
+
+/**
+ * Content-transfer encoders used by MimeWriter (RFC 2045).
+ * All functions write into caller-provided buffers so the writer can encode
+ * straight into its output chunk without intermediate allocations.
+ */
+namespace MimeEncoding {
+
+/** Number of characters produced by base64Encode() for len input bytes (no line breaks). */
+constexpr std::size_t base64EncodedLength(std::size_t len) {
+    return (len + 2) / 3 * 4;
+}
+
+/**
+ * Encodes len bytes as base64 without line breaks and returns the number of
+ * characters written. Uses AVX2 or SSSE3 when the CPU supports it.
+ */
+std::size_t base64Encode(const char* src, std::size_t len, char* dst);
+
+/** Name of the base64 implementation selected for this CPU ("avx2", "ssse3" or "scalar"). */
+const char* base64Implementation();
+
+/** Upper bound of characters written by quotedPrintableEncode() for len input bytes. */
+constexpr std::size_t quotedPrintableMaxLength(std::size_t len) {
+    // Every byte may become "=XX", plus a soft line break after every 25 escapes
+    return len * 3 + (len / 25 + 1) * 3;
+}
+
+/**
+ * Encodes [src, src + len) as quoted-printable with CRLF hard line breaks
+ * and soft breaks keeping lines within 76 characters.
+ * The input may be a slice of a larger buffer: limit marks the real end of
+ * the data so trailing whitespace and CRLF pairs are detected across slices.
+ * column carries the current output line length between calls.
+ * Returns the number of characters written to dst.
+ */
+std::size_t quotedPrintableEncode(const char* src, std::size_t len, const char* limit,
+                                  char* dst, int& column);
+
+}
+
+#endif
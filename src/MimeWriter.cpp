@@ -0,0 +1,475 @@
+#include "MimeWriter.h"
+#include "MimeEncoding.h"
+#include <QIODevice>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QStringTokenizer>
+#include <QUrl>
+#include <cstring>
+
+namespace {
+
+// RFC 2045: 57 input bytes encode to one 76-character base64 line
+constexpr int kBase64LineInput = 57;
+constexpr int kBase64LineOutput = 76;
+// Whole base64 lines (plus CRLF) that fit in one output chunk
+constexpr int kBase64LinesPerChunk = MimeWriter::ChunkSize / (kBase64LineOutput + 2);
+// Input slice for quoted-printable so the worst case still fits in one chunk
+constexpr int kQpSliceSize = 16 * 1024;
+// RFC 2047: lines holding encoded-words are at most 76 characters; "=?UTF-8?B?" and "?=" take 12
+constexpr int kEncodedLineLength = 76;
+constexpr int kEncodedWordOverhead = 12;
+// RFC 5322: header lines should fold at 78 characters and must not exceed 998
+constexpr int kFoldLineLength = 78;
+constexpr int kMaxLineLength = 998;
+
+static_assert(MimeEncoding::quotedPrintableMaxLength(kQpSliceSize) <= MimeWriter::ChunkSize,
+              "quoted-printable slice must fit in one output chunk");
+
+/** Returns true if the string is printable ASCII and can be written into a header as-is. */
+bool isPlainHeaderText(const QString& text) {
+    for (QChar ch : text) {
+        const char16_t c = ch.unicode();
+        if (c < 0x20 || c > 0x7e) return false;
+    }
+    return true;
+}
+
+/** Replaces line breaks so a value cannot inject extra header lines. */
+QString singleLine(QString text) {
+    text.replace(QLatin1String("\r\n"), QLatin1String(" "));
+    text.replace('\r', ' ');
+    text.replace('\n', ' ');
+    return text;
+}
+
+/**
+ * Folds ASCII header text at spaces so lines stay within 78 characters where
+ * the words allow it. column is where the text starts on the first line.
+ */
+QByteArray foldPlainText(const QByteArray& text, int column) {
+    const QList<QByteArray> words = text.split(' ');
+    QByteArray result;
+    result.reserve(text.size() + text.size() / kFoldLineLength * 2);
+    for (qsizetype i = 0; i < words.size(); ++i) {
+        const QByteArray& word = words.at(i);
+        if (i > 0) {
+            // Never fold before an empty word: a folded line must not be whitespace only
+            if (!word.isEmpty() && column + 1 + word.size() > kFoldLineLength) {
+                result += "\r\n";
+                column = 0;
+            }
+            result += ' ';
+            ++column;
+        }
+        result += word;
+        column += word.size();
+    }
+    return result;
+}
+
+/**
+ * Encodes unstructured header text (RFC 2047). ASCII text is folded at
+ * spaces; anything else (or a word too long for one line) becomes a sequence
+ * of UTF-8 "B" encoded-words, split on character boundaries and folded onto
+ * continuation lines of at most 76 characters. column is where the value
+ * starts on the first line (header name length + 2).
+ */
+QByteArray encodeHeaderText(const QString& text, int column) {
+    const QString value = singleLine(text);
+    if (isPlainHeaderText(value)) {
+        qsizetype longestWord = 0;
+        for (const QStringView word : qTokenize(value, u' ')) {
+            longestWord = qMax(longestWord, word.size());
+        }
+        if (column + longestWord <= kMaxLineLength) {
+            return foldPlainText(value.toLatin1(), column);
+        }
+    }
+    
+    const QByteArray utf8 = value.toUtf8();
+    auto continues = [&utf8](qsizetype i) {
+        return i < utf8.size() && (static_cast<uchar>(utf8[i]) & 0xc0) == 0x80;
+    };
+    QByteArray result;
+    qsizetype pos = 0;
+    while (pos < utf8.size()) {
+        // Whole base64 quanta that fit after the column: 4 characters per 3 bytes
+        const int room = kEncodedLineLength - column - kEncodedWordOverhead;
+        qsizetype len = qMin<qsizetype>(qMax(1, room / 4) * 3, utf8.size() - pos);
+        // Do not split a multi-byte sequence: back off continuation bytes
+        while (len > 0 && continues(pos + len)) {
+            --len;
+        }
+        // Only with almost no room left: take the one character whole
+        if (len == 0) {
+            for (len = 1; continues(pos + len); ++len) {}
+        }
+        
+        if (!result.isEmpty()) result += "\r\n ";
+        result += "=?UTF-8?B?";
+        result += utf8.mid(pos, len).toBase64();
+        result += "?=";
+        pos += len;
+        // Continuation lines start after one space
+        column = 1;
+    }
+    return result;
+}
+
+/** Formats a mailbox as `"Display Name" <user@example.com>`, starting at column. */
+QByteArray formatAddress(const QString& name, const QString& email, int column) {
+    QByteArray result;
+    if (!name.isEmpty() && name != email) {
+        const QString displayName = singleLine(name);
+        if (isPlainHeaderText(displayName)) {
+            QString quoted = displayName;
+            quoted.replace('\\', QLatin1String("\\\\"));
+            quoted.replace('"', QLatin1String("\\\""));
+            result = '"' + quoted.toLatin1() + '"';
+        } else {
+            result = encodeHeaderText(displayName, column);
+        }
+    }
+    if (!email.isEmpty()) {
+        if (!result.isEmpty()) result += ' ';
+        result += '<' + singleLine(email).toUtf8() + '>';
+    }
+    return result;
+}
+
+/**
+ * Splits an address list on ',' or ';' outside quoted strings and angle
+ * brackets, so `"Doe, John" <j@example.com>` stays one entry.
+ */
+QStringList splitAddressList(const QString& list) {
+    QStringList entries;
+    QString current;
+    bool quoted = false;
+    bool angle = false;
+    for (qsizetype i = 0; i < list.size(); ++i) {
+        const QChar c = list.at(i);
+        if (quoted && c == '\\' && i + 1 < list.size()) {
+            current += c;
+            current += list.at(++i);
+            continue;
+        }
+        if (c == '"' && !angle) {
+            quoted = !quoted;
+        } else if (!quoted && c == '<') {
+            angle = true;
+        } else if (!quoted && c == '>') {
+            angle = false;
+        } else if (!quoted && !angle && (c == ',' || c == ';')) {
+            if (!current.trimmed().isEmpty()) entries.append(current.trimmed());
+            current.clear();
+            continue;
+        }
+        current += c;
+    }
+    if (!current.trimmed().isEmpty()) entries.append(current.trimmed());
+    return entries;
+}
+
+/** Removes the quotes and backslash escapes of a quoted-string display name. */
+QString unquotePhrase(const QString& phrase) {
+    if (phrase.size() < 2 || !phrase.startsWith('"') || !phrase.endsWith('"')) return phrase;
+    QString result;
+    for (qsizetype i = 1; i < phrase.size() - 1; ++i) {
+        if (phrase.at(i) == '\\' && i + 1 < phrase.size() - 1) ++i;
+        result += phrase.at(i);
+    }
+    return result;
+}
+
+/**
+ * Formats one address list entry starting at column. Only the display name is encoded;
+ * the addr-spec must stay literal (RFC 2047 section 5 forbids encoded-words in it).
+ */
+QByteArray formatListEntry(const QString& entry, int column) {
+    const qsizetype open = entry.lastIndexOf('<');
+    const qsizetype close = entry.lastIndexOf('>');
+    if (open >= 0 && close > open) {
+        const QString email = entry.mid(open + 1, close - open - 1).trimmed();
+        return formatAddress(unquotePhrase(entry.left(open).trimmed()), email, column);
+    }
+    // A bare addr-spec, or (as Outlook stores some recipients) a display name without one
+    if (!entry.contains(' ') && entry.contains('@')) {
+        return entry.toUtf8();
+    }
+    return formatAddress(unquotePhrase(entry), QString(), column);
+}
+
+/**
+ * Folds an address list so lines stay within 76 characters (the limit for
+ * lines with encoded-words). Entries after the first are encoded as if they
+ * started a continuation line; one that would not fit on the current line
+ * (or spans several) is moved to a new one.
+ */
+QByteArray foldAddressList(const QString& list, int headerNameLength) {
+    const QStringList addresses = splitAddressList(singleLine(list));
+    QByteArray result;
+    int column = headerNameLength + 2;
+    for (const QString& address : addresses) {
+        const QByteArray encoded = formatListEntry(address, result.isEmpty() ? column : 1);
+        if (!result.isEmpty()) {
+            result += ',';
+            ++column;
+            if (column + 1 + encoded.size() > kEncodedLineLength) {
+                result += "\r\n";
+                column = 0;
+            }
+            result += ' ';
+            ++column;
+        }
+        result += encoded;
+        column += encoded.size();
+    }
+    return result;
+}
+
+/**
+ * Formats a Content-Type/Content-Disposition parameter. ASCII values are
+ * quoted; other values use RFC 2231 extended notation.
+ */
+QByteArray formatParameter(const char* name, const QString& value) {
+    const QString text = singleLine(value);
+    if (isPlainHeaderText(text)) {
+        QString quoted = text;
+        quoted.replace('\\', QLatin1String("\\\\"));
+        quoted.replace('"', QLatin1String("\\\""));
+        return QByteArray(name) + "=\"" + quoted.toLatin1() + '"';
+    }
+    return QByteArray(name) + "*=UTF-8''" + QUrl::toPercentEncoding(text);
+}
+
+/** Generates a multipart boundary that cannot occur in base64 or quoted-printable output. */
+QByteArray makeBoundary() {
+    const quint64 random = QRandomGenerator::global()->generate64();
+    return "----=_QtMsgReader_" + QByteArray::number(random, 16);
+}
+
+}
+
+MimeWriter::MimeWriter(QIODevice* device)
+    : m_device(device)
+{
+    m_buffer.resize(ChunkSize);
+}
+
+QString MimeWriter::errorString() const {
+    return m_errorString;
+}
+
+qint64 MimeWriter::bytesWritten() const {
+    return m_bytesWritten;
+}
+
+/**
+ * Writes the message. Structure:
+ * - no attachments: the body (single text part or multipart/alternative)
+ * - attachments: multipart/mixed with the body first, then one base64 part per attachment
+ */
+bool MimeWriter::write(const EmailMessage& msg) {
+    if (!m_device || !m_device->isWritable()) {
+        m_errorString = QStringLiteral("Output device is not writable");
+        return false;
+    }
+    
+    m_used = 0;
+    m_bytesWritten = 0;
+    m_failed = false;
+    m_errorString.clear();
+    
+    writeMessageHeaders(msg);
+    
+    if (msg.attachments.isEmpty()) {
+        writeBody(msg);
+    } else {
+        const QByteArray boundary = makeBoundary();
+        writeHeader("Content-Type", "multipart/mixed; boundary=\"" + boundary + '"');
+        writeRaw("\r\nThis is a multi-part message in MIME format.\r\n");
+        
+        writeRaw("\r\n--" + boundary + "\r\n");
+        writeBody(msg);
+        
+        for (const EmailAttachment& att : msg.attachments) {
+            if (m_failed) break;
+            writeRaw("\r\n--" + boundary + "\r\n");
+            writeAttachmentPart(att);
+        }
+        writeRaw("\r\n--" + boundary + "--\r\n");
+    }
+    
+    flush();
+    return !m_failed;
+}
+
+void MimeWriter::writeMessageHeaders(const EmailMessage& msg) {
+    writeHeader("MIME-Version", "1.0");
+    
+    if (msg.date.isValid()) {
+        writeHeader("Date", msg.date.toString(Qt::RFC2822Date).toLatin1());
+    }
+    
+    const QByteArray from = formatAddress(msg.senderName, msg.senderEmail, int(sizeof("From: ") - 1));
+    if (!from.isEmpty()) {
+        writeHeader("From", from);
+    }
+    if (!msg.toRecipients.isEmpty()) {
+        writeHeader("To", foldAddressList(msg.toRecipients, 2));
+    }
+    if (!msg.ccRecipients.isEmpty()) {
+        writeHeader("Cc", foldAddressList(msg.ccRecipients, 2));
+    }
+    writeHeader("Subject", encodeHeaderText(msg.subject, int(sizeof("Subject: ") - 1)));
+    // Identifiers come from the file too: a line break in one must not start a new header
+    if (!msg.messageId.isEmpty()) {
+        writeHeader("Message-ID", singleLine(msg.messageId).trimmed().toLatin1());
+    }
+    if (!msg.inReplyTo.isEmpty()) {
+        writeHeader("In-Reply-To", singleLine(msg.inReplyTo).trimmed().toLatin1());
+    }
+    if (!msg.references.isEmpty()) {
+        // One identifier per folded line keeps long reference chains within line limits
+        writeHeader("References", singleLine(msg.references).simplified().toLatin1().replace(' ', "\r\n "));
+    }
+}
+
+void MimeWriter::writeBody(const EmailMessage& msg) {
+    const bool hasPlain = !msg.bodyPlainText.isEmpty();
+    const bool hasHtml = !msg.bodyHtml.isEmpty();
+    
+    if (hasPlain && hasHtml) {
+        const QByteArray boundary = makeBoundary();
+        writeHeader("Content-Type", "multipart/alternative; boundary=\"" + boundary + '"');
+        writeRaw("\r\n--" + boundary + "\r\n");
+        writeTextPart("plain", msg.bodyPlainText);
+        writeRaw("\r\n--" + boundary + "\r\n");
+        writeTextPart("html", msg.bodyHtml);
+        writeRaw("\r\n--" + boundary + "--\r\n");
+    } else if (hasHtml) {
+        writeTextPart("html", msg.bodyHtml);
+    } else {
+        writeTextPart("plain", msg.bodyPlainText);
+    }
+}
+
+void MimeWriter::writeTextPart(const char* subtype, const QString& text) {
+    QString body = text;
+    body.remove(QChar('\0'));
+    
+    writeHeader("Content-Type", QByteArray("text/") + subtype + "; charset=UTF-8");
+    writeHeader("Content-Transfer-Encoding", "quoted-printable");
+    writeRaw("\r\n");
+    writeQuotedPrintable(body.toUtf8());
+    writeRaw("\r\n");
+}
+
+void MimeWriter::writeAttachmentPart(const EmailAttachment& att) {
+    QString mimeType = att.mimeType.trimmed();
+    if (!mimeType.contains('/') || !isPlainHeaderText(mimeType)) {
+        mimeType = QStringLiteral("application/octet-stream");
+    }
+    
+    writeHeader("Content-Type", mimeType.toLatin1() + "; " + formatParameter("name", att.filename));
+    writeHeader("Content-Transfer-Encoding", "base64");
+    writeHeader("Content-Disposition", "attachment; " + formatParameter("filename", att.filename));
+    writeRaw("\r\n");
+    writeBase64(att.data);
+}
+
+/**
+ * Encodes data in blocks of whole lines: each block is base64-encoded into
+ * the scratch buffer in one vectorized pass, then copied out line by line
+ * with CRLF separators.
+ */
+void MimeWriter::writeBase64(const QByteArray& data) {
+    constexpr int blockInput = kBase64LinesPerChunk * kBase64LineInput;
+    if (m_scratch.size() < kBase64LinesPerChunk * kBase64LineOutput) {
+        m_scratch.resize(kBase64LinesPerChunk * kBase64LineOutput);
+    }
+    
+    const char* src = data.constData();
+    qsizetype remaining = data.size();
+    while (remaining > 0 && !m_failed) {
+        const qsizetype blockSize = qMin<qsizetype>(blockInput, remaining);
+        const qsizetype encoded = static_cast<qsizetype>(
+            MimeEncoding::base64Encode(src, blockSize, m_scratch.data()));
+        
+        const qsizetype lines = (encoded + kBase64LineOutput - 1) / kBase64LineOutput;
+        char* out = reserve(encoded + lines * 2);
+        const char* in = m_scratch.constData();
+        for (qsizetype pos = 0; pos < encoded; pos += kBase64LineOutput) {
+            const qsizetype len = qMin<qsizetype>(kBase64LineOutput, encoded - pos);
+            std::memcpy(out, in + pos, len);
+            out[len] = '\r';
+            out[len + 1] = '\n';
+            out += len + 2;
+        }
+        m_used += encoded + lines * 2;
+        
+        src += blockSize;
+        remaining -= blockSize;
+    }
+}
+
+void MimeWriter::writeQuotedPrintable(const QByteArray& data) {
+    const char* src = data.constData();
+    const char* end = src + data.size();
+    int column = 0;
+    while (src < end && !m_failed) {
+        const qsizetype sliceSize = qMin<qsizetype>(kQpSliceSize, end - src);
+        char* out = reserve(MimeEncoding::quotedPrintableMaxLength(sliceSize));
+        m_used += static_cast<qsizetype>(
+            MimeEncoding::quotedPrintableEncode(src, sliceSize, end, out, column));
+        src += sliceSize;
+    }
+}
+
+void MimeWriter::writeHeader(const char* name, const QByteArray& value) {
+    writeRaw(name, static_cast<qsizetype>(std::strlen(name)));
+    writeRaw(": ", 2);
+    writeRaw(value);
+    writeRaw("\r\n", 2);
+}
+
+void MimeWriter::writeRaw(const QByteArray& data) {
+    writeRaw(data.constData(), data.size());
+}
+
+void MimeWriter::writeRaw(const char* data, qsizetype size) {
+    while (size > 0 && !m_failed) {
+        const qsizetype len = qMin<qsizetype>(size, ChunkSize);
+        std::memcpy(reserve(len), data, len);
+        m_used += len;
+        data += len;
+        size -= len;
+    }
+}
+
+char* MimeWriter::reserve(qsizetype size) {
+    Q_ASSERT(size <= ChunkSize);
+    if (m_used + size > m_buffer.size()) {
+        flush();
+    }
+    return m_buffer.data() + m_used;
+}
+
+void MimeWriter::flush() {
+    if (m_used == 0) return;
+    
+    if (!m_failed) {
+        const qint64 written = m_device->write(m_buffer.constData(), m_used);
+        if (written != m_used) {
+            m_failed = true;
+            m_errorString = m_device->errorString();
+            if (m_errorString.isEmpty()) {
+                m_errorString = QStringLiteral("Short write to output device");
+            }
+        } else {
+            m_bytesWritten += written;
+        }
+    }
+    m_used = 0;
+}
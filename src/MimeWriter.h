@@ -0,0 +1,61 @@
+#ifndef MIMEWRITER_H
+#define MIMEWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include "EmailTypes.h"
+
+class QIODevice;
+
+/**
+ * Streams an EmailMessage as an RFC 5322 / RFC 2045 message (.eml).
+ * Output is assembled in a fixed-size buffer and handed to the device chunk
+ * by chunk, so memory use does not depend on attachment sizes.
+ */
+class MimeWriter {
+public:
+    /** Size of the chunks written to the device. */
+    static constexpr int ChunkSize = 64 * 1024;
+    
+    explicit MimeWriter(QIODevice* device);
+    
+    /** Writes the complete message; returns false and sets errorString() on failure. */
+    bool write(const EmailMessage& msg);
+    /** Describes the last write error. */
+    QString errorString() const;
+    /** Number of bytes handed to the device so far. */
+    qint64 bytesWritten() const;
+
+private:
+    /** Writes the top-level RFC 5322 header block. */
+    void writeMessageHeaders(const EmailMessage& msg);
+    /** Writes the body as text/plain, text/html or multipart/alternative. */
+    void writeBody(const EmailMessage& msg);
+    /** Writes a single text part encoded as quoted-printable. */
+    void writeTextPart(const char* subtype, const QString& text);
+    /** Writes an attachment part encoded as base64. */
+    void writeAttachmentPart(const EmailAttachment& att);
+    /** Appends data encoded as base64 in 76-character lines. */
+    void writeBase64(const QByteArray& data);
+    /** Appends data encoded as quoted-printable. */
+    void writeQuotedPrintable(const QByteArray& data);
+    /** Appends a "Name: value" header line. */
+    void writeHeader(const char* name, const QByteArray& value);
+    /** Appends raw bytes to the output buffer. */
+    void writeRaw(const QByteArray& data);
+    void writeRaw(const char* data, qsizetype size);
+    /** Returns a pointer to at least size free bytes in the buffer, flushing if needed. */
+    char* reserve(qsizetype size);
+    /** Hands the buffered bytes to the device. */
+    void flush();
+    
+    QIODevice* m_device;
+    QByteArray m_buffer;
+    QByteArray m_scratch;
+    qsizetype m_used = 0;
+    qint64 m_bytesWritten = 0;
+    bool m_failed = false;
+    QString m_errorString;
+};
+
+#endif
@@ -1,4 +1,8 @@
 #include "MsgFileModel.h"
+#include <QApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QPalette>
 
 MsgFileModel::MsgFileModel(QObject* parent)
     : QFileSystemModel(parent)
@@ -8,5 +12,43 @@ MsgFileModel::MsgFileModel(QObject* parent)
 }
 
 QVariant MsgFileModel::data(const QModelIndex& index, int role) const {
+    if (index.column() == 0 && !m_duplicates.isEmpty()
+        && (role == Qt::ToolTipRole || role == Qt::ForegroundRole)) {
+        const QString path = filePath(index);
+        auto it = m_duplicates.constFind(path);
+        if (it != m_duplicates.constEnd()) {
+            const bool isFirst = it->firstCopy == path;
+            if (role == Qt::ForegroundRole) {
+                if (!isFirst) {
+                    return QApplication::palette().brush(QPalette::Disabled, QPalette::Text);
+                }
+            } else if (isFirst) {
+                return tr("%1 copies (%2)").arg(it->copies).arg(DuplicateFinder::matchName(it->match));
+            } else {
+                return tr("Duplicate of %1 (%2)")
+                    .arg(QDir::toNativeSeparators(it->firstCopy), DuplicateFinder::matchName(it->match));
+            }
+        }
+    }
     return QFileSystemModel::data(index, role);
 }
+
+void MsgFileModel::setDuplicateGroups(const QList<DuplicateFinder::Group>& groups) {
+    m_duplicates.clear();
+    
+    for (const auto& group : groups) {
+        DuplicateMark mark{group.members.first().filePath, static_cast<int>(group.members.size()), group.match};
+        for (const auto& member : group.members) {
+            m_duplicates.insert(member.filePath, mark);
+        }
+    }
+}
+
+QStringList MsgFileModel::findMessageFiles(const QString& directory) {
+    QStringList files;
+    QDirIterator it(directory, QStringList() << "*.msg", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        files.append(it.next());
+    }
+    return files;
+}
@@ -2,10 +2,14 @@
 #define MSGFILEMODEL_H
 
 #include <QFileSystemModel>
+#include <QHash>
+#include "DuplicateFinder.h"
 
 /**
  * File system model filtered to show only MSG files.
  * Used by the file browser tree view to navigate to MSG files.
+ * Files found by a duplicate scan are marked: extra copies are greyed out
+ * and the tooltip names the group they belong to.
  */
 class MsgFileModel : public QFileSystemModel {
     Q_OBJECT
@@ -15,8 +19,27 @@ public:
     
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
     
+    /**
+     * Marks the members of the given duplicate groups, replacing earlier marks.
+     * No change signals are emitted (looking up every path would make the model
+     * load every scanned directory); views show the marks on their next repaint.
+     */
+    void setDuplicateGroups(const QList<DuplicateFinder::Group>& groups);
+    
+    /** Lists the .msg files below a directory (recursively); safe to call from worker threads. */
+    static QStringList findMessageFiles(const QString& directory);
+    
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const;
+    
+private:
+    struct DuplicateMark {
+        QString firstCopy;
+        int copies;
+        DuplicateFinder::Match match;
+    };
+    
+    QHash<QString, DuplicateMark> m_duplicates;
 };
 
 #endif
@@ -3,24 +3,163 @@
 #undef QT_NO_KEYWORDS
 
 #include "MsgParser.h"
+#include "CodepageDecoder.h"
+#include "MapiProperties.h"
+#include "Metrics.h"
 #include <QDebug>
 #include <QDir>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QRegularExpression>
 #include <QCoreApplication>
+#include <QFileInfo>
+#include <QMutex>
+#include <QtEndian>
 
 // Static members for Python state (shared across all MsgParser instances)
+ParseLimits MsgParser::s_defaultLimits;
 bool MsgParser::s_pythonInitialized = false;
 bool MsgParser::s_moduleLoaded = false;
 void* MsgParser::s_msgModule = nullptr;
 
-MsgParser::MsgParser() {
+namespace {
+
+// "__properties_version1.0" streams: a header (32 bytes at the top level,
+// 8 in attachment storages), then 16-byte entries
+constexpr int kPropertyStreamHeaderSize = 32;
+constexpr int kAttachmentPropertyHeaderSize = 8;
+constexpr int kPropertyEntrySize = 16;
+// Top-level header fields: next attachment ID and attachment count
+constexpr int kNextAttachmentIdOffset = 12;
+constexpr int kAttachmentCountOffset = 20;
+
+/**
+ * Reads a raw stream from the MSG compound file.
+ * extract_msg exposes this as getStream() (older releases: _getStream());
+ * both return None when the stream does not exist, which maps to a null QByteArray.
+ */
+QByteArray readStream(PyObject* msgObj, const char* streamName) {
+    const char* method = PyObject_HasAttrString(msgObj, "getStream") ? "getStream" : "_getStream";
+    
+    PyObject* streamObj = PyObject_CallMethod(msgObj, method, "s", streamName);
+    if (!streamObj) {
+        PyErr_Clear();
+        return QByteArray();
+    }
+    
+    QByteArray result;
+    char* buffer;
+    Py_ssize_t size;
+    if (PyBytes_Check(streamObj) && PyBytes_AsStringAndSize(streamObj, &buffer, &size) == 0) {
+        result = size > 0 ? QByteArray(buffer, size) : QByteArray("");
+    }
+    PyErr_Clear();
+    Py_DECREF(streamObj);
+    return result;
+}
+
+/**
+ * Property source for the Mapi:: registry accessors (see MapiProperties.h),
+ * backed by extract_msg's stream access. Reads the top-level message, or the
+ * storage given by prefix (e.g. "__attach_version1.0_#00000000/") with its
+ * property stream header size. Caller must hold the GIL.
+ */
+class MsgPropertySource {
+public:
+    explicit MsgPropertySource(PyObject* msgObj, const QByteArray& prefix = QByteArray(),
+                               int headerSize = kPropertyStreamHeaderSize)
+        : m_msgObj(msgObj)
+        , m_prefix(prefix)
+        , m_headerSize(headerSize)
+        , m_propertyStream(stream("__properties_version1.0"))
+    {
+    }
+    
+    /** False if the storage has no property stream (e.g. it does not exist). */
+    bool isValid() const {
+        return !m_propertyStream.isNull();
+    }
+    
+    QByteArray stream(const char* name) const {
+        if (m_prefix.isEmpty()) return readStream(m_msgObj, name);
+        return readStream(m_msgObj, (m_prefix + name).constData());
+    }
+    
+    /** A 32-bit field of the property stream header, or 0. */
+    quint32 headerValue(int offset) const {
+        if (offset + 4 > qMin<qsizetype>(m_headerSize, m_propertyStream.size())) return 0;
+        return qFromLittleEndian<quint32>(m_propertyStream.constData() + offset);
+    }
+    
+    /** Looks up a fixed-size value; entries are tag (4 bytes LE), flags (4), value (8). */
+    bool fixedValue(quint32 tag, quint64& value) const {
+        const uchar* data = reinterpret_cast<const uchar*>(m_propertyStream.constData());
+        for (qsizetype pos = m_headerSize; pos + kPropertyEntrySize <= m_propertyStream.size();
+             pos += kPropertyEntrySize) {
+            if (qFromLittleEndian<quint32>(data + pos) == tag) {
+                value = qFromLittleEndian<quint64>(data + pos + 8);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    int codepage() const { return m_codepage; }
+    void setCodepage(int codepage) { m_codepage = codepage; }
+    
+private:
+    PyObject* m_msgObj;
+    QByteArray m_prefix;
+    int m_headerSize;
+    QByteArray m_propertyStream;
+    int m_codepage = CodepageDecoder::CodepageWindows1252;
+};
+
+}
+
+MsgParser::MsgParser()
+    : m_limits(defaultLimits())
+{
     initPython();
 }
 
 MsgParser::~MsgParser() {
 }
 
+void MsgParser::setOptions(const ParseOptions& options) {
+    m_options = options;
+}
+
+void MsgParser::setLimits(const ParseLimits& limits) {
+    m_limits = limits;
+}
+
+ParseLimits MsgParser::defaultLimits() {
+    return s_defaultLimits;
+}
+
+void MsgParser::setDefaultLimits(const ParseLimits& limits) {
+    s_defaultLimits = limits;
+}
+
+qint64 MsgParser::lastParseTimeNs() const {
+    return m_lastParseNs;
+}
+
+QList<ParseBackend> MsgParser::availableBackends() {
+    return {ParseBackend::MapiStreams, ParseBackend::ExtractMsg};
+}
+
+QString MsgParser::backendName(ParseBackend backend) {
+    switch (backend) {
+        case ParseBackend::MapiStreams:
+            return QStringLiteral("mapi");
+        case ParseBackend::ExtractMsg:
+            return QStringLiteral("extract_msg");
+    }
+    return QString();
+}
+
 /**
  * Finds the Python packages directory.
  * Priority:
@@ -54,8 +193,13 @@ QString MsgParser::findSitePackages() {
 /**
  * Initializes the Python interpreter and loads the extract_msg module.
  * Uses simple Py_InitializeEx(0) to avoid config issues, then adds site-packages to sys.path.
+ * The initializing thread releases the GIL afterwards, so every parse (from any
+ * thread) and the parse watchdog acquire it through PyGILState_Ensure().
  */
 bool MsgParser::initPython() {
+    static QMutex initMutex;
+    QMutexLocker locker(&initMutex);
+    
     if (s_pythonInitialized) {
         return s_moduleLoaded;
     }
@@ -74,8 +218,11 @@ bool MsgParser::initPython() {
             return false;
         }
         s_pythonInitialized = true;
+        PyEval_SaveThread();
     }
     
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    
     // Add site-packages to Python path
     PyObject* sysModule = PyImport_ImportModule("sys");
     if (sysModule) {
@@ -96,16 +243,19 @@ bool MsgParser::initPython() {
             PyErr_Print();
         }
         qWarning() << "Failed to import extract_msg module from path:" << sitePackages;
+        PyGILState_Release(gstate);
         return false;
     }
     
     s_msgModule = msgModule;
     s_moduleLoaded = true;
+    PyGILState_Release(gstate);
     return true;
 }
 
 /**
- * Converts a Python object to QString using PyObject_Str and UTF-8 encoding.
+ * Converts a Python object to QString: PyObject_Str, then a copy from the
+ * string's Latin-1, UCS-2 or UCS-4 buffer (PyUnicode_KIND), without UTF-8.
  * Returns empty QString if object is None or conversion fails.
  */
 QString MsgParser::pyObjectToString(void* obj) {
@@ -118,9 +268,21 @@ QString MsgParser::pyObjectToString(void* obj) {
         return QString();
     }
     
-    Py_ssize_t size;
-    const char* str = PyUnicode_AsUTF8AndSize(strObj, &size);
-    QString result = QString::fromUtf8(str, size);
+    // Copy straight from the string's internal representation instead of
+    // round-tripping through UTF-8
+    QString result;
+    Py_ssize_t length = PyUnicode_GET_LENGTH(strObj);
+    switch (PyUnicode_KIND(strObj)) {
+        case PyUnicode_1BYTE_KIND:
+            result = QString::fromLatin1(reinterpret_cast<const char*>(PyUnicode_1BYTE_DATA(strObj)), length);
+            break;
+        case PyUnicode_2BYTE_KIND:
+            result = QString(reinterpret_cast<const QChar*>(PyUnicode_2BYTE_DATA(strObj)), length);
+            break;
+        default:
+            result = QString::fromUcs4(reinterpret_cast<const char32_t*>(PyUnicode_4BYTE_DATA(strObj)), length);
+            break;
+    }
     Py_DECREF(strObj);
     
     return result;
@@ -200,92 +362,184 @@ QDateTime MsgParser::pyObjectToDateTime(void* obj) {
  */
 EmailMessage MsgParser::parse(const QString& filePath) {
     EmailMessage msg;
+    m_lastParseNs = 0;
+    // Wall time as the caller sees it, waiting for the GIL included
+    Metrics::Timer metricsTimer(Metrics::Parse);
     
     if (!s_moduleLoaded) {
         msg.errorMessage = "Python extract_msg module not loaded";
         return msg;
     }
     
+    // A file larger than the memory budget cannot be parsed within it
+    qint64 fileSize = QFileInfo(filePath).size();
+    metricsTimer.setBytes(fileSize);
+    if (m_limits.maxMemoryBytes > 0 && fileSize > m_limits.maxMemoryBytes) {
+        msg.errorMessage = QString("File size (%1 MiB) exceeds memory limit of %2 MiB")
+            .arg(fileSize / (1024 * 1024)).arg(m_limits.maxMemoryBytes / (1024 * 1024));
+        return msg;
+    }
+    
+    // Every return path below disarms it while the GIL is still held
+    ParseWatchdog watchdog(m_limits);
+    
     // Acquire GIL for thread safety
     PyGILState_STATE gstate = PyGILState_Ensure();
+    // The GIL is handed to other parsing threads every switch interval, so
+    // wall time from here would include their work; CPU time of this thread does not
+    const qint64 cpuStartNs = ParseWatchdog::currentThreadCpuTimeNs();
+    QElapsedTimer gilTimer;
+    gilTimer.start();
+    auto parseTimeNs = [&]() {
+        const qint64 cpuNs = ParseWatchdog::currentThreadCpuTimeNs();
+        return cpuStartNs >= 0 && cpuNs >= 0 ? cpuNs - cpuStartNs : gilTimer.nsecsElapsed();
+    };
+    watchdog.arm();
     
     // Get Message class from extract_msg module
     PyObject* openFunc = PyObject_GetAttrString(static_cast<PyObject*>(s_msgModule), "Message");
     if (!openFunc) {
         PyErr_Print();
         msg.errorMessage = "Failed to get Message class from extract_msg";
+        watchdog.disarm();
+        m_lastParseNs = parseTimeNs();
         PyGILState_Release(gstate);
         return msg;
     }
     
-    // Create Message object from file path
+    // Create Message object from file path. Unless attachments are loaded
+    // through extract_msg, delay them: its constructor would otherwise read
+    // every attachment, payload included
     PyObject* filePathPy = PyUnicode_FromString(filePath.toUtf8().constData());
     PyObject* args = PyTuple_Pack(1, filePathPy);
+    PyObject* kwargs = nullptr;
+    if (!m_options.attachments || !m_options.attachmentData) {
+        kwargs = Py_BuildValue("{s:O}", "delayAttachments", Py_True);
+    }
     
-    PyObject* msgObj = PyObject_CallObject(openFunc, args);
+    PyObject* msgObj = PyObject_Call(openFunc, args, kwargs);
+    Py_XDECREF(kwargs);
     Py_DECREF(args);
     Py_DECREF(filePathPy);
     Py_DECREF(openFunc);
     
     if (!msgObj) {
-        PyErr_Print();
-        msg.errorMessage = "Failed to open MSG file: " + filePath;
+        watchdog.disarm();
+        if (watchdog.reason() != ParseWatchdog::Reason::None) {
+            PyErr_Clear();
+            msg.errorMessage = watchdog.errorMessage();
+        } else {
+            PyErr_Print();
+            msg.errorMessage = "Failed to open MSG file: " + filePath;
+        }
+        m_lastParseNs = parseTimeNs();
         PyGILState_Release(gstate);
         return msg;
     }
     
     msg.isValid = true;
     
-    // Extract subject
-    PyObject* subjectObj = PyObject_GetAttrString(msgObj, "subject");
-    msg.subject = pyObjectToString(subjectObj);
-    Py_XDECREF(subjectObj);
-    
-    // Extract plain text body
-    PyObject* bodyObj = PyObject_GetAttrString(msgObj, "body");
-    msg.bodyPlainText = pyObjectToString(bodyObj);
-    Py_XDECREF(bodyObj);
-    
-    // Extract HTML body (returned as bytes)
-    PyObject* htmlBodyObj = PyObject_GetAttrString(msgObj, "htmlBody");
-    if (htmlBodyObj && htmlBodyObj != Py_None) {
-        QByteArray htmlBytes = pyObjectToBytes(htmlBodyObj);
-        if (!htmlBytes.isEmpty()) {
-            msg.bodyHtml = QString::fromUtf8(htmlBytes);
-        }
+    // Top-level properties come from the raw MAPI streams through the
+    // compile-time registry (MapiProperties.h); extract_msg attributes are
+    // the fallback for anything the registry does not find. The ExtractMsg
+    // backend skips the registry (Message-ID and thread headers stay empty).
+    MsgPropertySource source(msgObj);
+    
+    // Codepages for non-Unicode (PT_STRING8) properties and the HTML body
+    qint32 messageCodepage = 0;
+    qint32 internetCodepage = 0;
+    Mapi::readProperty<Mapi::Tags::MessageCodepage>(source, messageCodepage);
+    Mapi::readProperty<Mapi::Tags::InternetCodepage>(source, internetCodepage);
+    int stringCodepage = messageCodepage ? messageCodepage : internetCodepage;
+    if (!CodepageDecoder::isSupported(stringCodepage)) {
+        stringCodepage = CodepageDecoder::CodepageWindows1252;
     }
-    Py_XDECREF(htmlBodyObj);
-    PyErr_Clear();
+    source.setCodepage(stringCodepage);
     
-    // Extract sender info (sender is string like "Name <email@example.com>")
-    PyObject* senderObj = PyObject_GetAttrString(msgObj, "sender");
-    msg.senderName = pyObjectToString(senderObj);
-    Py_XDECREF(senderObj);
-    PyErr_Clear();
+    const bool useStreams = m_options.backend == ParseBackend::MapiStreams;
+    if (useStreams) {
+        Mapi::HeaderFields::read(source, msg);
+    }
+    if (useStreams && m_options.plainTextBody) {
+        Mapi::BodyFields::read(source, msg);
+    }
+    
+    // Fallback: subject and plain text body through extract_msg
+    if (msg.subject.isEmpty()) {
+        PyObject* subjectObj = PyObject_GetAttrString(msgObj, "subject");
+        msg.subject = pyObjectToString(subjectObj);
+        Py_XDECREF(subjectObj);
+        PyErr_Clear();
+    }
     
-    // Parse email from sender string using regex
-    if (!msg.senderName.isEmpty()) {
-        QRegularExpression emailRe(R"((?:<|^)([a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,})(?:>|$))");
-        QRegularExpressionMatch match = emailRe.match(msg.senderName);
-        if (match.hasMatch()) {
-            msg.senderEmail = match.captured(1);
-            QString name = msg.senderName;
-            name.remove(QRegularExpression(R"(\s*<[^>]+>\s*)"));
-            name = name.trimmed();
-            if (!name.isEmpty()) {
+    if (m_options.plainTextBody && msg.bodyPlainText.isEmpty()) {
+        PyObject* bodyObj = PyObject_GetAttrString(msgObj, "body");
+        msg.bodyPlainText = pyObjectToString(bodyObj);
+        Py_XDECREF(bodyObj);
+        PyErr_Clear();
+    }
+    
+    // Extract HTML body: PR_HTML, or extract_msg's htmlBody which also
+    // de-encapsulates HTML from compressed RTF. Charset from <meta>, then PR_INTERNET_CPID
+    QByteArray htmlBytes;
+    if (m_options.htmlBody
+        && (!useStreams || !Mapi::readProperty<Mapi::Tags::Html>(source, htmlBytes) || htmlBytes.isEmpty())) {
+        PyObject* htmlBodyObj = PyObject_GetAttrString(msgObj, "htmlBody");
+        if (htmlBodyObj && htmlBodyObj != Py_None) {
+            htmlBytes = pyObjectToBytes(htmlBodyObj);
+        }
+        Py_XDECREF(htmlBodyObj);
+        PyErr_Clear();
+    }
+    if (!htmlBytes.isEmpty()) {
+        int htmlCodepage = CodepageDecoder::codepageFromHtml(htmlBytes);
+        if (htmlCodepage == 0) htmlCodepage = internetCodepage;
+        if (htmlCodepage == 0) htmlCodepage = CodepageDecoder::CodepageUtf8;
+        msg.bodyHtml = CodepageDecoder::decode(htmlBytes, htmlCodepage);
+    }
+    
+    // Fallback for missing sender fields: msg.sender is a string like "Name <email@example.com>"
+    if (msg.senderName.isEmpty() || msg.senderEmail.isEmpty()) {
+        PyObject* senderObj = PyObject_GetAttrString(msgObj, "sender");
+        QString sender = pyObjectToString(senderObj);
+        Py_XDECREF(senderObj);
+        PyErr_Clear();
+        
+        // Parse email from sender string using regex
+        if (!sender.isEmpty()) {
+            QString name = sender;
+            QRegularExpression emailRe(R"((?:<|^)([a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,})(?:>|$))");
+            QRegularExpressionMatch match = emailRe.match(sender);
+            if (match.hasMatch()) {
+                if (msg.senderEmail.isEmpty()) {
+                    msg.senderEmail = match.captured(1);
+                }
+                name.remove(QRegularExpression(R"(\s*<[^>]+>\s*)"));
+                name = name.trimmed();
+                if (name.isEmpty()) {
+                    name = sender;
+                }
+            }
+            if (msg.senderName.isEmpty()) {
                 msg.senderName = name;
             }
         }
     }
     
-    // Extract date
-    PyObject* dateObj = PyObject_GetAttrString(msgObj, "date");
-    msg.date = pyObjectToDateTime(dateObj);
-    Py_XDECREF(dateObj);
+    // Fallback: date through extract_msg
+    if (!msg.date.isValid()) {
+        PyObject* dateObj = PyObject_GetAttrString(msgObj, "date");
+        msg.date = pyObjectToDateTime(dateObj);
+        Py_XDECREF(dateObj);
+        PyErr_Clear();
+    }
     
     // Extract recipients from msg.recipients list
     // recipient.type: 1=TO, 2=CC
-    PyObject* recipientsObj = PyObject_GetAttrString(msgObj, "recipients");
+    PyObject* recipientsObj = nullptr;
+    if (m_options.recipients) {
+        recipientsObj = PyObject_GetAttrString(msgObj, "recipients");
+    }
     if (recipientsObj && PyList_Check(recipientsObj)) {
         Py_ssize_t len = PyList_Size(recipientsObj);
         for (Py_ssize_t i = 0; i < len; ++i) {
@@ -319,7 +573,7 @@ EmailMessage MsgParser::parse(const QString& filePath) {
     PyErr_Clear();
     
     // Fallback: use msg.to and msg.cc strings directly if recipients list is empty
-    if (msg.toRecipients.isEmpty()) {
+    if (m_options.recipients && msg.toRecipients.isEmpty()) {
         PyObject* toObj = PyObject_GetAttrString(msgObj, "to");
         if (toObj && toObj != Py_None) {
             QString toStr = pyObjectToString(toObj);
@@ -330,7 +584,7 @@ EmailMessage MsgParser::parse(const QString& filePath) {
         PyErr_Clear();
     }
     
-    if (msg.ccRecipients.isEmpty()) {
+    if (m_options.recipients && msg.ccRecipients.isEmpty()) {
         PyObject* ccObj = PyObject_GetAttrString(msgObj, "cc");
         if (ccObj && ccObj != Py_None) {
             QString ccStr = pyObjectToString(ccObj);
@@ -341,11 +595,42 @@ EmailMessage MsgParser::parse(const QString& filePath) {
         PyErr_Clear();
     }
     
+    // Attachment list without payloads: names, types and sizes from each
+    // attachment storage's properties; the data streams are never opened.
+    // Storage IDs below the next ID can have gaps where attachments were deleted
+    if (m_options.attachments && !m_options.attachmentData) {
+        const quint32 nextId = source.headerValue(kNextAttachmentIdOffset);
+        const quint32 count = source.headerValue(kAttachmentCountOffset);
+        for (quint32 id = 0; id < nextId && quint32(msg.attachments.size()) < count; ++id) {
+            if (watchdog.reason() != ParseWatchdog::Reason::None) break;
+            
+            const QByteArray prefix = "__attach_version1.0_#"
+                + QByteArray::number(id, 16).rightJustified(8, '0').toUpper() + '/';
+            MsgPropertySource attachmentSource(msgObj, prefix, kAttachmentPropertyHeaderSize);
+            if (!attachmentSource.isValid()) continue;
+            attachmentSource.setCodepage(stringCodepage);
+            
+            EmailAttachment att;
+            Mapi::AttachmentFields::read(attachmentSource, att);
+            Mapi::readPropertySize<Mapi::AttachmentTags::DataBinary>(attachmentSource, att.size);
+            if (att.filename.isEmpty()) {
+                att.filename = QString("attachment_%1").arg(msg.attachments.size() + 1);
+            }
+            msg.attachments.append(att);
+        }
+    }
+    
     // Extract attachments (list of Attachment objects)
-    PyObject* attachmentsObj = PyObject_GetAttrString(msgObj, "attachments");
+    qint64 attachmentBytes = 0;
+    PyObject* attachmentsObj = nullptr;
+    if (m_options.attachments && m_options.attachmentData && watchdog.reason() == ParseWatchdog::Reason::None) {
+        attachmentsObj = PyObject_GetAttrString(msgObj, "attachments");
+    }
     if (attachmentsObj && PyList_Check(attachmentsObj)) {
         Py_ssize_t len = PyList_Size(attachmentsObj);
         for (Py_ssize_t i = 0; i < len; ++i) {
+            if (watchdog.reason() != ParseWatchdog::Reason::None) break;
+            
             PyObject* value = PyList_GetItem(attachmentsObj, i);
             EmailAttachment att;
             
@@ -396,12 +681,26 @@ EmailMessage MsgParser::parse(const QString& filePath) {
                 PyErr_Clear();
             }
             
+            // Attachment payloads are copied out of Python, so they count twice
+            attachmentBytes += att.data.size();
+            if (m_limits.maxMemoryBytes > 0 && attachmentBytes * 2 > m_limits.maxMemoryBytes) {
+                watchdog.tripMemoryLimit();
+                break;
+            }
+            
             msg.attachments.append(att);
         }
     }
     Py_XDECREF(attachmentsObj);
     PyErr_Clear();
     
+    // Stop watching before cleanup; an aborted parse returns only the error
+    watchdog.disarm();
+    if (watchdog.reason() != ParseWatchdog::Reason::None) {
+        msg = EmailMessage();
+        msg.errorMessage = watchdog.errorMessage();
+    }
+    
     // Close the MSG file to release resources
     PyObject* closeMethod = PyObject_GetAttrString(msgObj, "close");
     if (closeMethod && PyCallable_Check(closeMethod)) {
@@ -410,6 +709,7 @@ EmailMessage MsgParser::parse(const QString& filePath) {
     Py_XDECREF(closeMethod);
     
     Py_DECREF(msgObj);
+    m_lastParseNs = parseTimeNs();
     PyGILState_Release(gstate);
     
     return msg;
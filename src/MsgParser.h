@@ -1,7 +1,61 @@
 #ifndef MSGPARSER_H
 #define MSGPARSER_H
 
+#include <QList>
 #include "EmailTypes.h"
+#include "ParseWatchdog.h"
+
+/** Where parse() reads top-level message properties from. */
+enum class ParseBackend {
+    /** Raw MAPI property streams via the MapiProperties.h registry, extract_msg attributes as fallback. */
+    MapiStreams,
+    /** extract_msg's Message attributes only (the original parser). */
+    ExtractMsg
+};
+
+/**
+ * Selects which parts of a message parse() extracts. Skipping bodies,
+ * recipients and attachments avoids the most expensive extract_msg calls
+ * when only headers are needed (e.g. bulk scans); without attachment
+ * payloads, extract_msg is told to delay loading attachments altogether.
+ */
+struct ParseOptions {
+    bool plainTextBody = true;
+    bool recipients = true;
+    bool htmlBody = true;
+    bool attachments = true;
+    /**
+     * Copy attachment payloads. When false only name, type and size are filled
+     * in, from each attachment's property stream (both backends); payload
+     * streams are never read.
+     */
+    bool attachmentData = true;
+    ParseBackend backend = ParseBackend::MapiStreams;
+    
+    /** Subject, sender, date, Message-ID and plain text body only. */
+    static ParseOptions headersAndBody() {
+        ParseOptions options;
+        options.recipients = false;
+        options.htmlBody = false;
+        options.attachments = false;
+        return options;
+    }
+    
+    /** Subject, sender, date and message/thread identifiers only. */
+    static ParseOptions headersOnly() {
+        ParseOptions options = headersAndBody();
+        options.plainTextBody = false;
+        return options;
+    }
+    
+    /** Headers plus the attachment list (names, types, sizes) without payloads. */
+    static ParseOptions headersAndAttachmentList() {
+        ParseOptions options = headersOnly();
+        options.attachments = true;
+        options.attachmentData = false;
+        return options;
+    }
+};
 
 /**
  * Parser for Microsoft Outlook MSG files using Python's extract_msg library.
@@ -15,6 +69,27 @@ public:
     /** Parses an MSG file and returns the email message data. */
     EmailMessage parse(const QString& filePath);
     
+    /**
+     * CPU time the calling thread spent in the last parse() after taking the
+     * GIL, i.e. its own cost: while other threads hold the GIL this one is
+     * idle. Wall time on platforms without per-thread CPU clocks.
+     */
+    qint64 lastParseTimeNs() const;
+    
+    /** Sets which parts of the message parse() extracts (default: everything). */
+    void setOptions(const ParseOptions& options);
+    
+    /** Sets the time and memory limits for parses by this instance. */
+    void setLimits(const ParseLimits& limits);
+    /** Limits applied to newly created parsers. */
+    static ParseLimits defaultLimits();
+    static void setDefaultLimits(const ParseLimits& limits);
+    
+    /** All backends, the default first. */
+    static QList<ParseBackend> availableBackends();
+    /** Short name of a backend ("mapi", "extract_msg"). */
+    static QString backendName(ParseBackend backend);
+    
 private:
     /** Finds the Python site-packages directory (bundled or venv). */
     QString findSitePackages();
@@ -27,6 +102,11 @@ private:
     /** Converts a Python datetime object to QDateTime. */
     QDateTime pyObjectToDateTime(void* obj);
     
+    ParseOptions m_options;
+    ParseLimits m_limits;
+    qint64 m_lastParseNs = 0;
+    
+    static ParseLimits s_defaultLimits;
     static bool s_pythonInitialized;
     static bool s_moduleLoaded;
     static void* s_msgModule;
@@ -0,0 +1,207 @@
+#include "OpenFileCache.h"
+#include "Metrics.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const QString kDirPrefix = QStringLiteral("qt-msg-reader-open-");
+const QString kLockName = QStringLiteral(".lock");
+
+/**
+ * True if path is a real directory that belongs to the current user and that
+ * nobody else can enter. Always true where ownership is not known (Windows,
+ * whose temp directories are per user).
+ */
+bool isPrivateDirectory(const QString& path) {
+#ifdef Q_OS_UNIX
+    const QFileInfo info(path);
+    const QFileDevice::Permissions others = QFileDevice::ReadGroup | QFileDevice::WriteGroup | QFileDevice::ExeGroup
+        | QFileDevice::ReadOther | QFileDevice::WriteOther | QFileDevice::ExeOther;
+    return info.isDir() && !info.isSymLink() && info.ownerId() == ::getuid() && !(info.permissions() & others);
+#else
+    return QFileInfo(path).isDir();
+#endif
+}
+
+/** Removes our directories of earlier processes whose lock file has no live owner any more. */
+void removeStaleDirectories(const QString& parent) {
+    const QDir dir(parent);
+    for (const QString& name : dir.entryList({kDirPrefix + "*"}, QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks)) {
+        const QString path = dir.filePath(name);
+        // Never touch another user's directory
+        if (!isPrivateDirectory(path)) continue;
+        // No lock file yet: the owner may be just setting up
+        if (!QFile::exists(path + "/" + kLockName)) continue;
+        QLockFile lock(path + "/" + kLockName);
+        lock.setStaleLockTime(0);
+        // Succeeds only if the process holding the lock is gone
+        if (lock.tryLock(0)) {
+            lock.unlock();
+            QDir(path).removeRecursively();
+        }
+    }
+}
+
+/** The attachment's file name without path parts or characters file systems reject. */
+QString safeFileName(const QString& fileName) {
+    static const QString forbidden = QStringLiteral("\\/:*?\"<>|");
+    QString name = QFileInfo(fileName).fileName();
+    for (QChar& c : name) {
+        if (c.unicode() < 0x20 || forbidden.contains(c)) c = '_';
+    }
+    name = name.trimmed();
+    if (name.isEmpty() || name == "." || name == "..") name = QStringLiteral("attachment");
+    return name;
+}
+
+}
+
+OpenFileCache::OpenFileCache(int maxEntries)
+    : m_maxEntries(qMax(1, maxEntries))
+{
+}
+
+OpenFileCache::~OpenFileCache() {
+    // Applications may still have files open; on Unix they keep their copy, on Windows those files stay behind
+    delete m_runtimeLock;
+    delete m_diskLock;
+    if (!m_runtimeDir.isEmpty()) QDir(m_runtimeDir).removeRecursively();
+    if (!m_diskDir.isEmpty()) QDir(m_diskDir).removeRecursively();
+}
+
+QByteArray OpenFileCache::keyFor(const QString& sourcePath, int index, qint64 size) {
+    const QFileInfo info(sourcePath);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '/');
+    hash.addData(QByteArray::number(index) + '/');
+    hash.addData(QByteArray::number(size));
+    return hash.result().toHex().left(16);
+}
+
+bool OpenFileCache::isExecutableType(const QString& fileName) {
+    // Windows, macOS and Linux desktop launchers, scripts and installers
+    static const QSet<QString> suffixes = {
+        "exe", "com", "bat", "cmd", "msi", "msp", "scr", "pif", "cpl", "hta", "reg", "lnk", "url",
+        "js", "jse", "vbs", "vbe", "wsf", "wsh", "ps1", "psm1", "msc", "jar", "appref-ms",
+        "app", "command", "tool", "pkg", "dmg",
+        "desktop", "sh", "bash", "run", "bin", "appimage", "py", "pl", "rb"
+    };
+    return suffixes.contains(QFileInfo(fileName.trimmed()).suffix().toLower());
+}
+
+QString OpenFileCache::lookup(const QByteArray& key) {
+    QMutexLocker lock(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return QString();
+    if (!QFileInfo::exists(it->path)) {
+        // Deleted behind our back (e.g. a temp cleaner)
+        m_entries.erase(it);
+        return QString();
+    }
+    it->lastUsed = ++m_useCounter;
+    return it->path;
+}
+
+OpenFileCache::Result OpenFileCache::store(const QByteArray& key, const QString& fileName, const QByteArray& data) {
+    Metrics::Timer metricsTimer(Metrics::Save);
+    metricsTimer.setBytes(data.size());
+    Result result;
+    
+    QString root;
+    {
+        QMutexLocker lock(&m_mutex);
+        root = directory(data.size() > RuntimeDirLimit);
+    }
+    const QString keyDir = root + "/" + QString::fromLatin1(key);
+    if (root.isEmpty() || !QDir().mkpath(keyDir)) {
+        result.errorString = QString("Cannot create a temporary directory");
+        return result;
+    }
+    
+    // An earlier copy is read-only, which would make replacing it fail on Windows
+    const QString path = keyDir + "/" + safeFileName(fileName);
+    if (QFile::exists(path)) {
+        QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        QFile::remove(path);
+    }
+    
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        result.errorString = file.errorString();
+        return result;
+    }
+    // Edits made in the external application would be lost with the cache; make that obvious
+    QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::ReadUser);
+    
+    {
+        QMutexLocker lock(&m_mutex);
+        m_entries.insert(key, Entry{path, ++m_useCounter});
+        evict();
+    }
+    result.path = path;
+    result.ok = true;
+    return result;
+}
+
+QString OpenFileCache::directory(bool large) {
+    QString& dir = large ? m_diskDir : m_runtimeDir;
+    if (!dir.isEmpty()) return dir;
+    
+    auto parentFor = [](bool largePayloads) {
+        const QString parent = QStandardPaths::writableLocation(largePayloads ? QStandardPaths::TempLocation
+                                                                              : QStandardPaths::RuntimeLocation);
+        return parent.isEmpty() ? QDir::tempPath() : parent;
+    };
+    const QString parent = parentFor(large);
+    
+    // Both locations can be the same directory (e.g. without XDG_RUNTIME_DIR)
+    const QString& other = large ? m_runtimeDir : m_diskDir;
+    if (!other.isEmpty() && parentFor(!large) == parent) {
+        dir = other;
+        return dir;
+    }
+    
+    removeStaleDirectories(parent);
+    // A random name created with mkdtemp (0700): other users can neither predict nor pre-create it
+    QTemporaryDir temporary(parent + "/" + kDirPrefix + "XXXXXX");
+    if (!temporary.isValid() || !isPrivateDirectory(temporary.path())) return QString();
+    temporary.setAutoRemove(false);
+    const QString path = temporary.path();
+    
+    QLockFile* lock = new QLockFile(path + "/" + kLockName);
+    lock->setStaleLockTime(0);
+    lock->tryLock(0);
+    if (large) {
+        m_diskLock = lock;
+    } else {
+        m_runtimeLock = lock;
+    }
+    dir = path;
+    return dir;
+}
+
+void OpenFileCache::evict() {
+    while (m_entries.size() > m_maxEntries) {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->lastUsed < oldest->lastUsed) oldest = it;
+        }
+        // On Unix an application that still has the file open keeps reading it
+        QDir(QFileInfo(oldest->path).absolutePath()).removeRecursively();
+        m_entries.erase(oldest);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef OPENFILECACHE_H
+#define OPENFILECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QLockFile>
+#include <QMutex>
+#include <QString>
+
+/**
+ * Temporary files that attachments are handed to external applications in
+ * ("Open" on an attachment).
+ *
+ * Payloads up to RuntimeDirLimit are written to a per-process directory in
+ * the runtime location (XDG_RUNTIME_DIR, a tmpfs on Linux); larger ones go to
+ * the disk temp directory so a big attachment is not held in RAM twice. The
+ * directories get unpredictable names (QTemporaryDir, mode 0700 on Unix) and
+ * are only used if they belong to the current user.
+ * Files are read-only and keep the attachment's file name. The last
+ * maxEntries files stay cached under a key of message file, modification
+ * time and attachment, so opening an attachment again neither reloads nor
+ * rewrites it. The directories are removed on destruction; directories left
+ * behind by a crashed process are removed by the next one.
+ *
+ * lookup() and store() are thread-safe; store() is meant for a worker thread.
+ */
+class OpenFileCache {
+public:
+    static constexpr int DefaultMaxEntries = 16;
+    static constexpr qint64 RuntimeDirLimit = 64LL * 1024 * 1024;
+    
+    struct Result {
+        QString path;
+        bool ok = false;
+        QString errorString;
+    };
+    
+    explicit OpenFileCache(int maxEntries = DefaultMaxEntries);
+    ~OpenFileCache();
+    
+    /** Cache key of attachment index (of size bytes) in the message file sourcePath. */
+    static QByteArray keyFor(const QString& sourcePath, int index, qint64 size);
+    /** True if fileName has an extension that desktop environments run as a program or script. */
+    static bool isExecutableType(const QString& fileName);
+    
+    /** Cached file for key, or an empty string; counts as a use. */
+    QString lookup(const QByteArray& key);
+    /** Writes data to a read-only file named after fileName and caches it under key. */
+    Result store(const QByteArray& key, const QString& fileName, const QByteArray& data);
+    
+private:
+    Q_DISABLE_COPY(OpenFileCache)
+    
+    struct Entry {
+        QString path;
+        quint64 lastUsed = 0;
+    };
+    
+    /** Creates (once) and returns this process's directory for large or small payloads, or an empty string. */
+    QString directory(bool large);
+    /** Drops least recently used entries beyond m_maxEntries; called with m_mutex held. */
+    void evict();
+    
+    const int m_maxEntries;
+    QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries;
+    quint64 m_useCounter = 0;
+    QString m_runtimeDir;
+    QString m_diskDir;
+    QLockFile* m_runtimeLock = nullptr;
+    QLockFile* m_diskLock = nullptr;
+};
+
+#endif
@@ -0,0 +1,281 @@
+#define QT_NO_KEYWORDS
+#include <Python.h>
+#undef QT_NO_KEYWORDS
+
+#include "ParseWatchdog.h"
+#include <QThread>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <utility>
+
+#if defined(Q_OS_WIN)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#include <pthread.h>
+#elif defined(Q_OS_UNIX)
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How often the monitor thread checks the armed parses
+constexpr int kPollIntervalMs = 50;
+
+/**
+ * Handle that lets another thread read the calling thread's CPU time:
+ * its CPU-time clock id (POSIX), Mach thread port (macOS) or a thread handle (Windows).
+ */
+quintptr currentThreadClock() {
+#if defined(Q_OS_WIN)
+    return reinterpret_cast<quintptr>(OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId()));
+#elif defined(Q_OS_MACOS)
+    return pthread_mach_thread_np(pthread_self());
+#elif defined(Q_OS_UNIX)
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) return 0;
+    return static_cast<quintptr>(clock);
+#else
+    return 0;
+#endif
+}
+
+void releaseThreadClock(quintptr clock) {
+#if defined(Q_OS_WIN)
+    if (clock) CloseHandle(reinterpret_cast<HANDLE>(clock));
+#else
+    Q_UNUSED(clock);
+#endif
+}
+
+/** CPU time (user + system) of the thread behind clock in nanoseconds, or -1. */
+qint64 threadCpuTimeNs(quintptr clock) {
+#if defined(Q_OS_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!clock || !GetThreadTimes(reinterpret_cast<HANDLE>(clock), &creation, &exit, &kernel, &user)) return -1;
+    const quint64 ticks = (quint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime)
+        + (quint64(user.dwHighDateTime) << 32 | user.dwLowDateTime);
+    return static_cast<qint64>(ticks * 100);
+#elif defined(Q_OS_MACOS)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(static_cast<mach_port_t>(clock), THREAD_BASIC_INFO,
+                    reinterpret_cast<thread_info_t>(&info), &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    return (qint64(info.user_time.seconds) + info.system_time.seconds) * 1000000000
+        + (qint64(info.user_time.microseconds) + info.system_time.microseconds) * 1000;
+#elif defined(Q_OS_UNIX)
+    timespec ts;
+    if (clock_gettime(static_cast<clockid_t>(clock), &ts) != 0) return -1;
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    Q_UNUSED(clock);
+    return -1;
+#endif
+}
+
+}
+
+/**
+ * The one helper thread that watches every armed parse. It is started on
+ * first use and lives until the process exits.
+ *
+ * Lock order: the GIL before m_mutex. arm()/disarm() hold the GIL when they
+ * take m_mutex; the monitor only requests the GIL with m_mutex released.
+ */
+class ParseWatchdogMonitor {
+public:
+    static ParseWatchdogMonitor* instance() {
+        // Deliberately leaked: parses may run until the very end of the process
+        static ParseWatchdogMonitor* monitor = new ParseWatchdogMonitor;
+        return monitor;
+    }
+    
+    void add(ParseWatchdog* watchdog) {
+        QMutexLocker lock(&m_mutex);
+        m_armed.append(watchdog);
+        watchdog->m_armed = true;
+        m_wake.wakeAll();
+    }
+    
+    /** Returns false if the watchdog was not armed. */
+    bool remove(ParseWatchdog* watchdog) {
+        QMutexLocker lock(&m_mutex);
+        if (!watchdog->m_armed) return false;
+        watchdog->m_armed = false;
+        m_armed.removeOne(watchdog);
+        // Alone again: memory growth counts from now, not from when other parses were running
+        if (m_armed.size() == 1) {
+            m_armed.first()->m_baselineMemory = ParseWatchdog::residentMemoryBytes();
+        }
+        return true;
+    }
+    
+private:
+    ParseWatchdogMonitor() {
+        m_thread = QThread::create([this]() { run(); });
+        m_thread->setObjectName("ParseWatchdog");
+        m_thread->start();
+    }
+    
+    void run() {
+        QMutexLocker lock(&m_mutex);
+        for (;;) {
+            if (m_armed.isEmpty()) {
+                m_wake.wait(&m_mutex);
+                continue;
+            }
+            m_wake.wait(&m_mutex, kPollIntervalMs);
+            
+            // Resident memory is process-wide: with several parses running it cannot be attributed
+            const bool checkMemory = m_armed.size() == 1;
+            const qint64 memory = checkMemory ? ParseWatchdog::residentMemoryBytes() : 0;
+            bool exceeded = false;
+            for (ParseWatchdog* watchdog : std::as_const(m_armed)) {
+                const ParseLimits& limits = watchdog->m_limits;
+                if (limits.timeoutMs > 0 && watchdog->elapsedNs() > qint64(limits.timeoutMs) * 1000000) {
+                    watchdog->m_reason.testAndSetRelaxed(int(ParseWatchdog::Reason::None),
+                                                         int(ParseWatchdog::Reason::Timeout));
+                }
+                if (checkMemory && limits.maxMemoryBytes > 0 && watchdog->m_baselineMemory > 0
+                    && memory - watchdog->m_baselineMemory > limits.maxMemoryBytes) {
+                    watchdog->m_reason.testAndSetRelaxed(int(ParseWatchdog::Reason::None),
+                                                         int(ParseWatchdog::Reason::MemoryLimit));
+                }
+                exceeded = exceeded || watchdog->reason() != ParseWatchdog::Reason::None;
+            }
+            
+            if (exceeded) {
+                lock.unlock();
+                PyGILState_STATE gstate = PyGILState_Ensure();
+                lock.relock();
+                // Parses disarmed meanwhile are no longer in the list
+                for (ParseWatchdog* watchdog : std::as_const(m_armed)) {
+                    const ParseWatchdog::Reason reason = watchdog->reason();
+                    if (reason == ParseWatchdog::Reason::None) continue;
+                    PyObject* exception = reason == ParseWatchdog::Reason::MemoryLimit
+                        ? PyExc_MemoryError : PyExc_TimeoutError;
+                    PyThreadState_SetAsyncExc(watchdog->m_pythonThreadId, exception);
+                }
+                lock.unlock();
+                PyGILState_Release(gstate);
+                lock.relock();
+            }
+        }
+    }
+    
+    QThread* m_thread = nullptr;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QList<ParseWatchdog*> m_armed;
+};
+
+ParseWatchdog::ParseWatchdog(const ParseLimits& limits)
+    : m_limits(limits)
+{
+}
+
+ParseWatchdog::~ParseWatchdog() {
+    disarm();
+}
+
+void ParseWatchdog::arm() {
+    if (m_limits.timeoutMs <= 0 && m_limits.maxMemoryBytes <= 0) return;
+    
+    m_pythonThreadId = PyThread_get_thread_ident();
+    m_baselineMemory = residentMemoryBytes();
+    m_threadClock = currentThreadClock();
+    m_cpuStartNs = threadCpuTimeNs(m_threadClock);
+    m_wallTimer.start();
+    ParseWatchdogMonitor::instance()->add(this);
+}
+
+void ParseWatchdog::disarm() {
+    // m_armed only changes on the parsing thread, so this needs no lock
+    if (!m_armed || !ParseWatchdogMonitor::instance()->remove(this)) return;
+    
+    // Drop an exception that was raised but not yet delivered
+    PyThreadState_SetAsyncExc(m_pythonThreadId, nullptr);
+    releaseThreadClock(m_threadClock);
+    m_threadClock = 0;
+}
+
+void ParseWatchdog::tripMemoryLimit() {
+    m_reason.testAndSetRelaxed(int(Reason::None), int(Reason::MemoryLimit));
+}
+
+ParseWatchdog::Reason ParseWatchdog::reason() const {
+    return static_cast<Reason>(m_reason.loadRelaxed());
+}
+
+QString ParseWatchdog::errorMessage() const {
+    switch (reason()) {
+        case Reason::Timeout:
+            return QString("Parse aborted: exceeded time limit of %1 s")
+                .arg(m_limits.timeoutMs / 1000.0);
+        case Reason::MemoryLimit:
+            return QString("Parse aborted: exceeded memory limit of %1 MiB")
+                .arg(m_limits.maxMemoryBytes / (1024 * 1024));
+        case Reason::None:
+            break;
+    }
+    return QString();
+}
+
+qint64 ParseWatchdog::elapsedNs() const {
+    if (m_cpuStartNs >= 0) {
+        const qint64 now = threadCpuTimeNs(m_threadClock);
+        if (now >= 0) return now - m_cpuStartNs;
+    }
+    return m_wallTimer.nsecsElapsed();
+}
+
+qint64 ParseWatchdog::currentThreadCpuTimeNs() {
+#if defined(Q_OS_WIN)
+    return threadCpuTimeNs(reinterpret_cast<quintptr>(GetCurrentThread()));
+#elif defined(Q_OS_MACOS)
+    // pthread_mach_thread_np() does not add a port reference, unlike mach_thread_self()
+    return threadCpuTimeNs(pthread_mach_thread_np(pthread_self()));
+#elif defined(Q_OS_UNIX)
+    return threadCpuTimeNs(static_cast<quintptr>(CLOCK_THREAD_CPUTIME_ID));
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Reads the resident set size: /proc/self/statm on Linux,
+ * task_info on macOS, GetProcessMemoryInfo on Windows.
+ */
+qint64 ParseWatchdog::residentMemoryBytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.WorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return static_cast<qint64>(info.resident_size);
+    }
+    return 0;
+#elif defined(Q_OS_LINUX)
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) return 0;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) return 0;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,81 @@
+#ifndef PARSEWATCHDOG_H
+#define PARSEWATCHDOG_H
+
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QString>
+
+/**
+ * Per-parse resource limits. A value of 0 disables the corresponding limit.
+ */
+struct ParseLimits {
+    /**
+     * CPU time budget for one parse, in milliseconds. Only the parsing thread's
+     * own CPU time counts, so waiting for the GIL while other threads parse does not.
+     */
+    int timeoutMs = 30000;
+    /**
+     * Growth of the process resident memory allowed during one parse, in bytes.
+     * Resident memory is process-wide, so it is only checked while a single
+     * parse is running; concurrent parses (batch scans) are not limited by it.
+     */
+    qint64 maxMemoryBytes = qint64(1024) * 1024 * 1024;
+};
+
+/**
+ * Guards one parse against its time and memory budget. While armed, the parse
+ * is registered with a single process-wide monitor thread that polls all armed
+ * parses and aborts one that exceeds its budget by raising an exception in its
+ * Python thread (PyThreadState_SetAsyncExc). The exception is re-raised on
+ * every check until the parse is disarmed, so a parser that swallows one error
+ * still gets stopped at its next Python call.
+ *
+ * arm() and disarm() must be called with the GIL held, on the parsing thread.
+ */
+class ParseWatchdog {
+public:
+    enum class Reason {
+        None,
+        Timeout,
+        MemoryLimit
+    };
+    
+    explicit ParseWatchdog(const ParseLimits& limits);
+    /** Disarms if still armed (the GIL must be held then). */
+    ~ParseWatchdog();
+    
+    /** Starts watching the calling Python thread. */
+    void arm();
+    /** Stops watching and clears any exception not yet delivered. */
+    void disarm();
+    /** Marks the parse as aborted for exceeding the memory limit (for C++-side allocations). */
+    void tripMemoryLimit();
+    /** Returns why the parse was aborted, or Reason::None. */
+    Reason reason() const;
+    /** Human-readable description of the abort reason. */
+    QString errorMessage() const;
+    
+    /** Current resident set size of the process in bytes, or 0 if unknown on this platform. */
+    static qint64 residentMemoryBytes();
+    /** CPU time used so far by the calling thread in nanoseconds, or -1 if unknown on this platform. */
+    static qint64 currentThreadCpuTimeNs();
+    
+private:
+    Q_DISABLE_COPY(ParseWatchdog)
+    friend class ParseWatchdogMonitor;
+    
+    /** CPU time (wall time where unavailable) of the parsing thread since arm(). */
+    qint64 elapsedNs() const;
+    
+    ParseLimits m_limits;
+    // Set by arm(); read by the monitor thread with its mutex held
+    quintptr m_threadClock = 0;
+    qint64 m_cpuStartNs = -1;
+    QElapsedTimer m_wallTimer;
+    qint64 m_baselineMemory = 0;
+    unsigned long m_pythonThreadId = 0;
+    bool m_armed = false;
+    QAtomicInt m_reason;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "PdfExporter.h"
+#include "Metrics.h"
+#include "MsgParser.h"
+#include "ThumbnailCache.h"
+#include <QAbstractTextDocumentLayout>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QLocale>
+#include <QPageLayout>
+#include <QPageSize>
+#include <QPdfWriter>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QUrl>
+
+namespace {
+
+QString tr(const char* text) {
+    return QCoreApplication::translate("PdfExporter", text);
+}
+
+/** Fonts and style sheet shared by all documents; built on first use. */
+struct Style {
+    QFont bodyFont;
+    QString styleSheet;
+};
+
+const Style& style() {
+    static const Style shared = [] {
+        Style s;
+        s.bodyFont.setPointSizeF(10);
+        s.styleSheet = QStringLiteral(
+            "h1 { font-size: 14pt; margin-bottom: 6px; }"
+            "td.label { font-weight: bold; color: #555555; padding-right: 12px; }"
+            "h2 { font-size: 11pt; margin-top: 12px; }");
+        return s;
+    }();
+    return shared;
+}
+
+/** Subject, sender, recipients and date as an HTML block, matching the on-screen header. */
+QString headerHtml(const EmailMessage& msg) {
+    QString from;
+    if (!msg.senderName.isEmpty() && !msg.senderEmail.isEmpty()) {
+        from = QString("%1 <%2>").arg(msg.senderName, msg.senderEmail);
+    } else if (!msg.senderName.isEmpty()) {
+        from = msg.senderName;
+    } else if (!msg.senderEmail.isEmpty()) {
+        from = msg.senderEmail;
+    } else {
+        from = tr("(unknown sender)");
+    }
+    
+    auto row = [](const QString& label, const QString& value) {
+        return QString("<tr><td class=\"label\">%1</td><td>%2</td></tr>")
+            .arg(label.toHtmlEscaped(), value.toHtmlEscaped());
+    };
+    
+    QString html = QString("<h1>%1</h1><table>")
+        .arg((msg.subject.isEmpty() ? tr("(no subject)") : msg.subject).toHtmlEscaped());
+    html += row(tr("From:"), from);
+    html += row(tr("To:"), msg.toRecipients.isEmpty() ? tr("(no recipients)") : msg.toRecipients);
+    if (!msg.ccRecipients.isEmpty()) html += row(tr("CC:"), msg.ccRecipients);
+    html += row(tr("Date:"), msg.date.isValid() ? msg.date.toLocalTime().toString(Qt::ISODate) : tr("(unknown date)"));
+    html += "</table><hr/>";
+    return html;
+}
+
+QString attachmentListHtml(const EmailMessage& msg) {
+    const QLocale locale;
+    QString html = QString("<h2>%1</h2><ul>").arg(tr("Attachments (%1)").arg(msg.attachments.size()));
+    for (const EmailAttachment& att : msg.attachments) {
+        html += QString("<li>%1 (%2)</li>")
+            .arg(att.filename.toHtmlEscaped(), locale.formattedDataSize(att.size));
+    }
+    html += "</ul>";
+    return html;
+}
+
+/**
+ * Makes inline images ("cid:image001.png@01DA...") resolvable: Outlook names the
+ * content id after the attachment file name. Images wider than the page are
+ * scaled down to fit, since QTextDocument does not shrink them itself.
+ */
+void addInlineImages(QTextDocument* doc, const EmailMessage& msg, qreal pageWidth) {
+    static const QRegularExpression cidPattern(QStringLiteral("cid:([^\"'\\s>)]+)"),
+                                               QRegularExpression::CaseInsensitiveOption);
+    
+    QHash<QString, int> byName;
+    for (int i = 0; i < msg.attachments.size(); ++i) {
+        const EmailAttachment& att = msg.attachments.at(i);
+        if (!att.data.isEmpty() && ThumbnailCache::isImage(att.filename, att.mimeType)) {
+            byName.insert(att.filename.toLower(), i);
+        }
+    }
+    if (byName.isEmpty()) return;
+    
+    QSet<QString> added;
+    QRegularExpressionMatchIterator it = cidPattern.globalMatch(msg.bodyHtml);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        const QString cid = match.captured(1);
+        if (added.contains(cid)) continue;
+        added.insert(cid);
+        
+        const int row = byName.value(cid.section('@', 0, 0).toLower(), -1);
+        if (row < 0) continue;
+        
+        QImage image = QImage::fromData(msg.attachments.at(row).data);
+        if (image.isNull()) continue;
+        if (image.width() > pageWidth) {
+            image = image.scaledToWidth(int(pageWidth), Qt::SmoothTransformation);
+        }
+        doc->addResource(QTextDocument::ImageResource, QUrl(match.captured(0)), image);
+    }
+}
+
+}
+
+bool PdfExporter::write(const EmailMessage& msg, const QString& pdfPath, int* pageCount, QString* errorString) {
+    Metrics::Timer metricsTimer(Metrics::Render);
+    QSaveFile file(pdfPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+    
+    QPdfWriter writer(&file);
+    writer.setResolution(Resolution);
+    writer.setPageSize(QPageSize(QPageSize::A4));
+    writer.setPageMargins(QMarginsF(15, 15, 15, 15), QPageLayout::Millimeter);
+    writer.setTitle(msg.subject);
+    writer.setCreator(QCoreApplication::applicationName());
+    
+    // Laid out for the writer itself and paginated to its paint rect, so print() draws 1:1
+    const Style& shared = style();
+    QTextDocument doc;
+    doc.setUndoRedoEnabled(false);
+    doc.setDefaultFont(shared.bodyFont);
+    doc.setDefaultStyleSheet(shared.styleSheet);
+    doc.documentLayout()->setPaintDevice(&writer);
+    const QSizeF pageSize = writer.pageLayout().paintRectPixels(Resolution).size();
+    doc.setPageSize(pageSize);
+    
+    QTextCursor cursor(&doc);
+    cursor.insertHtml(headerHtml(msg));
+    cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+    
+    QString body = msg.bodyHtml.isEmpty() ? msg.bodyPlainText : msg.bodyHtml;
+    body.remove('\0');
+    if (!msg.bodyHtml.isEmpty()) {
+        // Image sizes are in 96 dpi units (scaled to the device by the layout)
+        addInlineImages(&doc, msg, pageSize.width() * 96.0 / Resolution);
+        cursor.insertHtml(body);
+    } else {
+        cursor.insertText(body.isEmpty() ? tr("(no message body)") : body);
+    }
+    
+    if (!msg.attachments.isEmpty()) {
+        cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+        cursor.insertHtml(attachmentListHtml(msg));
+    }
+    
+    doc.print(&writer);
+    if (pageCount) *pageCount = doc.pageCount();
+    metricsTimer.setBytes(file.size());
+    
+    if (!file.commit()) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+PdfExporter::Result PdfExporter::exportFile(const Job& job) {
+    Result result;
+    result.sourcePath = job.sourcePath;
+    result.pdfPath = job.pdfPath;
+    
+    QElapsedTimer timer;
+    timer.start();
+    MsgParser parser;
+    const EmailMessage msg = parser.parse(job.sourcePath);
+    result.parseMs = timer.restart();
+    if (!msg.isValid) {
+        result.errorString = msg.errorMessage;
+        return result;
+    }
+    
+    result.ok = write(msg, job.pdfPath, &result.pageCount, &result.errorString);
+    result.renderMs = timer.elapsed();
+    return result;
+}
+
+QList<PdfExporter::Job> PdfExporter::plan(const QStringList& files, const QString& outputDirectory) {
+    const QDir dir(outputDirectory);
+    QList<Job> jobs;
+    jobs.reserve(files.size());
+    QSet<QString> used;
+    for (const QString& filePath : files) {
+        const QString base = QFileInfo(filePath).completeBaseName();
+        QString name = base + ".pdf";
+        for (int n = 2; used.contains(name.toLower()); ++n) {
+            name = QString("%1-%2.pdf").arg(base).arg(n);
+        }
+        used.insert(name.toLower());
+        jobs.append(Job{filePath, dir.filePath(name)});
+    }
+    return jobs;
+}
@@ -0,0 +1,56 @@
+#ifndef PDFEXPORTER_H
+#define PDFEXPORTER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "EmailTypes.h"
+
+/**
+ * Renders messages to PDF without any widget: header block, body and
+ * attachment list are laid out in a QTextDocument whose layout targets the
+ * QPdfWriter directly, so text is placed at the writer's resolution.
+ *
+ * All functions are safe to call from worker threads. Fonts and the style
+ * sheet are built once and shared by every document; Qt caches resolved
+ * fonts per thread, so pool threads rendering many messages reuse them.
+ */
+class PdfExporter {
+public:
+    /** Resolution of the generated PDFs. */
+    static constexpr int Resolution = 300;
+    
+    /** One file of a batch export. */
+    struct Job {
+        QString sourcePath;
+        QString pdfPath;
+    };
+    
+    struct Result {
+        QString sourcePath;
+        QString pdfPath;
+        bool ok = false;
+        QString errorString;
+        int pageCount = 0;
+        qint64 parseMs = 0;
+        qint64 renderMs = 0;
+    };
+    
+    /**
+     * Writes msg to pdfPath. The file is replaced only once the PDF is
+     * complete. Returns false (with errorString set) on failure.
+     */
+    static bool write(const EmailMessage& msg, const QString& pdfPath,
+                      int* pageCount = nullptr, QString* errorString = nullptr);
+    
+    /** Parses job.sourcePath and writes it to job.pdfPath; the worker function of batch exports. */
+    static Result exportFile(const Job& job);
+    
+    /**
+     * Output paths for files in outputDirectory: "<name>.pdf", with "-2", "-3", ...
+     * appended when several inputs share a name.
+     */
+    static QList<Job> plan(const QStringList& files, const QString& outputDirectory);
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "TextSearch.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXT_SEARCH_SSE2 1
+#endif
+
+namespace {
+
+// Positions scanned (or hits re-checked) between two looks at the cancel flag
+constexpr qsizetype kCancelCheckInterval = 1 << 16;
+
+inline char16_t foldChar(char16_t c) {
+    if (c < 0x80) return c >= 'A' && c <= 'Z' ? char16_t(c | 0x20) : c;
+    // Surrogate halves are kept: folding them as a pair could change the length
+    if (QChar::isSurrogate(c)) return c;
+    const char32_t folded = QChar::toCaseFolded(char32_t(c));
+    return folded <= 0xFFFF ? char16_t(folded) : c;
+}
+
+inline bool isCanceled(const QAtomicInt* cancel) {
+    return cancel && cancel->loadRelaxed();
+}
+
+/** Compares the needle's inner code units; first and last have been checked already. */
+inline bool innerMatches(const char16_t* text, const char16_t* needle, qsizetype size) {
+    return size <= 2 || std::memcmp(text + 1, needle + 1, (size - 2) * sizeof(char16_t)) == 0;
+}
+
+/** Appends a hit; returns false once MaxHits is reached. */
+inline bool addHit(TextSearch::Result& result, qsizetype pos) {
+    if (result.hits.size() == TextSearch::MaxHits) {
+        result.truncated = true;
+        return false;
+    }
+    result.hits.append(int(pos));
+    return true;
+}
+
+}
+
+namespace TextSearch {
+
+QString fold(QStringView text) {
+    const qsizetype size = text.size();
+    QString folded(size, Qt::Uninitialized);
+    const char16_t* src = text.utf16();
+    char16_t* dst = reinterpret_cast<char16_t*>(folded.data());
+    qsizetype i = 0;
+#ifdef TEXT_SEARCH_SSE2
+    const __m128i nonAscii = _mm_set1_epi16(short(0xFF80));
+    const __m128i belowA = _mm_set1_epi16('A' - 1);
+    const __m128i aboveZ = _mm_set1_epi16('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi16(0x20);
+    for (; i + 8 <= size; i += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, nonAscii), _mm_setzero_si128())) != 0xFFFF) {
+            for (qsizetype k = i; k < i + 8; ++k) dst[k] = foldChar(src[k]);
+            continue;
+        }
+        // All lanes are ASCII, so signed compares are safe
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(chunk, belowA), _mm_cmplt_epi16(chunk, aboveZ));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(chunk, _mm_and_si128(upper, caseBit)));
+    }
+#endif
+    for (; i < size; ++i) dst[i] = foldChar(src[i]);
+    return folded;
+}
+
+Result findAll(QStringView foldedText, QStringView foldedNeedle, const QAtomicInt* cancel) {
+    Result result;
+    const qsizetype size = foldedNeedle.size();
+    if (size == 0 || size > foldedText.size()) return result;
+    
+    const char16_t* text = foldedText.utf16();
+    const char16_t* needle = foldedNeedle.utf16();
+    const char16_t first = needle[0];
+    const char16_t last = needle[size - 1];
+    // Last position an occurrence can start at
+    const qsizetype end = foldedText.size() - size;
+    qsizetype i = 0;
+#ifdef TEXT_SEARCH_SSE2
+    const __m128i firstLanes = _mm_set1_epi16(short(first));
+    const __m128i lastLanes = _mm_set1_epi16(short(last));
+    for (; i + 7 <= end; i += 8) {
+        if (i % kCancelCheckInterval == 0 && isCanceled(cancel)) {
+            result.canceled = true;
+            return result;
+        }
+        const __m128i starts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const __m128i ends = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + size - 1));
+        // Two mask bits per candidate position
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(starts, firstLanes),
+                                                                 _mm_cmpeq_epi16(ends, lastLanes))));
+        while (mask) {
+            const qsizetype pos = i + qCountTrailingZeroBits(mask) / 2;
+            if (innerMatches(text + pos, needle, size) && !addHit(result, pos)) return result;
+            mask &= mask - 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= end; ++i) {
+        if (i % kCancelCheckInterval == 0 && isCanceled(cancel)) {
+            result.canceled = true;
+            return result;
+        }
+        if (text[i] == first && text[i + size - 1] == last && innerMatches(text + i, needle, size)
+            && !addHit(result, i)) {
+            return result;
+        }
+    }
+    return result;
+}
+
+Result refine(QStringView foldedText, const QList<int>& previousHits, QStringView foldedNeedle,
+              const QAtomicInt* cancel) {
+    Result result;
+    const qsizetype size = foldedNeedle.size();
+    if (size == 0) return result;
+    
+    const char16_t* text = foldedText.utf16();
+    const char16_t* needle = foldedNeedle.utf16();
+    for (qsizetype k = 0; k < previousHits.size(); ++k) {
+        if (k % kCancelCheckInterval == 0 && isCanceled(cancel)) {
+            result.canceled = true;
+            return result;
+        }
+        const qsizetype pos = previousHits.at(k);
+        if (pos + size <= foldedText.size()
+            && std::memcmp(text + pos, needle, size * sizeof(char16_t)) == 0) {
+            result.hits.append(int(pos));
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,52 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+
+/**
+ * Case-insensitive substring search over large texts, as used by the find bar.
+ *
+ * Both the text and the needle are folded once with fold(); searches then
+ * compare UTF-16 code units directly. Folding maps every code unit to exactly
+ * one code unit, so positions in the folded text are positions in the
+ * original text (and in a QTextDocument built from it). The scan compares
+ * the first and last code unit of the needle at eight positions per step
+ * with SSE2 and verifies only the candidates where both match.
+ */
+namespace TextSearch {
+
+/** Hits kept per search; a search that finds more stops and reports truncated. */
+constexpr int MaxHits = 100000;
+
+struct Result {
+    /** Start positions of all (also overlapping) occurrences, ascending. */
+    QList<int> hits;
+    /** True if the search stopped at MaxHits. */
+    bool truncated = false;
+    /** True if the search was canceled; hits are incomplete. */
+    bool canceled = false;
+};
+
+/** Simple (length-preserving) case folding; ASCII runs are folded with SSE2. */
+QString fold(QStringView text);
+
+/**
+ * Finds all occurrences of foldedNeedle in foldedText.
+ * Returns early with Result::canceled set once *cancel becomes non-zero.
+ */
+Result findAll(QStringView foldedText, QStringView foldedNeedle, const QAtomicInt* cancel = nullptr);
+
+/**
+ * Narrows the hits of a previous search to those where foldedNeedle occurs.
+ * Valid only if the previous needle is a prefix of foldedNeedle and the
+ * previous result was not truncated: every occurrence of the longer needle
+ * is then an occurrence of the shorter one, so only those positions are checked.
+ */
+Result refine(QStringView foldedText, const QList<int>& previousHits, QStringView foldedNeedle,
+              const QAtomicInt* cancel = nullptr);
+
+}
+
+#endif
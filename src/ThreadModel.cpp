@@ -0,0 +1,488 @@
+#include "ThreadModel.h"
+#include "MessageIds.h"
+#include "MsgParser.h"
+#include <QDir>
+#include <QFont>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// PR_CONVERSATION_INDEX: 22-byte header block, then one 5-byte block per reply level
+constexpr int kConversationHeaderSize = 22;
+constexpr int kConversationChildSize = 5;
+
+/** Keys a message is registered under: its Message-ID and its conversation index (0 = none). */
+void messageKeys(const ThreadModel::MessageHeaders& message, quint64& idKey, quint64& indexKey) {
+    const QByteArray& conversationIndex = message.conversationIndex;
+    idKey = MessageIds::messageIdKey(message.messageId);
+    indexKey = conversationIndex.size() >= kConversationHeaderSize
+        ? MessageIds::conversationIndexKey(conversationIndex.constData(), conversationIndex.size())
+        : 0;
+}
+
+}
+
+ThreadModel::ThreadModel(QObject* parent)
+    : QAbstractItemModel(parent)
+{
+}
+
+ThreadModel::MessageHeaders ThreadModel::headersFromMessage(const QString& filePath, const EmailMessage& msg) {
+    MessageHeaders headers;
+    headers.filePath = filePath;
+    headers.isValid = msg.isValid;
+    if (!msg.isValid) return headers;
+    
+    headers.subject = msg.subject;
+    headers.sender = msg.senderName.isEmpty() ? msg.senderEmail : msg.senderName;
+    headers.date = msg.date;
+    headers.messageId = msg.messageId;
+    headers.inReplyTo = msg.inReplyTo;
+    headers.references = msg.references;
+    headers.conversationTopic = msg.conversationTopic;
+    headers.conversationIndex = msg.conversationIndex;
+    return headers;
+}
+
+ThreadModel::MessageHeaders ThreadModel::readHeaders(const QString& filePath) {
+    MsgParser parser;
+    parser.setOptions(ParseOptions::headersOnly());
+    return headersFromMessage(filePath, parser.parse(filePath));
+}
+
+/**
+ * Within the batch child lists are only appended to and put back in order
+ * once at the end. Most batches only add messages: those are applied first
+ * and then published as row insertions, one per run of new rows in each
+ * existing child list. A batch that fills in (or joins) placeholders already
+ * shown moves existing rows, so it is applied inside one layout change
+ * instead, with persistent indexes (selection, expanded items) remapped by
+ * node id, which the internal id of every index carries.
+ */
+void ThreadModel::addMessages(const QList<MessageHeaders>& messages) {
+    if (messages.isEmpty()) return;
+    
+    // Nothing to preserve in an empty model; a reset is cheaper
+    if (m_nodes.isEmpty()) {
+        beginResetModel();
+        for (const auto& message : messages) {
+            addMessage(message);
+        }
+        tidyChildLists();
+        endResetModel();
+        return;
+    }
+    
+    // Only a message whose own key names a placeholder changes existing nodes
+    bool fillsPlaceholder = false;
+    for (const auto& message : messages) {
+        if (!message.isValid) continue;
+        quint64 keys[2];
+        messageKeys(message, keys[0], keys[1]);
+        for (quint64 key : keys) {
+            auto it = key != 0 ? m_nodeByKey.constFind(key) : m_nodeByKey.constEnd();
+            if (it != m_nodeByKey.constEnd() && m_nodes[*it].placeholder) {
+                fillsPlaceholder = true;
+            }
+        }
+    }
+    
+    if (!fillsPlaceholder) {
+        const int firstNew = static_cast<int>(m_nodes.size());
+        for (const auto& message : messages) {
+            addMessage(message);
+        }
+        // Rows below new nodes arrive with them; only existing lists get insertions
+        QList<int> parents;
+        if (m_rootsTouched) parents.append(NoParent);
+        for (int parent : std::as_const(m_touchedNodes)) {
+            if (parent < firstNew) parents.append(parent);
+        }
+        tidyChildLists();
+        publishInsertedRows(parents, firstNew);
+        return;
+    }
+    
+    emit layoutAboutToBeChanged();
+    const QModelIndexList before = persistentIndexList();
+    
+    for (const auto& message : messages) {
+        addMessage(message);
+    }
+    tidyChildLists();
+    
+    QModelIndexList after;
+    after.reserve(before.size());
+    for (const QModelIndex& index : before) {
+        const int node = static_cast<int>(index.internalId());
+        if (m_nodes[node].parent == Removed) {
+            after.append(QModelIndex());
+        } else {
+            after.append(createIndex(rowOf(node), index.column(), quintptr(node)));
+        }
+    }
+    changePersistentIndexList(before, after);
+    emit layoutChanged();
+}
+
+void ThreadModel::clear() {
+    beginResetModel();
+    m_nodes.clear();
+    m_roots.clear();
+    m_rootRowsDirty = false;
+    m_rootsTouched = false;
+    m_sortedRoots = 0;
+    m_touchedNodes.clear();
+    m_nodeByKey.clear();
+    m_messageCount = 0;
+    endResetModel();
+}
+
+int ThreadModel::messageCount() const {
+    return m_messageCount;
+}
+
+int ThreadModel::threadCount() const {
+    return static_cast<int>(m_roots.size());
+}
+
+QString ThreadModel::filePath(const QModelIndex& index) const {
+    if (!index.isValid()) return QString();
+    return m_nodes[static_cast<int>(index.internalId())].filePath;
+}
+
+void ThreadModel::addMessage(const MessageHeaders& message) {
+    if (!message.isValid) return;
+    
+    const QByteArray& conversationIndex = message.conversationIndex;
+    quint64 idKey = 0;
+    quint64 indexKey = 0;
+    messageKeys(message, idKey, indexKey);
+    
+    // Parent reference: In-Reply-To, else the last References entry, else the
+    // conversation index with its last child block removed
+    quint64 parentKey = 0;
+    const QList<QString> inReplyTo = MessageIds::parseIdList(message.inReplyTo);
+    if (!inReplyTo.isEmpty()) {
+        parentKey = MessageIds::messageIdKey(inReplyTo.first());
+    } else {
+        const QList<QString> references = MessageIds::parseIdList(message.references);
+        if (!references.isEmpty()) {
+            parentKey = MessageIds::messageIdKey(references.last());
+        }
+    }
+    if (parentKey == 0 && conversationIndex.size() >= kConversationHeaderSize + kConversationChildSize) {
+        parentKey = MessageIds::conversationIndexKey(conversationIndex.constData(),
+                                                     conversationIndex.size() - kConversationChildSize);
+    }
+    if (parentKey == idKey || parentKey == indexKey) {
+        parentKey = 0;
+    }
+    
+    const qint64 time = message.date.isValid()
+        ? message.date.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+    
+    // Reuse placeholders created for this message by earlier replies; if both
+    // of its keys have one, the two partial threads are joined here
+    int node = -1;
+    for (quint64 key : {idKey, indexKey}) {
+        if (key == 0) continue;
+        auto it = m_nodeByKey.constFind(key);
+        if (it == m_nodeByKey.constEnd() || !m_nodes[*it].placeholder) continue;
+        if (node < 0) {
+            node = *it;
+        } else if (*it != node) {
+            mergePlaceholder(*it, node);
+        }
+    }
+    
+    if (node < 0) {
+        node = createNode(time);
+    }
+    
+    Node& target = m_nodes[node];
+    target.placeholder = false;
+    target.subject = message.subject;
+    target.sender = message.sender;
+    target.filePath = message.filePath;
+    target.time = time;
+    ++m_messageCount;
+    
+    // A key already owned by another message means this file is a copy of it;
+    // the copy is threaded as a sibling but not registered
+    registerKey(node, idKey);
+    registerKey(node, indexKey);
+    
+    int parent = NoParent;
+    if (parentKey != 0) {
+        auto it = m_nodeByKey.constFind(parentKey);
+        if (it != m_nodeByKey.constEnd()) {
+            parent = *it;
+        } else {
+            parent = createNode(time);
+            Node& placeholder = m_nodes[parent];
+            placeholder.subject = message.conversationTopic.isEmpty() ? message.subject : message.conversationTopic;
+            registerKey(parent, parentKey);
+            attach(parent, NoParent);
+        }
+        // Malformed references can form cycles; such messages stay top-level
+        if (isAncestor(node, parent)) {
+            parent = NoParent;
+        }
+    }
+    attach(node, parent);
+}
+
+int ThreadModel::createNode(qint64 time) {
+    Node node;
+    node.time = time;
+    m_nodes.append(node);
+    return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void ThreadModel::registerKey(int node, quint64 key) {
+    if (key == 0 || m_nodeByKey.contains(key)) return;
+    m_nodeByKey.insert(key, node);
+    quint64* keys = m_nodes[node].keys;
+    if (keys[0] == 0) {
+        keys[0] = key;
+    } else {
+        keys[1] = key;
+    }
+}
+
+void ThreadModel::mergePlaceholder(int from, int node) {
+    touch(m_nodes[from].parent);
+    m_nodes[from].parent = Removed;
+    
+    const QList<int> children = m_nodes[from].children;
+    m_nodes[from].children.clear();
+    for (int child : children) {
+        if (m_nodes[child].parent == from) {
+            attach(child, node);
+        }
+    }
+    
+    for (quint64 key : m_nodes[from].keys) {
+        if (key == 0) continue;
+        m_nodeByKey.insert(key, node);
+    }
+}
+
+/** The old entry, if any, stays in the previous parent's list until tidyChildLists() drops it. */
+void ThreadModel::attach(int node, int parent) {
+    const int previous = m_nodes[node].parent;
+    if (previous != Removed) {
+        touch(previous);
+    }
+    m_nodes[node].parent = parent;
+    if (parent == NoParent) {
+        m_nodes[node].pendingRoot = true;
+    }
+    childList(parent).append(node);
+    touch(parent);
+}
+
+void ThreadModel::touch(int parent) {
+    if (parent == NoParent) {
+        m_rootsTouched = true;
+    } else if (!m_nodes[parent].childrenTouched) {
+        m_nodes[parent].childrenTouched = true;
+        m_touchedNodes.append(parent);
+    }
+}
+
+void ThreadModel::tidyChildLists() {
+    // Top level newest first, replies oldest first; equal times keep arrival (id) order
+    auto newestFirst = [this](int a, int b) {
+        const qint64 ta = m_nodes[a].time;
+        const qint64 tb = m_nodes[b].time;
+        return ta != tb ? ta > tb : a < b;
+    };
+    auto oldestFirst = [this](int a, int b) {
+        const qint64 ta = m_nodes[a].time;
+        const qint64 tb = m_nodes[b].time;
+        return ta != tb ? ta < tb : a < b;
+    };
+    
+    if (m_rootsTouched) {
+        // The sorted part loses entries of nodes that moved away or were
+        // re-added in this batch (a filled placeholder has a new date); the
+        // appended part is sorted on its own and merged in
+        const auto sortedBegin = m_roots.begin();
+        auto sortedEnd = std::remove_if(sortedBegin, sortedBegin + m_sortedRoots, [this](int id) {
+            return m_nodes[id].parent != NoParent || m_nodes[id].pendingRoot;
+        });
+        auto appendedEnd = std::remove_if(sortedBegin + m_sortedRoots, m_roots.end(), [this](int id) {
+            return m_nodes[id].parent != NoParent;
+        });
+        const qsizetype sortedCount = sortedEnd - sortedBegin;
+        appendedEnd = std::move(sortedBegin + m_sortedRoots, appendedEnd, sortedEnd);
+        m_roots.erase(appendedEnd, m_roots.end());
+        
+        std::sort(m_roots.begin() + sortedCount, m_roots.end(), newestFirst);
+        m_roots.erase(std::unique(m_roots.begin() + sortedCount, m_roots.end()), m_roots.end());
+        for (auto it = m_roots.begin() + sortedCount; it != m_roots.end(); ++it) {
+            m_nodes[*it].pendingRoot = false;
+        }
+        std::inplace_merge(m_roots.begin(), m_roots.begin() + sortedCount, m_roots.end(), newestFirst);
+        
+        m_sortedRoots = m_roots.size();
+        m_rootRowsDirty = true;
+        m_rootsTouched = false;
+    }
+    
+    for (int parent : m_touchedNodes) {
+        Node& node = m_nodes[parent];
+        QList<int>& list = node.children;
+        list.erase(std::remove_if(list.begin(), list.end(), [this, parent](int id) {
+            return m_nodes[id].parent != parent;
+        }), list.end());
+        std::sort(list.begin(), list.end(), oldestFirst);
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+        node.childRowsDirty = true;
+        node.childrenTouched = false;
+    }
+    m_touchedNodes.clear();
+}
+
+/**
+ * A tidied child list of an existing node holds its old entries in their old
+ * order (nothing existing moved) with the new ones merged in. All lists are
+ * first cut back to their old entries, so every list (and the row of every
+ * parent) matches what views know; then the new entries are inserted again
+ * run by run, front to back.
+ */
+void ThreadModel::publishInsertedRows(const QList<int>& parents, int firstNew) {
+    auto isNew = [firstNew](int id) { return id >= firstNew; };
+    QList<QList<int>> merged;
+    merged.reserve(parents.size());
+    for (int parent : parents) {
+        QList<int>& list = childList(parent);
+        merged.append(list);
+        list.erase(std::remove_if(list.begin(), list.end(), isNew), list.end());
+        bool& dirty = parent == NoParent ? m_rootRowsDirty : m_nodes[parent].childRowsDirty;
+        dirty = true;
+    }
+    
+    for (qsizetype i = 0; i < parents.size(); ++i) {
+        const int parent = parents.at(i);
+        const QList<int>& target = merged.at(i);
+        QList<int>& list = childList(parent);
+        bool& dirty = parent == NoParent ? m_rootRowsDirty : m_nodes[parent].childRowsDirty;
+        const QModelIndex parentIndex = parent == NoParent
+            ? QModelIndex() : createIndex(rowOf(parent), 0, quintptr(parent));
+        for (qsizetype begin = 0; begin < target.size();) {
+            if (!isNew(target[begin])) {
+                ++begin;
+                continue;
+            }
+            qsizetype end = begin;
+            while (end < target.size() && isNew(target[end])) ++end;
+            
+            beginInsertRows(parentIndex, int(begin), int(end - 1));
+            list.insert(begin, end - begin, 0);
+            std::copy(target.cbegin() + begin, target.cbegin() + end, list.begin() + begin);
+            dirty = true;
+            endInsertRows();
+            begin = end;
+        }
+    }
+}
+
+bool ThreadModel::isAncestor(int ancestor, int node) const {
+    for (int current = node; current >= 0; current = m_nodes[current].parent) {
+        if (current == ancestor) return true;
+    }
+    return false;
+}
+
+QList<int>& ThreadModel::childList(int parent) {
+    return parent == NoParent ? m_roots : m_nodes[parent].children;
+}
+
+const QList<int>& ThreadModel::childList(int parent) const {
+    return parent == NoParent ? m_roots : m_nodes[parent].children;
+}
+
+/** Rows are renumbered lazily, once per modified child list, on first use. */
+int ThreadModel::rowOf(int node) const {
+    const int parent = m_nodes[node].parent;
+    bool& dirty = parent == NoParent ? m_rootRowsDirty : m_nodes[parent].childRowsDirty;
+    if (dirty) {
+        const QList<int>& list = childList(parent);
+        for (int row = 0; row < list.size(); ++row) {
+            m_nodes[list[row]].row = row;
+        }
+        dirty = false;
+    }
+    return m_nodes[node].row;
+}
+
+QModelIndex ThreadModel::index(int row, int column, const QModelIndex& parent) const {
+    if (column < 0 || column >= ColumnCount || row < 0) return QModelIndex();
+    const QList<int>& list = childList(parent.isValid() ? static_cast<int>(parent.internalId()) : NoParent);
+    if (row >= list.size()) return QModelIndex();
+    return createIndex(row, column, quintptr(list[row]));
+}
+
+QModelIndex ThreadModel::parent(const QModelIndex& child) const {
+    if (!child.isValid()) return QModelIndex();
+    const int parent = m_nodes[static_cast<int>(child.internalId())].parent;
+    if (parent < 0) return QModelIndex();
+    return createIndex(rowOf(parent), 0, quintptr(parent));
+}
+
+int ThreadModel::rowCount(const QModelIndex& parent) const {
+    if (parent.column() > 0) return 0;
+    return static_cast<int>(childList(parent.isValid() ? static_cast<int>(parent.internalId()) : NoParent).size());
+}
+
+int ThreadModel::columnCount(const QModelIndex& parent) const {
+    Q_UNUSED(parent);
+    return ColumnCount;
+}
+
+QVariant ThreadModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) return QVariant();
+    const Node& node = m_nodes[static_cast<int>(index.internalId())];
+    
+    switch (role) {
+        case Qt::DisplayRole:
+            switch (index.column()) {
+                case SubjectColumn:
+                    return node.subject.isEmpty() ? tr("(no subject)") : node.subject;
+                case SenderColumn:
+                    return node.placeholder ? tr("(not in folder)") : node.sender;
+                case DateColumn:
+                    if (node.time == std::numeric_limits<qint64>::min()) return QString();
+                    return QDateTime::fromMSecsSinceEpoch(node.time).toLocalTime().toString(Qt::ISODate);
+            }
+            break;
+        case Qt::FontRole:
+            if (node.placeholder) {
+                QFont font;
+                font.setItalic(true);
+                return font;
+            }
+            break;
+        case Qt::ToolTipRole:
+            if (!node.filePath.isEmpty()) return QDir::toNativeSeparators(node.filePath);
+            break;
+        case FilePathRole:
+            return node.filePath;
+    }
+    return QVariant();
+}
+
+QVariant ThreadModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+    
+    switch (section) {
+        case SubjectColumn: return tr("Subject");
+        case SenderColumn: return tr("From");
+        case DateColumn: return tr("Date");
+    }
+    return QVariant();
+}
@@ -0,0 +1,137 @@
+#ifndef THREADMODEL_H
+#define THREADMODEL_H
+
+#include <QAbstractItemModel>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <limits>
+#include "EmailTypes.h"
+
+/**
+ * Tree model of conversations, built incrementally as message headers arrive.
+ *
+ * A message's parent is the message named by its In-Reply-To (or the last
+ * References entry), or failing that the message whose PR_CONVERSATION_INDEX
+ * is its own index minus the last 5-byte child block. Parents not seen yet
+ * get a placeholder node that is filled in when (if) the message arrives, so
+ * the result does not depend on the order in which files are scanned.
+ *
+ * Identifiers are reduced to 64-bit keys (MessageIds.h) and looked up in a
+ * single hash map, so adding a message costs a few integer lookups.
+ * Conversations are listed newest first; replies within a conversation
+ * oldest first.
+ */
+class ThreadModel : public QAbstractItemModel {
+    Q_OBJECT
+    
+public:
+    enum Column {
+        SubjectColumn,
+        SenderColumn,
+        DateColumn,
+        ColumnCount
+    };
+    
+    /** Role returning the file path of a message (empty for placeholders). */
+    static constexpr int FilePathRole = Qt::UserRole + 1;
+    
+    /** Thread-relevant headers of one message, as produced by a background scan. */
+    struct MessageHeaders {
+        QString filePath;
+        QString subject;
+        QString sender;
+        QDateTime date;
+        QString messageId;
+        QString inReplyTo;
+        QString references;
+        QString conversationTopic;
+        QByteArray conversationIndex;
+        bool isValid = false;
+    };
+    
+    explicit ThreadModel(QObject* parent = nullptr);
+    
+    /** Extracts the threading headers from a parsed message. */
+    static MessageHeaders headersFromMessage(const QString& filePath, const EmailMessage& msg);
+    /** Parses a file (headers only) and extracts its threading headers; safe to call from worker threads. */
+    static MessageHeaders readHeaders(const QString& filePath);
+    
+    /** Threads a batch of messages into the tree; invalid entries are skipped. */
+    void addMessages(const QList<MessageHeaders>& messages);
+    /** Removes all messages. */
+    void clear();
+    
+    /** Number of messages added (excluding placeholders). */
+    int messageCount() const;
+    /** Number of top-level conversations. */
+    int threadCount() const;
+    /** File path of the message at index, or an empty string for placeholders. */
+    QString filePath(const QModelIndex& index) const;
+    
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    
+private:
+    static constexpr int NoParent = -1;
+    static constexpr int Removed = -2;
+    
+    struct Node {
+        QString subject;
+        QString sender;
+        QString filePath;
+        /** Milliseconds since epoch, or the minimum value when unknown. */
+        qint64 time = std::numeric_limits<qint64>::min();
+        int parent = NoParent;
+        /** Position in the parent's child list; valid unless the parent's list is marked dirty. */
+        mutable int row = 0;
+        /** Keys under which this node is registered in m_nodeByKey (0 = unused). */
+        quint64 keys[2] = {0, 0};
+        QList<int> children;
+        mutable bool childRowsDirty = false;
+        /** Child list was modified in the current batch and must be tidied. */
+        bool childrenTouched = false;
+        /** Appended to the top level in the current batch; any older top-level entry is stale. */
+        bool pendingRoot = false;
+        bool placeholder = true;
+    };
+    
+    /** Threads a single message; must be followed by tidyChildLists() before the model is read. */
+    void addMessage(const MessageHeaders& message);
+    /** Drops stale entries from the child lists changed in this batch and restores date order. */
+    void tidyChildLists();
+    /** Announces the nodes from firstNew on in the (tidied) child lists of parents as inserted rows. */
+    void publishInsertedRows(const QList<int>& parents, int firstNew);
+    /** Creates a node and returns its id. */
+    int createNode(qint64 time);
+    /** Registers key for a node unless it already belongs to another node. */
+    void registerKey(int node, quint64 key);
+    /** Moves the children and keys of placeholder from into node and removes from. */
+    void mergePlaceholder(int from, int node);
+    /** Makes node a child of parent (NoParent = top level). */
+    void attach(int node, int parent);
+    /** Marks a child list as changed in this batch. */
+    void touch(int parent);
+    /** True if node is ancestor itself or one of its ancestors. */
+    bool isAncestor(int ancestor, int node) const;
+    
+    QList<int>& childList(int parent);
+    const QList<int>& childList(int parent) const;
+    int rowOf(int node) const;
+    
+    QList<Node> m_nodes;
+    QList<int> m_roots;
+    mutable bool m_rootRowsDirty = false;
+    bool m_rootsTouched = false;
+    /** Leading part of m_roots already in order; entries after it were added in this batch. */
+    qsizetype m_sortedRoots = 0;
+    QList<int> m_touchedNodes;
+    QHash<quint64, int> m_nodeByKey;
+    int m_messageCount = 0;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "ThumbnailCache.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+// A cache hit refreshes the file time at most this often (seconds), so most hits only read
+constexpr qint64 kTouchIntervalSecs = 3600;
+
+std::atomic<qint64> s_maxCacheBytes{ThumbnailCache::DefaultMaxCacheBytes};
+// Bytes written since the last prune; the cache is pruned again once this passes an eighth of the limit
+std::atomic<qint64> s_bytesSincePrune{0};
+std::once_flag s_startupPrune;
+QMutex s_pruneMutex;
+
+/** Cached previews, newest first. */
+QFileInfoList cachedPreviews() {
+    return QDir(ThumbnailCache::cacheDirectory()).entryInfoList({QStringLiteral("*.png")}, QDir::Files, QDir::Time);
+}
+
+/** Cache file of a content key; the preview size is part of the name so a changed size never reuses old files. */
+QString previewPath(const QByteArray& contentKey) {
+    return ThumbnailCache::cacheDirectory() + QString("/%1-%2.png")
+        .arg(QString::fromLatin1(contentKey.toHex())).arg(ThumbnailCache::PreviewSize);
+}
+
+/** Decodes data at no more than PreviewSize on each side. */
+QImage decodePreview(const QByteArray& data) {
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+    if (!reader.canRead()) return QImage();
+    
+    const QSize size = reader.size();
+    if (size.isValid() && (size.width() > ThumbnailCache::PreviewSize || size.height() > ThumbnailCache::PreviewSize)) {
+        reader.setScaledSize(size.scaled(ThumbnailCache::PreviewSize, ThumbnailCache::PreviewSize, Qt::KeepAspectRatio));
+    }
+    
+    QImage image = reader.read();
+    // Handlers without scaled decoding may ignore the request; never keep more than a preview
+    if (!image.isNull() && (image.width() > ThumbnailCache::PreviewSize || image.height() > ThumbnailCache::PreviewSize)) {
+        image = image.scaled(ThumbnailCache::PreviewSize, ThumbnailCache::PreviewSize,
+                             Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
+
+}
+
+bool ThumbnailCache::isImage(const QString& filename, const QString& mimeType) {
+    if (mimeType.startsWith("image/", Qt::CaseInsensitive)) return true;
+    
+    static const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+    const QByteArray suffix = QFileInfo(filename).suffix().toLower().toLatin1();
+    return !suffix.isEmpty() && formats.contains(suffix);
+}
+
+ThumbnailCache::Thumbnail ThumbnailCache::thumbnail(const QByteArray& data) {
+    Thumbnail result;
+    if (data.isEmpty()) return result;
+    
+    const QByteArray key = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    const QString path = previewPath(key);
+    
+    const qint64 maxCacheBytes = s_maxCacheBytes.load(std::memory_order_relaxed);
+    if (maxCacheBytes > 0) {
+        // Also applies a limit lowered since the last run
+        std::call_once(s_startupPrune, &ThumbnailCache::prune);
+    }
+    
+    QImage preview;
+    QFile cached(path);
+    if (maxCacheBytes > 0 && cached.open(QIODevice::ReadOnly)) {
+        preview.load(&cached, "png");
+        // Least recently used is judged by modification time
+        const QDateTime now = QDateTime::currentDateTimeUtc();
+        if (!preview.isNull() && cached.fileTime(QFileDevice::FileModificationTime).secsTo(now) > kTouchIntervalSecs) {
+            cached.setFileTime(now, QFileDevice::FileModificationTime);
+        }
+        cached.close();
+    }
+    if (preview.isNull()) {
+        preview = decodePreview(data);
+        if (preview.isNull()) return result;
+        
+        // QSaveFile writes to a temporary file and renames, so concurrent workers never see a partial file
+        if (maxCacheBytes > 0 && QDir().mkpath(cacheDirectory())) {
+            QSaveFile file(path);
+            if (file.open(QIODevice::WriteOnly) && QImageWriter(&file, "png").write(preview) && file.commit()) {
+                result.previewPath = path;
+                const qint64 written = QFileInfo(path).size();
+                if (s_bytesSincePrune.fetch_add(written) + written > maxCacheBytes / 8) {
+                    s_bytesSincePrune = 0;
+                    prune();
+                }
+            }
+        }
+    } else {
+        result.previewPath = path;
+    }
+    
+    result.icon = preview.width() > IconSize || preview.height() > IconSize
+        ? preview.scaled(IconSize, IconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+        : preview;
+    return result;
+}
+
+QString ThumbnailCache::cacheDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+}
+
+void ThumbnailCache::setMaxCacheBytes(qint64 bytes) {
+    s_maxCacheBytes = qMax<qint64>(0, bytes);
+}
+
+qint64 ThumbnailCache::maxCacheBytes() {
+    return s_maxCacheBytes;
+}
+
+void ThumbnailCache::prune() {
+    // One worker prunes at a time; the others go on rendering
+    if (!s_pruneMutex.tryLock()) return;
+    
+    const qint64 maxCacheBytes = s_maxCacheBytes;
+    qint64 total = 0;
+    for (const QFileInfo& info : cachedPreviews()) {
+        total += info.size();
+        // A preview still in use by a tooltip is simply rendered again next time
+        if (total > maxCacheBytes && QFile::remove(info.filePath())) {
+            total -= info.size();
+        }
+    }
+    s_pruneMutex.unlock();
+}
+
+bool ThumbnailCache::clear() {
+    QMutexLocker lock(&s_pruneMutex);
+    bool ok = true;
+    for (const QFileInfo& info : cachedPreviews()) {
+        ok = QFile::remove(info.filePath()) && ok;
+    }
+    return ok;
+}
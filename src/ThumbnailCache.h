@@ -0,0 +1,53 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+/**
+ * Thumbnails of image attachments, with a persistent on-disk cache.
+ *
+ * Images are decoded with QImageReader::setScaledSize, so formats whose
+ * handler supports it (JPEG) are never decoded at full resolution. Each
+ * rendered preview is stored under the SHA-1 of the attachment content, so
+ * the same picture in another message (or the same message reopened) costs
+ * one hash instead of a decode. The cache is kept under a size limit by
+ * deleting the least recently used previews (file modification time, which a
+ * cache hit refreshes). All functions are safe to call from worker threads.
+ */
+class ThumbnailCache {
+public:
+    /** Edge length of the preview kept on disk and shown on hover. */
+    static constexpr int PreviewSize = 256;
+    /** Edge length of the icon shown in the attachments table. */
+    static constexpr int IconSize = 48;
+    /** Default size limit of the cache directory. */
+    static constexpr qint64 DefaultMaxCacheBytes = 64LL * 1024 * 1024;
+    
+    struct Thumbnail {
+        /** Icon-sized image, null if the data is not a readable image. */
+        QImage icon;
+        /** Cached preview file, empty if the cache is not writable. */
+        QString previewPath;
+    };
+    
+    /** True if filename/mimeType name an image format QImageReader can decode. */
+    static bool isImage(const QString& filename, const QString& mimeType);
+    
+    /** Returns the thumbnail of image data, from the cache or by decoding it at reduced size. */
+    static Thumbnail thumbnail(const QByteArray& data);
+    
+    /** Directory holding cached previews. */
+    static QString cacheDirectory();
+    
+    /** Sets the size limit of the cache directory; 0 writes no previews (and so shows no hover previews). */
+    static void setMaxCacheBytes(qint64 bytes);
+    static qint64 maxCacheBytes();
+    /** Deletes least recently used previews until the cache fits its size limit. */
+    static void prune();
+    /** Deletes all cached previews. Returns false if some could not be removed. */
+    static bool clear();
+};
+
+#endif
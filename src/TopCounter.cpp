@@ -0,0 +1,114 @@
+#include "TopCounter.h"
+#include <QSet>
+#include <algorithm>
+
+TopCounter::TopCounter(int capacity)
+    : m_capacity(qMax(1, capacity))
+{
+}
+
+void TopCounter::add(const QString& key, qint64 weight) {
+    auto it = m_positions.constFind(key);
+    if (it != m_positions.cend()) {
+        const int pos = it.value();
+        m_heap[pos].count += weight;
+        siftDown(pos);
+        return;
+    }
+    
+    if (m_heap.size() < m_capacity) {
+        m_heap.append(Item{key, weight, 0});
+        m_positions.insert(key, m_heap.size() - 1);
+        siftUp(m_heap.size() - 1);
+        return;
+    }
+    
+    // Full: the new key replaces the smallest counter and inherits its count as error
+    Item& root = m_heap[0];
+    m_positions.remove(root.key);
+    root.key = key;
+    root.error = root.count;
+    root.count += weight;
+    m_positions.insert(key, 0);
+    siftDown(0);
+}
+
+void TopCounter::merge(const TopCounter& other) {
+    // Mergeable summaries: a key missing from a full summary may have had up to its minimum count
+    QSet<QString> keys;
+    for (const Item& item : m_heap) keys.insert(item.key);
+    for (const Item& item : other.m_heap) keys.insert(item.key);
+    
+    QList<Item> merged;
+    merged.reserve(keys.size());
+    for (const QString& key : keys) {
+        qint64 errorA = 0;
+        qint64 errorB = 0;
+        const qint64 count = countOf(key, &errorA) + other.countOf(key, &errorB);
+        merged.append(Item{key, count, errorA + errorB});
+    }
+    
+    if (merged.size() > m_capacity) {
+        std::nth_element(merged.begin(), merged.begin() + m_capacity, merged.end(),
+                         [](const Item& a, const Item& b) { return a.count > b.count; });
+        merged.resize(m_capacity);
+    }
+    
+    m_heap = merged;
+    m_positions.clear();
+    for (int i = 0; i < m_heap.size(); ++i) {
+        m_positions.insert(m_heap.at(i).key, i);
+    }
+    for (int i = m_heap.size() / 2 - 1; i >= 0; --i) {
+        siftDown(i);
+    }
+}
+
+QList<TopCounter::Item> TopCounter::top(int n) const {
+    QList<Item> items = m_heap;
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    if (items.size() > n) items.resize(qMax(0, n));
+    return items;
+}
+
+qint64 TopCounter::countOf(const QString& key, qint64* error) const {
+    auto it = m_positions.constFind(key);
+    if (it != m_positions.cend()) {
+        const Item& item = m_heap.at(it.value());
+        *error = item.error;
+        return item.count;
+    }
+    const qint64 floor = m_heap.size() < m_capacity ? 0 : m_heap.first().count;
+    *error = floor;
+    return floor;
+}
+
+void TopCounter::siftUp(int pos) {
+    while (pos > 0) {
+        const int parent = (pos - 1) / 2;
+        if (m_heap.at(parent).count <= m_heap.at(pos).count) break;
+        swapItems(parent, pos);
+        pos = parent;
+    }
+}
+
+void TopCounter::siftDown(int pos) {
+    const int size = m_heap.size();
+    while (true) {
+        const int left = 2 * pos + 1;
+        if (left >= size) break;
+        const int right = left + 1;
+        const int smallest = right < size && m_heap.at(right).count < m_heap.at(left).count ? right : left;
+        if (m_heap.at(pos).count <= m_heap.at(smallest).count) break;
+        swapItems(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void TopCounter::swapItems(int a, int b) {
+    m_heap.swapItemsAt(a, b);
+    m_positions[m_heap.at(a).key] = a;
+    m_positions[m_heap.at(b).key] = b;
+}
@@ -0,0 +1,52 @@
+#ifndef TOPCOUNTER_H
+#define TOPCOUNTER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/**
+ * Approximate heavy hitters (Space-Saving) in a fixed number of counters.
+ *
+ * Keeps at most capacity() keys however many distinct keys are added. A key
+ * that is not tracked when the counters are full takes over the smallest
+ * counter and inherits its count as possible overestimate (error), so every
+ * reported count is an upper bound that exceeds the true count by at most
+ * error. Counters are kept in a min-heap, so add() is O(log capacity).
+ * Summaries from different threads can be merged.
+ */
+class TopCounter {
+public:
+    static constexpr int DefaultCapacity = 1024;
+    
+    struct Item {
+        QString key;
+        qint64 count = 0;
+        /** Upper bound of the overestimate included in count. */
+        qint64 error = 0;
+    };
+    
+    explicit TopCounter(int capacity = DefaultCapacity);
+    
+    /** Counts key weight times. */
+    void add(const QString& key, qint64 weight = 1);
+    /** Adds the counts of other (built with the same capacity) into this summary. */
+    void merge(const TopCounter& other);
+    /** The n keys with the highest counts, highest first. */
+    QList<Item> top(int n) const;
+    
+    int capacity() const { return m_capacity; }
+    
+private:
+    /** Count of a key, or the floor every untracked key may have if the counters are full. */
+    qint64 countOf(const QString& key, qint64* error) const;
+    void siftUp(int pos);
+    void siftDown(int pos);
+    void swapItems(int a, int b);
+    
+    int m_capacity;
+    QList<Item> m_heap;
+    QHash<QString, int> m_positions;
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "ZipArchive.h"
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QSaveFile>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+constexpr quint32 kLocalHeaderSignature = 0x04034b50;
+constexpr quint32 kCentralHeaderSignature = 0x02014b50;
+constexpr quint32 kEndOfDirectorySignature = 0x06054b50;
+constexpr quint32 kZip64EndOfDirectorySignature = 0x06064b50;
+constexpr quint32 kZip64LocatorSignature = 0x07064b50;
+
+constexpr qint64 kLocalHeaderSize = 30;
+constexpr qint64 kCentralHeaderSize = 46;
+constexpr qint64 kEndOfDirectorySize = 22;
+constexpr qint64 kZip64LocatorSize = 20;
+constexpr qint64 kZip64EndOfDirectorySize = 56;
+constexpr quint16 kZip64ExtraId = 0x0001;
+
+constexpr quint16 kMethodStored = 0;
+constexpr quint16 kMethodDeflate = 8;
+constexpr quint16 kFlagUtf8 = 0x0800;
+
+// Stored members are copied (and CRC'd), and deflated ones fed to zlib, in chunks of this size
+constexpr qint64 kCopyChunk = 1024 * 1024;
+// Output buffer for inflating
+constexpr qint64 kInflateChunk = 256 * 1024;
+
+QString tr(const char* text) {
+    return QCoreApplication::translate("ZipArchive", text);
+}
+
+void setError(QString* errorString, const QString& message) {
+    if (errorString) *errorString = message;
+}
+
+/** Little-endian reads; callers check bounds first. */
+quint16 read16(const uchar* p) {
+    return quint16(p[0] | (p[1] << 8));
+}
+
+quint32 read32(const uchar* p) {
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+quint64 read64(const uchar* p) {
+    return quint64(read32(p)) | (quint64(read32(p + 4)) << 32);
+}
+
+QDateTime dosDateTime(quint16 time, quint16 date) {
+    const QDate d(1980 + (date >> 9), (date >> 5) & 0x0f, date & 0x1f);
+    const QTime t(time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2);
+    return d.isValid() && t.isValid() ? QDateTime(d, t) : QDateTime();
+}
+
+/**
+ * Inflates a raw DEFLATE member with zlib into out, a chunk of output at a
+ * time, updating crc and total. Stops as soon as the output exceeds
+ * expectedSize, so a hostile member cannot expand without bound.
+ */
+bool inflateMember(const uchar* input, qint64 size, qint64 expectedSize, QIODevice* out,
+                   quint32* crc, qint64* total, QString* errorString) {
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        setError(errorString, tr("cannot initialize zlib"));
+        return false;
+    }
+    
+    std::vector<uchar> buffer(kInflateChunk);
+    qint64 pos = 0;
+    int status = Z_OK;
+    bool ok = true;
+    while (ok && status != Z_STREAM_END) {
+        if (stream.avail_in == 0) {
+            if (pos == size) {
+                setError(errorString, tr("unexpected end of compressed data"));
+                ok = false;
+                break;
+            }
+            // avail_in is 32 bits wide; members may be larger
+            const qint64 n = std::min(kCopyChunk, size - pos);
+            stream.next_in = const_cast<Bytef*>(input + pos);
+            stream.avail_in = uInt(n);
+            pos += n;
+        }
+        stream.next_out = buffer.data();
+        stream.avail_out = uInt(buffer.size());
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            setError(errorString, stream.msg ? QString::fromLatin1(stream.msg) : tr("corrupt compressed data"));
+            ok = false;
+            break;
+        }
+        
+        const qint64 produced = qint64(buffer.size()) - stream.avail_out;
+        *total += produced;
+        if (*total > expectedSize) {
+            setError(errorString, tr("member is larger than its recorded size"));
+            ok = false;
+            break;
+        }
+        *crc = quint32(crc32(*crc, buffer.data(), uInt(produced)));
+        if (out->write(reinterpret_cast<const char*>(buffer.data()), produced) != produced) {
+            setError(errorString, out->errorString());
+            ok = false;
+        }
+    }
+    inflateEnd(&stream);
+    return ok;
+}
+
+/** Offset of the end-of-central-directory record, or -1. The comment after it may be up to 64 KiB. */
+qint64 findEndOfDirectory(const uchar* data, qint64 size) {
+    const qint64 lowest = std::max<qint64>(0, size - kEndOfDirectorySize - 0xffff);
+    for (qint64 offset = size - kEndOfDirectorySize; offset >= lowest; --offset) {
+        if (read32(data + offset) == kEndOfDirectorySignature
+            && offset + kEndOfDirectorySize + read16(data + offset + 20) <= size) {
+            return offset;
+        }
+    }
+    return -1;
+}
+
+}
+
+bool ZipArchive::isZip(const QByteArray& data) {
+    return data.size() >= 4
+        && (read32(reinterpret_cast<const uchar*>(data.constData())) == kLocalHeaderSignature
+            || read32(reinterpret_cast<const uchar*>(data.constData())) == kEndOfDirectorySignature);
+}
+
+bool ZipArchive::readDirectory(const QByteArray& archive, QList<Entry>* entries, QString* errorString) {
+    entries->clear();
+    const uchar* data = reinterpret_cast<const uchar*>(archive.constData());
+    const qint64 size = archive.size();
+    
+    const qint64 endOffset = size >= kEndOfDirectorySize ? findEndOfDirectory(data, size) : -1;
+    if (endOffset < 0) {
+        setError(errorString, tr("Not a ZIP archive (no central directory)"));
+        return false;
+    }
+    
+    quint64 entryCount = read16(data + endOffset + 10);
+    quint64 directorySize = read32(data + endOffset + 12);
+    quint64 directoryOffset = read32(data + endOffset + 16);
+    
+    // ZIP64: the locator sits right before the classic record and points at the 64-bit one
+    const qint64 locatorOffset = endOffset - kZip64LocatorSize;
+    if (locatorOffset >= 0 && read32(data + locatorOffset) == kZip64LocatorSignature) {
+        const quint64 zip64Offset = read64(data + locatorOffset + 8);
+        if (size < kZip64EndOfDirectorySize || zip64Offset > quint64(size - kZip64EndOfDirectorySize)
+            || read32(data + zip64Offset) != kZip64EndOfDirectorySignature) {
+            setError(errorString, tr("Corrupt ZIP64 end of central directory"));
+            return false;
+        }
+        entryCount = read64(data + zip64Offset + 32);
+        directorySize = read64(data + zip64Offset + 40);
+        directoryOffset = read64(data + zip64Offset + 48);
+    }
+    
+    if (directoryOffset > quint64(size) || directorySize > quint64(size) - directoryOffset) {
+        setError(errorString, tr("Central directory lies outside the archive"));
+        return false;
+    }
+    // Every entry needs at least a fixed header; a larger count is corrupt (and would over-reserve)
+    if (entryCount > directorySize / kCentralHeaderSize) {
+        setError(errorString, tr("Corrupt central directory"));
+        return false;
+    }
+    entries->reserve(qsizetype(entryCount));
+    
+    qint64 pos = qint64(directoryOffset);
+    const qint64 end = qint64(directoryOffset + directorySize);
+    for (quint64 i = 0; i < entryCount; ++i) {
+        if (pos + kCentralHeaderSize > end || read32(data + pos) != kCentralHeaderSignature) {
+            setError(errorString, tr("Corrupt central directory entry %1").arg(i));
+            return false;
+        }
+        const uchar* header = data + pos;
+        const quint16 nameLength = read16(header + 28);
+        const quint16 extraLength = read16(header + 30);
+        const quint16 commentLength = read16(header + 32);
+        if (pos + kCentralHeaderSize + nameLength + extraLength + commentLength > end) {
+            setError(errorString, tr("Corrupt central directory entry %1").arg(i));
+            return false;
+        }
+        
+        Entry entry;
+        entry.flags = read16(header + 8);
+        entry.method = read16(header + 10);
+        entry.modified = dosDateTime(read16(header + 12), read16(header + 14));
+        entry.crc32 = read32(header + 16);
+        entry.compressedSize = read32(header + 20);
+        entry.uncompressedSize = read32(header + 24);
+        entry.localHeaderOffset = read32(header + 42);
+        
+        const char* name = reinterpret_cast<const char*>(header + kCentralHeaderSize);
+        if (entry.flags & kFlagUtf8) {
+            entry.name = QString::fromUtf8(name, nameLength);
+        } else {
+            // Legacy names are CP437; Latin-1 keeps ASCII paths right and never fails
+            entry.name = QString::fromLatin1(name, nameLength);
+        }
+        entry.name.replace('\\', '/');
+        
+        // ZIP64 extra field: 64-bit values for the fields saturated at 0xffffffff, in this order
+        const uchar* extra = header + kCentralHeaderSize + nameLength;
+        const uchar* extraEnd = extra + extraLength;
+        while (extra + 4 <= extraEnd) {
+            const quint16 id = read16(extra);
+            const quint16 length = read16(extra + 2);
+            const uchar* field = extra + 4;
+            if (field + length > extraEnd) break;
+            if (id == kZip64ExtraId) {
+                const uchar* value = field;
+                const uchar* valueEnd = field + length;
+                if (entry.uncompressedSize == 0xffffffff && value + 8 <= valueEnd) {
+                    entry.uncompressedSize = qint64(read64(value));
+                    value += 8;
+                }
+                if (entry.compressedSize == 0xffffffff && value + 8 <= valueEnd) {
+                    entry.compressedSize = qint64(read64(value));
+                    value += 8;
+                }
+                if (entry.localHeaderOffset == 0xffffffff && value + 8 <= valueEnd) {
+                    entry.localHeaderOffset = qint64(read64(value));
+                }
+            }
+            extra = field + length;
+        }
+        
+        if (entry.compressedSize < 0 || entry.uncompressedSize < 0 || entry.localHeaderOffset < 0) {
+            setError(errorString, tr("Corrupt central directory entry %1").arg(i));
+            return false;
+        }
+        entries->append(entry);
+        pos += kCentralHeaderSize + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+bool ZipArchive::extract(const QByteArray& archive, const Entry& entry, QIODevice* out, QString* errorString) {
+    const uchar* data = reinterpret_cast<const uchar*>(archive.constData());
+    const qint64 size = archive.size();
+    
+    if (entry.isEncrypted()) {
+        setError(errorString, tr("%1 is encrypted").arg(entry.name));
+        return false;
+    }
+    if (entry.localHeaderOffset > size - kLocalHeaderSize
+        || read32(data + entry.localHeaderOffset) != kLocalHeaderSignature) {
+        setError(errorString, tr("Corrupt local header for %1").arg(entry.name));
+        return false;
+    }
+    
+    // Sizes come from the central directory: local headers may defer them to a data descriptor
+    const uchar* header = data + entry.localHeaderOffset;
+    const qint64 dataOffset = entry.localHeaderOffset + kLocalHeaderSize + read16(header + 26) + read16(header + 28);
+    if (dataOffset > size || entry.compressedSize > size - dataOffset) {
+        setError(errorString, tr("%1 extends past the end of the archive").arg(entry.name));
+        return false;
+    }
+    const uchar* input = data + dataOffset;
+    
+    quint32 crc = 0;
+    qint64 total = 0;
+    if (entry.method == kMethodStored) {
+        if (entry.compressedSize != entry.uncompressedSize) {
+            setError(errorString, tr("Size mismatch in stored member %1").arg(entry.name));
+            return false;
+        }
+        for (qint64 offset = 0; offset < entry.compressedSize; offset += kCopyChunk) {
+            const qint64 n = std::min(kCopyChunk, entry.compressedSize - offset);
+            crc = quint32(crc32(crc, input + offset, uInt(n)));
+            if (out->write(reinterpret_cast<const char*>(input + offset), n) != n) {
+                setError(errorString, out->errorString());
+                return false;
+            }
+        }
+        total = entry.compressedSize;
+    } else if (entry.method == kMethodDeflate) {
+        QString inflateError;
+        if (!inflateMember(input, entry.compressedSize, entry.uncompressedSize, out, &crc, &total, &inflateError)) {
+            setError(errorString, tr("Cannot inflate %1: %2").arg(entry.name, inflateError));
+            return false;
+        }
+    } else {
+        setError(errorString, tr("%1 uses an unsupported compression method (%2)")
+            .arg(entry.name, methodName(entry.method)));
+        return false;
+    }
+    
+    if (total != entry.uncompressedSize || crc != entry.crc32) {
+        setError(errorString, tr("%1 is corrupt (size or CRC-32 mismatch)").arg(entry.name));
+        return false;
+    }
+    return true;
+}
+
+ZipArchive::ExtractResult ZipArchive::extractToFile(const QByteArray& data, const Entry& entry, const QString& path) {
+    ExtractResult result;
+    result.path = path;
+    
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.errorString = tr("Cannot write %1: %2").arg(path, file.errorString());
+        return result;
+    }
+    if (!extract(data, entry, &file, &result.errorString)) {
+        file.cancelWriting();
+        return result;
+    }
+    if (!file.commit()) {
+        result.errorString = tr("Cannot write %1: %2").arg(path, file.errorString());
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+QString ZipArchive::methodName(quint16 method) {
+    switch (method) {
+        case kMethodStored: return tr("Stored");
+        case kMethodDeflate: return tr("Deflate");
+        case 9: return tr("Deflate64");
+        case 12: return tr("BZip2");
+        case 14: return tr("LZMA");
+        case 93: return tr("Zstandard");
+        case 95: return tr("XZ");
+    }
+    return tr("method %1").arg(method);
+}
@@ -0,0 +1,69 @@
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * Read-only access to ZIP archives held in memory (attachment payloads).
+ *
+ * Listing reads only the end-of-central-directory record and the central
+ * directory, so even a very large archive is listed without touching its
+ * member data. Members are extracted one at a time into a QIODevice,
+ * inflated by zlib through a small output buffer, never the whole member
+ * at once. ZIP64 sizes and offsets are supported;
+ * encrypted members and methods other than stored/deflate are not.
+ */
+class ZipArchive {
+public:
+    struct Entry {
+        /** Path inside the archive, '/'-separated; directories end with '/'. */
+        QString name;
+        qint64 compressedSize = 0;
+        qint64 uncompressedSize = 0;
+        qint64 localHeaderOffset = 0;
+        quint32 crc32 = 0;
+        quint16 method = 0;
+        quint16 flags = 0;
+        QDateTime modified;
+        
+        bool isDirectory() const { return name.endsWith('/'); }
+        bool isEncrypted() const { return flags & 0x0001; }
+    };
+    
+    struct ExtractResult {
+        QString path;
+        bool ok = false;
+        QString errorString;
+    };
+    
+    /** True if data starts like a ZIP archive (local file header or empty-archive record). */
+    static bool isZip(const QByteArray& data);
+    
+    /**
+     * Reads the central directory of data. Returns false (with errorString set)
+     * if data is not a readable ZIP archive.
+     */
+    static bool readDirectory(const QByteArray& data, QList<Entry>* entries, QString* errorString = nullptr);
+    
+    /**
+     * Writes the uncompressed content of entry to out, checking size and CRC-32.
+     * data must be the archive the entry was read from.
+     */
+    static bool extract(const QByteArray& data, const Entry& entry, QIODevice* out, QString* errorString = nullptr);
+    
+    /**
+     * Extracts entry into the file path, which is only replaced if the whole
+     * member is extracted. Safe to call from worker threads.
+     */
+    static ExtractResult extractToFile(const QByteArray& data, const Entry& entry, const QString& path);
+    
+    /** Human-readable name of a compression method ("Deflate"). */
+    static QString methodName(quint16 method);
+};
+
+#endif
@@ -1,27 +1,357 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QMap>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <cstring>
+#include "BackendComparison.h"
+#include "FolderAnalytics.h"
 #include "MainWindow.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "MsgFileModel.h"
+#include "MsgParser.h"
+#include "PdfExporter.h"
+#include "ThumbnailCache.h"
+
+namespace {
+
+/** True if argv asks for a batch run that never shows a window. */
+bool isHeadlessRun(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--export-pdf", 12) == 0) return true;
+        if (std::strcmp(argv[i], "--compare-backends") == 0) return true;
+        if (std::strncmp(argv[i], "--analyze", 9) == 0) return true;
+    }
+    return false;
+}
+
+/** Expands directories (recursively) into their .msg files. */
+QStringList collectMessageFiles(const QStringList& paths) {
+    QStringList files;
+    for (const QString& path : paths) {
+        const QFileInfo info(path);
+        if (info.isDir()) {
+            files += MsgFileModel::findMessageFiles(path);
+        } else if (info.exists()) {
+            files.append(path);
+        }
+    }
+    return files;
+}
+
+/**
+ * Renders every input to a PDF in outputDirectory on the global thread pool.
+ * Parsing is serialized by the Python GIL; layout and PDF writing run in parallel.
+ * Returns the process exit code.
+ */
+int runPdfExport(const QString& outputDirectory, const QStringList& inputs) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    
+    const QStringList files = collectMessageFiles(inputs);
+    if (files.isEmpty()) {
+        err << "No MSG files to export." << Qt::endl;
+        return 1;
+    }
+    if (!QDir().mkpath(outputDirectory)) {
+        err << "Cannot create output directory: " << outputDirectory << Qt::endl;
+        return 1;
+    }
+    
+    const QList<PdfExporter::Job> jobs = PdfExporter::plan(files, outputDirectory);
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<PdfExporter::Result> future = QtConcurrent::mapped(jobs, &PdfExporter::exportFile);
+    
+    // Results are taken in input order as they complete, so failures are reported while the batch runs
+    int exported = 0;
+    qint64 pages = 0;
+    qint64 parseMs = 0;
+    qint64 renderMs = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+        const PdfExporter::Result result = future.resultAt(i);
+        parseMs += result.parseMs;
+        renderMs += result.renderMs;
+        if (!result.ok) {
+            err << "Failed: " << result.sourcePath << ": " << result.errorString << Qt::endl;
+            continue;
+        }
+        ++exported;
+        pages += result.pageCount;
+    }
+    
+    const double seconds = qMax<qint64>(timer.elapsed(), 1) / 1000.0;
+    out << QString("Exported %1 of %2 messages, %3 pages in %4 s (%5 pages/s, %6 messages/s, %7 threads)")
+            .arg(exported).arg(jobs.size()).arg(pages)
+            .arg(seconds, 0, 'f', 1)
+            .arg(pages / seconds, 0, 'f', 1)
+            .arg(exported / seconds, 0, 'f', 1)
+            .arg(QThreadPool::globalInstance()->maxThreadCount())
+        << Qt::endl;
+    out << QString("Time in workers: parse %1 s, render %2 s")
+            .arg(parseMs / 1000.0, 0, 'f', 1).arg(renderMs / 1000.0, 0, 'f', 1)
+        << Qt::endl;
+    return exported == jobs.size() ? 0 : 1;
+}
+
+/**
+ * Parses every input with each parse backend and reports where they disagree,
+ * followed by per-backend latency percentiles and throughput.
+ * Returns 0 if all backends agree on every file.
+ */
+int runBackendComparison(const QStringList& inputs) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    
+    const QStringList files = collectMessageFiles(inputs);
+    if (files.isEmpty()) {
+        err << "No MSG files to compare." << Qt::endl;
+        return 1;
+    }
+    
+    const QList<ParseBackend> backends = MsgParser::availableBackends();
+    const QString reference = MsgParser::backendName(backends.first());
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<BackendComparison::FileResult> future = QtConcurrent::mapped(files, &BackendComparison::compareFile);
+    
+    int mismatches = 0;
+    int failedEverywhere = 0;
+    QMap<QString, int> fieldCounts;
+    QList<QList<qint64>> latencies(backends.size());
+    for (QList<qint64>& list : latencies) list.reserve(files.size());
+    
+    for (int i = 0; i < files.size(); ++i) {
+        const BackendComparison::FileResult result = future.resultAt(i);
+        bool anyOk = false;
+        for (qsizetype b = 0; b < result.runs.size(); ++b) {
+            const BackendComparison::Run& run = result.runs.at(b);
+            anyOk = anyOk || run.ok;
+            if (run.ok) latencies[b].append(run.elapsedUs);
+        }
+        if (!anyOk) {
+            ++failedEverywhere;
+            err << "Failed: " << result.filePath << ": " << result.runs.first().errorMessage << Qt::endl;
+            continue;
+        }
+        if (result.agrees()) continue;
+        
+        ++mismatches;
+        for (qsizetype b = 0; b < result.differences.size(); ++b) {
+            const QStringList& fields = result.differences.at(b);
+            if (fields.isEmpty()) continue;
+            for (const QString& field : fields) ++fieldCounts[field];
+            out << "MISMATCH " << result.filePath << ": " << MsgParser::backendName(backends.at(b + 1))
+                << " vs " << reference << ": " << fields.join(", ") << Qt::endl;
+        }
+    }
+    
+    const double seconds = qMax<qint64>(timer.elapsed(), 1) / 1000.0;
+    out << QString("Compared %1 files in %2 s (%3 files/s, %4 threads): %5 agree, %6 differ, %7 failed in every backend")
+            .arg(files.size()).arg(seconds, 0, 'f', 1).arg(files.size() / seconds, 0, 'f', 1)
+            .arg(QThreadPool::globalInstance()->maxThreadCount())
+            .arg(files.size() - mismatches - failedEverywhere).arg(mismatches).arg(failedEverywhere)
+        << Qt::endl;
+    for (auto it = fieldCounts.cbegin(); it != fieldCounts.cend(); ++it) {
+        out << QString("  %1: %2 files").arg(it.key()).arg(it.value()) << Qt::endl;
+    }
+    for (qsizetype b = 0; b < backends.size(); ++b) {
+        const BackendComparison::LatencySummary s = BackendComparison::summarize(latencies.at(b));
+        out << QString("%1: %2 parsed, p50 %3 ms, p90 %4 ms, p99 %5 ms, max %6 ms, %7 files per CPU second")
+                .arg(MsgParser::backendName(backends.at(b)), -12).arg(s.count)
+                .arg(s.p50Ms, 0, 'f', 2).arg(s.p90Ms, 0, 'f', 2).arg(s.p99Ms, 0, 'f', 2)
+                .arg(s.maxMs, 0, 'f', 2).arg(s.filesPerSecond, 0, 'f', 1)
+            << Qt::endl;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+/**
+ * Computes folder analytics and writes them as CSV (output ending in .csv)
+ * or JSON (any other output; stdout if none). Returns the process exit code.
+ */
+int runAnalytics(const QString& directory, const QString& outputPath, int topCount) {
+    QTextStream err(stderr);
+    if (!QFileInfo(directory).isDir()) {
+        err << "Not a directory: " << directory << Qt::endl;
+        return 1;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    const FolderAnalytics::Report report = FolderAnalytics::analyze(directory);
+    const bool csv = outputPath.endsWith(".csv", Qt::CaseInsensitive);
+    const QByteArray data = csv ? report.toCsv(topCount) : report.toJson(topCount);
+    
+    if (outputPath.isEmpty()) {
+        QFile out;
+        if (!out.open(stdout, QIODevice::WriteOnly)) return 1;
+        out.write(data);
+    } else {
+        QSaveFile out(outputPath);
+        if (!out.open(QIODevice::WriteOnly) || out.write(data) < 0 || !out.commit()) {
+            err << "Cannot write " << outputPath << ": " << out.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+    
+    err << QString("Analyzed %1 messages (%2 failed) in %3 s")
+            .arg(report.messages).arg(report.failedFiles)
+            .arg(timer.elapsed() / 1000.0, 0, 'f', 1)
+        << Qt::endl;
+    return 0;
+}
+
+}
 
 /**
  * Application entry point.
- * Creates the main window and optionally loads a file passed as command-line argument.
+ * Creates the main window and optionally loads files passed as command-line arguments,
+ * or runs a headless batch job (--export-pdf, --compare-backends, --analyze).
  */
 int main(int argc, char* argv[]) {
+    // Batch runs must work without a display
+    if (isHeadlessRun(argc, argv) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    
     QApplication app(argc, argv);
     app.setApplicationName("Qt MSG Reader");
     app.setApplicationVersion("1.0.0");
     app.setOrganizationName("QtMSGReader");
     
-    MainWindow window;
-    window.show();
+    // Command-line options: per-file parse limits guard against hostile or corrupt files
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Viewer for Microsoft Outlook MSG files");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("files", "MSG files to open, one tab each.", "[files...]");
+    
+    ParseLimits limits = MsgParser::defaultLimits();
+    QCommandLineOption timeoutOption("parse-timeout",
+        QString("Abort parsing a file after <seconds> of CPU time (0 = no limit, default %1).")
+            .arg(limits.timeoutMs / 1000),
+        "seconds");
+    QCommandLineOption memoryOption("parse-memory-limit",
+        QString("Abort parsing a file that grows memory by more than <MiB> (0 = no limit, default %1; "
+                "checked only while one file is parsed at a time).")
+            .arg(limits.maxMemoryBytes / (1024 * 1024)),
+        "MiB");
+    QCommandLineOption tabBudgetOption("tab-memory-budget",
+        QString("Evict background message tabs once open tabs use more than <MiB> (0 = never, default %1).")
+            .arg(MainWindow::DefaultTabMemoryBudget / (1024 * 1024)),
+        "MiB");
+    parser.addOption(timeoutOption);
+    parser.addOption(memoryOption);
+    QCommandLineOption exportPdfOption("export-pdf",
+        "Render the given files (and .msg files in given folders) to PDFs in <directory>, then exit.",
+        "directory");
+    QCommandLineOption compareBackendsOption("compare-backends",
+        "Parse the given files (and .msg files in given folders) with every parse backend, "
+        "report differences and parse times, then exit.");
+    QCommandLineOption analyzeOption("analyze",
+        "Print sender, month and attachment statistics for the .msg files under <directory>, then exit.",
+        "directory");
+    QCommandLineOption analyticsOutputOption("analytics-output",
+        "Write --analyze results to <file> (CSV if it ends in .csv, else JSON; default: JSON on stdout).",
+        "file");
+    QCommandLineOption analyticsTopOption("analytics-top",
+        QString("Rows in the --analyze top sender tables (default %1).").arg(FolderAnalytics::DefaultTopCount),
+        "n");
+    parser.addOption(tabBudgetOption);
+    parser.addOption(exportPdfOption);
+    parser.addOption(compareBackendsOption);
+    parser.addOption(analyzeOption);
+    parser.addOption(analyticsOutputOption);
+    parser.addOption(analyticsTopOption);
+    QCommandLineOption metricsJsonOption("metrics-json",
+        "Write open/parse/render/save latency histograms as JSON to <file> on exit and on SIGUSR1.",
+        "file");
+    QCommandLineOption metricsPortOption("metrics-port",
+        "Serve metrics in Prometheus text format on http://127.0.0.1:<port>/metrics.",
+        "port");
+    parser.addOption(metricsJsonOption);
+    parser.addOption(metricsPortOption);
+    QCommandLineOption thumbnailCacheOption("thumbnail-cache-size",
+        QString("Keep at most <MiB> of attachment thumbnails on disk (0 = none, default %1).")
+            .arg(ThumbnailCache::DefaultMaxCacheBytes / (1024 * 1024)),
+        "MiB");
+    QCommandLineOption clearThumbnailsOption("clear-thumbnail-cache",
+        "Delete the cached attachment thumbnails before starting.");
+    parser.addOption(thumbnailCacheOption);
+    parser.addOption(clearThumbnailsOption);
+    parser.process(app);
+    
+    if (parser.isSet(timeoutOption)) {
+        limits.timeoutMs = parser.value(timeoutOption).toInt() * 1000;
+    }
+    if (parser.isSet(memoryOption)) {
+        limits.maxMemoryBytes = parser.value(memoryOption).toLongLong() * 1024 * 1024;
+    }
+    MsgParser::setDefaultLimits(limits);
+    
+    if (parser.isSet(thumbnailCacheOption)) {
+        ThumbnailCache::setMaxCacheBytes(parser.value(thumbnailCacheOption).toLongLong() * 1024 * 1024);
+    }
+    if (parser.isSet(clearThumbnailsOption) && !ThumbnailCache::clear()) {
+        QTextStream(stderr) << "Cannot delete all files in " << ThumbnailCache::cacheDirectory() << Qt::endl;
+    }
+    
+    // Latency histograms: dumped on SIGUSR1 and on exit, optionally scraped over loopback HTTP
+    const QString metricsPath = parser.value(metricsJsonOption);
+    Metrics::dumpOnSignal(metricsPath);
+    MetricsServer metricsServer;
+    if (parser.isSet(metricsPortOption)) {
+        QString errorString;
+        const quint16 port = quint16(parser.value(metricsPortOption).toUInt());
+        if (!metricsServer.start(port, &errorString)) {
+            QTextStream(stderr) << "Cannot serve metrics on port " << port << ": " << errorString << Qt::endl;
+            return 1;
+        }
+    }
     
-    // Load file if provided as command-line argument
-    if (argc > 1) {
-        QString filePath = QString::fromLocal8Bit(argv[1]);
-        if (QFileInfo::exists(filePath)) {
-            window.loadFile(filePath);
+    int exitCode = 0;
+    if (parser.isSet(exportPdfOption)) {
+        exitCode = runPdfExport(parser.value(exportPdfOption), parser.positionalArguments());
+    } else if (parser.isSet(compareBackendsOption)) {
+        exitCode = runBackendComparison(parser.positionalArguments());
+    } else if (parser.isSet(analyzeOption)) {
+        const int topCount = parser.isSet(analyticsTopOption)
+            ? parser.value(analyticsTopOption).toInt() : FolderAnalytics::DefaultTopCount;
+        exitCode = runAnalytics(parser.value(analyzeOption), parser.value(analyticsOutputOption), topCount);
+    } else {
+        MainWindow window;
+        if (parser.isSet(tabBudgetOption)) {
+            window.setTabMemoryBudget(parser.value(tabBudgetOption).toLongLong() * 1024 * 1024);
         }
+        window.show();
+        
+        // Open files provided as command-line arguments
+        QStringList files;
+        for (const QString& filePath : parser.positionalArguments()) {
+            if (QFileInfo::exists(filePath)) {
+                files.append(filePath);
+            }
+        }
+        if (!files.isEmpty()) {
+            window.openFiles(files);
+        }
+        
+        exitCode = app.exec();
     }
     
-    return app.exec();
+    if (parser.isSet(metricsJsonOption)) {
+        QString errorString;
+        if (!Metrics::writeJson(metricsPath, &errorString)) {
+            QTextStream(stderr) << "Cannot write " << metricsPath << ": " << errorString << Qt::endl;
+        }
+    }
+    return exitCode;
 }